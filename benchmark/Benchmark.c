@@ -0,0 +1,1066 @@
+// Benchmark.c - Microbenchmarks for the dynamic SDDS and the static cFList
+// (C) - Charles Machalow via the MIT License
+
+#define _CRT_SECURE_NO_WARNINGS 1
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L // clock_gettime
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif // _WIN32
+
+// Local includes
+#include "BoundedSDDS.h"
+#include "CFListReader.h"
+#include "Compression.h"
+#include "ConcurrentSDDS.h"
+#include "Query.h"
+#include "RingBuffer.h"
+#include "SDDS.h"
+#include "SDDSWriter.h"
+#include "StaticSDDS.h"
+
+// What gets swept
+static const uint32_t FIELD_COUNTS[] = { 1, 10, 100, 1000, 10000 };
+static const uint32_t PAYLOAD_SIZES[] = { 1, 64, 1024, 4096, 65536 };
+#define ARRAY_COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+// Limits on how much work one measurement does
+#define DEFAULT_TARGET_OPS      100000
+#define DEFAULT_MAX_SDDS_BYTES  (64 * 1024 * 1024)  // Skip sweeps that would hold more payload than this in one SDDS
+#define DEFAULT_MAX_TOTAL_BYTES (256 * 1024 * 1024) // Cap on payload bytes copied per measurement
+#define QUICK_DIVISOR           10
+
+// Static cFList pieces used to estimate document sizes
+#define CFLIST_FIELD_OVERHEAD (sizeof("<field type=\"\" token=\"\"></field>") - 1)
+#define INTEGER_VALUE         1234567890
+#define INTEGER_VALUE_LEN     10
+
+typedef enum OutputFormat {
+	OUTPUT_CSV,
+	OUTPUT_JSON
+} OutputFormat;
+
+typedef struct BenchConfig {
+	uint64_t TargetOps;
+	uint64_t MaxSddsBytes;
+	uint64_t MaxTotalBytes;
+	OutputFormat Format;
+} BenchConfig;
+
+// Accumulates a single (suite, op, fields, payload) result
+typedef struct Measurement {
+	uint64_t Ops;
+	uint64_t Ns;
+	uint64_t Allocations;
+	uint64_t AllocatedBytes;
+} Measurement;
+
+static BenchConfig config = { DEFAULT_TARGET_OPS, DEFAULT_MAX_SDDS_BYTES, DEFAULT_MAX_TOTAL_BYTES, OUTPUT_CSV };
+
+// Written to so the compiler can't throw away benchmarked work
+static volatile uint64_t benchSink;
+
+/*
+*
+* Timing and reporting
+*
+*/
+
+static uint64_t nowNs(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	if (frequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)((double)counter.QuadPart * (1e9 / (double)frequency.QuadPart));
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+#endif // _WIN32
+}
+
+static uint64_t startMeasurement(void)
+{
+	resetMemoryStats();
+	return nowNs();
+}
+
+static void endMeasurement(Measurement *m, uint64_t startNs, uint64_t ops)
+{
+	uint64_t endNs = nowNs();
+	MemoryStats stats = getMemoryStats();
+	m->Ns += endNs - startNs;
+	m->Ops += ops;
+	m->Allocations += stats.Allocations;
+	m->AllocatedBytes += stats.AllocatedBytes;
+}
+
+static void printHeader(void)
+{
+	if (config.Format == OUTPUT_CSV)
+	{
+		printf("suite,op,fields,payload_bytes,ops,ns_per_op,allocs_per_op,bytes_per_op\n");
+	}
+}
+
+static void report(const char *suite, const char *op, uint32_t fieldCount, uint32_t payloadSize, Measurement *m)
+{
+	double ops = m->Ops ? (double)m->Ops : 1.0;
+	double nsPerOp = (double)m->Ns / ops;
+	double allocsPerOp = (double)m->Allocations / ops;
+	double bytesPerOp = (double)m->AllocatedBytes / ops;
+
+	if (config.Format == OUTPUT_JSON)
+	{
+		printf("{\"suite\":\"%s\",\"op\":\"%s\",\"fields\":%u,\"payload_bytes\":%u,\"ops\":%" PRIu64 ","
+			"\"ns_per_op\":%.2f,\"allocs_per_op\":%.3f,\"bytes_per_op\":%.1f}\n",
+			suite, op, fieldCount, payloadSize, m->Ops, nsPerOp, allocsPerOp, bytesPerOp);
+	}
+	else
+	{
+		printf("%s,%s,%u,%u,%" PRIu64 ",%.2f,%.3f,%.1f\n",
+			suite, op, fieldCount, payloadSize, m->Ops, nsPerOp, allocsPerOp, bytesPerOp);
+	}
+	fflush(stdout);
+}
+
+// Number of rounds of fieldCount operations to run to get close to the target op count without copying too much
+static uint64_t getRounds(uint32_t fieldCount, uint64_t bytesPerRound)
+{
+	uint64_t rounds = config.TargetOps / fieldCount;
+	if (bytesPerRound && rounds > config.MaxTotalBytes / bytesPerRound)
+	{
+		rounds = config.MaxTotalBytes / bytesPerRound;
+	}
+	return rounds ? rounds : 1;
+}
+
+// Makes fieldCount names like <prefix>0, <prefix>1, ...
+static char** makeNames(const char *prefix, uint32_t fieldCount)
+{
+	char **names = (char**)malloc(fieldCount * sizeof(char*));
+	if (!names)
+	{
+		return NULL;
+	}
+
+	for (uint32_t i = 0; i < fieldCount; i++)
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%s%u", prefix, i);
+		names[i] = (char*)malloc(strlen(buf) + 1);
+		if (!names[i])
+		{
+			exit(EXIT_FAILURE);
+		}
+		strcpy(names[i], buf);
+	}
+	return names;
+}
+
+static void freeNames(char **names, uint32_t fieldCount)
+{
+	for (uint32_t i = 0; i < fieldCount; i++)
+	{
+		free(names[i]);
+	}
+	free(names);
+}
+
+/*
+*
+* Dynamic SDDS
+*
+*/
+
+// sorted turns on the sorted name index, so lookups are binary searches
+static void benchDynamic(uint32_t fieldCount, uint32_t payloadSize, bool sorted)
+{
+	const char *suite = sorted ? "dynamic-sorted" : "dynamic";
+	uint64_t bytesPerRound = (uint64_t)fieldCount * payloadSize;
+	if (bytesPerRound > config.MaxSddsBytes)
+	{
+		return;
+	}
+
+	char **names = makeNames("Field", fieldCount);
+	BYTE *payload = (BYTE*)malloc(payloadSize);
+	if (!names || !payload)
+	{
+		exit(EXIT_FAILURE);
+	}
+	for (uint32_t i = 0; i < payloadSize; i++)
+	{
+		payload[i] = (BYTE)i;
+	}
+
+	Measurement add = { 0 }, lookup = { 0 }, remove = { 0 }, xml = { 0 }, close = { 0 }, compress = { 0 }, decompress = { 0 };
+	uint64_t rounds = getRounds(fieldCount, bytesPerRound);
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		SDDS s = { 0 };
+		if (sorted && !enableSortedIndex(&s))
+		{
+			exit(EXIT_FAILURE);
+		}
+		uint64_t start = startMeasurement();
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			addField(&s, names[i], payloadSize * 8, payload, 0);
+		}
+		endMeasurement(&add, start, fieldCount);
+
+		start = startMeasurement();
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			benchSink += getRawField(&s, names[i], NULL, NULL, NULL)[0];
+		}
+		endMeasurement(&lookup, start, fieldCount);
+
+		start = startMeasurement();
+		char *xmlStr = toXml(&s);
+		endMeasurement(&xml, start, 1);
+		benchSink += (uint64_t)xmlStr[0];
+
+		if (!sorted)
+		{
+			size_t xmlLen = (size_t)getXmlSize(&s);
+			size_t frameSize = COMPRESSION_FRAME_BOUND(xmlLen);
+			uint8_t *frame = (uint8_t*)malloc(frameSize);
+			uint8_t *decompressed = (uint8_t*)malloc(xmlLen + 1);
+			size_t decompressedLen = 0;
+			if (!frame || !decompressed)
+			{
+				exit(EXIT_FAILURE);
+			}
+
+			start = startMeasurement();
+			size_t frameLen = compressFrame((uint8_t*)xmlStr, xmlLen, COMPRESSION_DICT_SDDS_XML, frame, frameSize);
+			endMeasurement(&compress, start, 1);
+
+			start = startMeasurement();
+			benchSink += decompressFrame(frame, frameLen, decompressed, xmlLen + 1, &decompressedLen);
+			endMeasurement(&decompress, start, 1);
+			benchSink += decompressedLen;
+
+			free(decompressed);
+			free(frame);
+		}
+		memFree(xmlStr);
+
+		start = startMeasurement();
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			removeField(&s, names[i]);
+		}
+		endMeasurement(&remove, start, fieldCount);
+
+		// Refill so there is something to close
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			addField(&s, names[i], payloadSize * 8, payload, 0);
+		}
+		start = startMeasurement();
+		closeSDDS(&s);
+		endMeasurement(&close, start, 1);
+	}
+
+	report(suite, "add", fieldCount, payloadSize, &add);
+	report(suite, "lookup", fieldCount, payloadSize, &lookup);
+	report(suite, "remove", fieldCount, payloadSize, &remove);
+	report(suite, "toXml", fieldCount, payloadSize, &xml);
+	if (!sorted)
+	{
+		report(suite, "compressXml", fieldCount, payloadSize, &compress);
+		report(suite, "decompressXml", fieldCount, payloadSize, &decompress);
+	}
+	report(suite, "close", fieldCount, payloadSize, &close);
+
+	free(payload);
+	freeNames(names, fieldCount);
+}
+
+// Typed u64 fields read with getU64() vs getRawField() and a copy out
+static void benchTyped(uint32_t fieldCount)
+{
+	char **names = makeNames("Field", fieldCount);
+	if (!names)
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	Measurement add = { 0 }, typed = { 0 }, raw = { 0 };
+	uint64_t rounds = getRounds(fieldCount, (uint64_t)fieldCount * sizeof(uint64_t));
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		SDDS s = { 0 };
+		uint64_t start = startMeasurement();
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			addU64(&s, names[i], i);
+		}
+		endMeasurement(&add, start, fieldCount);
+
+		start = startMeasurement();
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			uint64_t value = 0;
+			getU64(&s, names[i], &value);
+			benchSink += value;
+		}
+		endMeasurement(&typed, start, fieldCount);
+
+		start = startMeasurement();
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			uint64_t value = 0;
+			uint32_t fieldSize = 0;
+			BYTE *rawField = getRawField(&s, names[i], &fieldSize, NULL, NULL);
+			memcpy(&value, rawField, roundToByte(fieldSize));
+			benchSink += value;
+		}
+		endMeasurement(&raw, start, fieldCount);
+		closeSDDS(&s);
+	}
+
+	report("typed", "addU64", fieldCount, sizeof(uint64_t), &add);
+	report("typed", "getU64", fieldCount, sizeof(uint64_t), &typed);
+	report("typed", "getRawCopy", fieldCount, sizeof(uint64_t), &raw);
+	freeNames(names, fieldCount);
+}
+
+// Largest field count the bounded suite runs (its lookups are linear)
+#define BOUNDED_BENCH_MAX_FIELDS 1000
+
+// A BoundedSDDS refilled every round, the way a control loop would use it: adds, lookups, writeBinary() and a clear
+static void benchBounded(uint32_t fieldCount)
+{
+	if (fieldCount > BOUNDED_BENCH_MAX_FIELDS)
+	{
+		return;
+	}
+
+	char **names = makeNames("Field", fieldCount);
+	uint32_t nameBytes = 0;
+	for (uint32_t i = 0; names && i < fieldCount; i++)
+	{
+		nameBytes += (uint32_t)strlen(names[i]) + 1;
+	}
+	size_t blockSize = boundedSDDSBlockSize(fieldCount, nameBytes, fieldCount * sizeof(uint64_t));
+	size_t binarySize = SDDS_BINARY_HEADER_SIZE + sizeof(uint32_t) + ((SDDS_BINARY_FIELD_OVERHEAD + sizeof(uint64_t)) * fieldCount) + nameBytes;
+	void *block = malloc(blockSize);
+	BYTE *binary = (BYTE*)malloc(binarySize);
+	BoundedSDDS b;
+	if (!names || !block || !binary || !boundedSDDSInit(&b, block, blockSize, fieldCount, nameBytes, fieldCount * sizeof(uint64_t)))
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	Measurement add = { 0 }, lookup = { 0 }, write = { 0 }, clear = { 0 };
+	uint64_t rounds = getRounds(fieldCount, 0);
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		uint64_t start = startMeasurement();
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			boundedSDDSAddU64(&b, names[i], r + i);
+		}
+		endMeasurement(&add, start, fieldCount);
+
+		start = startMeasurement();
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			uint64_t value = 0;
+			getU64(&b.View, names[i], &value);
+			benchSink += value;
+		}
+		endMeasurement(&lookup, start, fieldCount);
+
+		start = startMeasurement();
+		benchSink += writeBinary(&b.View, binary, binarySize);
+		endMeasurement(&write, start, fieldCount);
+
+		start = startMeasurement();
+		boundedSDDSClear(&b);
+		endMeasurement(&clear, start, 1);
+	}
+
+	report("bounded", "addU64", fieldCount, sizeof(uint64_t), &add);
+	report("bounded", "getU64", fieldCount, sizeof(uint64_t), &lookup);
+	report("bounded", "writeBinary", fieldCount, sizeof(uint64_t), &write);
+	report("bounded", "clear", fieldCount, sizeof(uint64_t), &clear);
+	free(binary);
+	free(block);
+	freeNames(names, fieldCount);
+}
+
+// Discards a streaming writer's output
+static bool discardSink(void *context, const BYTE *data, size_t len)
+{
+	benchSink += len + data[0];
+	(void)context;
+	return true;
+}
+
+// Producing xml for fieldCount fields: adding them to an SDDS then calling toXml() vs a streaming writer
+static void benchWriter(uint32_t fieldCount, uint32_t payloadSize)
+{
+	uint64_t bytesPerRound = (uint64_t)fieldCount * payloadSize;
+	if (bytesPerRound > config.MaxSddsBytes)
+	{
+		return;
+	}
+
+	char **names = makeNames("Field", fieldCount);
+	BYTE *payload = (BYTE*)malloc(payloadSize);
+	if (!names || !payload)
+	{
+		exit(EXIT_FAILURE);
+	}
+	memset(payload, 0x5A, payloadSize);
+
+	Measurement built = { 0 }, streamed = { 0 };
+	uint64_t rounds = getRounds(fieldCount, bytesPerRound);
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		uint64_t start = startMeasurement();
+		SDDS s = { 0 };
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			addField(&s, names[i], payloadSize * 8, payload, 0);
+		}
+		char *xml = toXml(&s);
+		benchSink += xml[0];
+		memFree(xml);
+		closeSDDS(&s);
+		endMeasurement(&built, start, fieldCount);
+
+		start = startMeasurement();
+		SDDSWriter writer;
+		sddsWriterOpenCallback(&writer, SDDS_WRITER_XML, discardSink, NULL);
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			sddsWriterAddField(&writer, names[i], payloadSize * 8, payload, 0);
+		}
+		sddsWriterClose(&writer);
+		endMeasurement(&streamed, start, fieldCount);
+	}
+
+	report("writer", "addFieldToXml", fieldCount, payloadSize, &built);
+	report("writer", "streamXml", fieldCount, payloadSize, &streamed);
+	free(payload);
+	freeNames(names, fieldCount);
+}
+
+// Lookups in a ConcurrentSDDS: straight on the writer's SDDS vs each pinned in a read section, and publishing a one field change
+static void benchConcurrent(uint32_t fieldCount)
+{
+	char **names = makeNames("Field", fieldCount);
+	ConcurrentSDDS shared;
+	if (!names || !concurrentSDDSOpen(&shared))
+	{
+		exit(EXIT_FAILURE);
+	}
+	SDDS *writer = concurrentSDDSWriter(&shared);
+	enableSortedIndex(writer);
+	for (uint32_t i = 0; i < fieldCount; i++)
+	{
+		addU64(writer, names[i], i);
+	}
+	concurrentSDDSPublish(&shared);
+	uint32_t reader = concurrentSDDSAddReader(&shared);
+
+	Measurement lookup = { 0 }, pinned = { 0 }, publish = { 0 };
+	uint64_t rounds = getRounds(fieldCount, 0);
+	uint64_t start = startMeasurement();
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			benchSink += getRawField(writer, names[i], NULL, NULL, NULL)[0];
+		}
+	}
+	endMeasurement(&lookup, start, rounds * fieldCount);
+
+	start = startMeasurement();
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		for (uint32_t i = 0; i < fieldCount; i++)
+		{
+			SDDS *version = concurrentSDDSReadBegin(&shared, reader);
+			benchSink += getRawField(version, names[i], NULL, NULL, NULL)[0];
+			concurrentSDDSReadEnd(&shared, reader);
+		}
+	}
+	endMeasurement(&pinned, start, rounds * fieldCount);
+
+	uint64_t publishes = getRounds(fieldCount, (uint64_t)fieldCount * sizeof(BYTE*));
+	start = startMeasurement();
+	for (uint64_t r = 0; r < publishes; r++)
+	{
+		getWritableField(writer, names[r % fieldCount], NULL, NULL, NULL)[0]++;
+		concurrentSDDSPublish(&shared);
+	}
+	endMeasurement(&publish, start, publishes);
+
+	report("concurrent", "lookup", fieldCount, sizeof(uint64_t), &lookup);
+	report("concurrent", "pinnedLookup", fieldCount, sizeof(uint64_t), &pinned);
+	report("concurrent", "publish", fieldCount, sizeof(uint64_t), &publish);
+	concurrentSDDSClose(&shared);
+	freeNames(names, fieldCount);
+}
+
+/*
+*
+* Static cFList
+*
+*/
+
+typedef enum CFListFieldKind {
+	KIND_INTEGER,
+	KIND_BOOLEAN,
+	KIND_STRING,
+	KIND_HEXBINDATA
+} CFListFieldKind;
+
+static const char* getKindName(CFListFieldKind kind)
+{
+	switch (kind)
+	{
+	case KIND_INTEGER:
+		return INTEGER_S;
+	case KIND_BOOLEAN:
+		return BOOL_S;
+	case KIND_STRING:
+		return STRING_S;
+	default:
+		return HEXBINDATA_S;
+	}
+}
+
+// Number of characters the value of a field takes in the document
+static size_t getValueLength(CFListFieldKind kind, uint32_t payloadSize)
+{
+	switch (kind)
+	{
+	case KIND_INTEGER:
+		return INTEGER_VALUE_LEN;
+	case KIND_BOOLEAN:
+		return strlen("True");
+	case KIND_STRING:
+		return payloadSize;
+	default:
+		return 2 * (size_t)payloadSize;
+	}
+}
+
+static size_t encodeCFList(uint8_t *buf, size_t bufSize, CFListFieldKind kind, char **tokens, uint32_t fieldCount, char *stringValue, uint8_t *hexValue, uint32_t payloadSize)
+{
+	size_t docSize = 0;
+	START_CFLIST(buf, bufSize);
+	for (uint32_t i = 0; i < fieldCount; i++)
+	{
+		switch (kind)
+		{
+		case KIND_INTEGER:
+			ADD_CFLIST_UNSIGNED_FIELD(tokens[i], INTEGER_VALUE);
+			break;
+		case KIND_BOOLEAN:
+			ADD_CFLIST_BOOL_FIELD(tokens[i], true);
+			break;
+		case KIND_STRING:
+			ADD_CFLIST_STRING_FIELD(tokens[i], stringValue);
+			break;
+		default:
+			ADD_CFLIST_HEXBINDATA_FIELD(tokens[i], hexValue, payloadSize);
+			break;
+		}
+	}
+	END_CFLIST_GET_SIZE(&docSize);
+	return docSize;
+}
+
+static void decodeCFListField(uint8_t *buf, size_t bufSize, CFListFieldKind kind, char *token)
+{
+	switch (kind)
+	{
+	case KIND_INTEGER:
+		benchSink += getIntegerValueFromId(buf, bufSize, token);
+		break;
+	case KIND_BOOLEAN:
+		benchSink += getBooleanValueFromId(buf, bufSize, token);
+		break;
+	case KIND_STRING:
+		benchSink += getFieldStringValueAndPutInGpBuf(buf, bufSize, token);
+		break;
+	default:
+		benchSink += getFieldHexBinValueAndPutInGpBuf(buf, bufSize, token);
+		break;
+	}
+}
+
+static void benchStatic(CFListFieldKind kind, uint32_t fieldCount, uint32_t payloadSize)
+{
+	// Encoding only needs a buffer as big as the document, so big sweeps are skipped the same way as the dynamic ones
+	char **tokens = makeNames("T", fieldCount);
+	size_t estimatedSize = strlen(START_XML) + strlen(END_XML);
+	for (uint32_t i = 0; i < fieldCount; i++)
+	{
+		estimatedSize += CFLIST_FIELD_OVERHEAD + strlen(getKindName(kind)) + strlen(tokens[i]) + getValueLength(kind, payloadSize);
+	}
+	if (estimatedSize > config.MaxSddsBytes)
+	{
+		freeNames(tokens, fieldCount);
+		return;
+	}
+
+	uint8_t *buf = (uint8_t*)calloc(estimatedSize + 1, 1);
+	char *stringValue = (char*)malloc(payloadSize + 1);
+	uint8_t *hexValue = (uint8_t*)malloc(payloadSize);
+	if (!buf || !stringValue || !hexValue)
+	{
+		exit(EXIT_FAILURE);
+	}
+	memset(stringValue, 'x', payloadSize);
+	stringValue[payloadSize] = 0;
+	for (uint32_t i = 0; i < payloadSize; i++)
+	{
+		hexValue[i] = (uint8_t)i;
+	}
+
+	Measurement encode = { 0 }, decode = { 0 };
+	size_t docSize = 0;
+	uint64_t rounds = getRounds(fieldCount, estimatedSize);
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		uint64_t start = startMeasurement();
+		docSize = encodeCFList(buf, estimatedSize + 1, kind, tokens, fieldCount, stringValue, hexValue, payloadSize);
+		endMeasurement(&encode, start, fieldCount);
+	}
+
+	// Decoding copies the document (and a null char) into the gpBuf, so give it caller scratch when the built in one is too small
+	uint8_t *scratch = NULL;
+	if (docSize + 2 > getGpBufferSize())
+	{
+		scratch = (uint8_t*)malloc(docSize + 2);
+		if (!scratch)
+		{
+			exit(EXIT_FAILURE);
+		}
+		setGpBuffer(scratch, docSize + 2);
+	}
+
+	// Every lookup copies the whole document, so cap the op count by bytes copied, spreading the lookups over the tokens
+	buf[docSize] = 0;
+	uint64_t decodeOps = rounds * fieldCount;
+	uint64_t maxDecodeOps = getRounds(1, docSize + 1);
+	decodeOps = decodeOps < maxDecodeOps ? decodeOps : maxDecodeOps;
+	uint64_t start = startMeasurement();
+	for (uint64_t op = 0; op < decodeOps; op++)
+	{
+		decodeCFListField(buf, docSize + 1, kind, tokens[(op * fieldCount) / decodeOps]);
+	}
+	endMeasurement(&decode, start, decodeOps);
+	if (scratch)
+	{
+		setGpBuffer(NULL, 0);
+		free(scratch);
+	}
+
+	// Integer and Boolean payloads don't change with payloadSize, so report what they really are
+	uint32_t reportedSize = payloadSize;
+	if (kind == KIND_INTEGER)
+	{
+		reportedSize = sizeof(uint64_t);
+	}
+	else if (kind == KIND_BOOLEAN)
+	{
+		reportedSize = sizeof(bool);
+	}
+
+	char op[64];
+	snprintf(op, sizeof(op), "encode%s", getKindName(kind));
+	report("static", op, fieldCount, reportedSize, &encode);
+	snprintf(op, sizeof(op), "decode%s", getKindName(kind));
+	report("static", op, fieldCount, reportedSize, &decode);
+
+	free(hexValue);
+	free(stringValue);
+	free(buf);
+	freeNames(tokens, fieldCount);
+}
+
+#define PROJECTION_TOKENS 4
+
+// Reading a few Integer fields out of a document: one lookup per token vs one cFListProject() pass
+static void benchProjection(uint32_t fieldCount)
+{
+	char **tokens = makeNames("T", fieldCount);
+	size_t estimatedSize = strlen(START_XML) + strlen(END_XML) +
+		fieldCount * (CFLIST_FIELD_OVERHEAD + strlen(INTEGER_S) + strlen(tokens[fieldCount - 1]) + INTEGER_VALUE_LEN);
+	if (estimatedSize + 1 > getGpBufferSize())
+	{
+		freeNames(tokens, fieldCount);
+		return;
+	}
+
+	uint8_t *buf = (uint8_t*)calloc(getGpBufferSize(), 1);
+	if (!buf)
+	{
+		exit(EXIT_FAILURE);
+	}
+	size_t docSize = encodeCFList(buf, getGpBufferSize(), KIND_INTEGER, tokens, fieldCount, NULL, NULL, 0);
+	buf[docSize] = 0;
+
+	// Spread the wanted tokens over the document
+	uint32_t wantedCount = fieldCount < PROJECTION_TOKENS ? fieldCount : PROJECTION_TOKENS;
+	char *wanted[PROJECTION_TOKENS];
+	CFListSlot slots[PROJECTION_TOKENS];
+	for (uint32_t w = 0; w < wantedCount; w++)
+	{
+		wanted[w] = tokens[((w + 1) * fieldCount - 1) / wantedCount];
+		slots[w].TokenId = wanted[w];
+	}
+
+	Measurement each = { 0 }, project = { 0 };
+	uint64_t rounds = getRounds(fieldCount, estimatedSize);
+	uint64_t start = startMeasurement();
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		for (uint32_t w = 0; w < wantedCount; w++)
+		{
+			benchSink += getIntegerValueFromId(buf, docSize + 1, wanted[w]);
+		}
+	}
+	endMeasurement(&each, start, rounds * wantedCount);
+
+	start = startMeasurement();
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		cFListProject(buf, docSize, slots, wantedCount, NULL);
+		for (uint32_t w = 0; w < wantedCount; w++)
+		{
+			uint64_t value = 0;
+			cFListFieldToUnsigned(&slots[w].Field, &value);
+			benchSink += value;
+		}
+	}
+	endMeasurement(&project, start, rounds * wantedCount);
+
+	report("projection", "lookupEach", fieldCount, sizeof(uint64_t), &each);
+	report("projection", "project", fieldCount, sizeof(uint64_t), &project);
+
+	free(buf);
+	freeNames(tokens, fieldCount);
+}
+
+// Reading every known token of a small document: per token lookups, a projection and the table driven record decode
+static void benchRecord(void)
+{
+	uint8_t buf[256] = { 0 };
+	size_t docSize = 0;
+	START_CFLIST(buf, sizeof(buf));
+	ADD_CFLIST_STRING_FIELD(TOKEN_SERIAL, "Serial1234");
+	ADD_CFLIST_SIGNED_FIELD(TOKEN_SIZE, -12345);
+	ADD_CFLIST_BOOL_FIELD(TOKEN_SUPPORTS_POWER, true);
+	END_CFLIST_GET_SIZE(&docSize);
+
+	Measurement each = { 0 }, project = { 0 }, record = { 0 };
+	uint64_t rounds = getRounds(CFLIST_SLOT_COUNT, docSize);
+	uint64_t start = startMeasurement();
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		benchSink += getIntegerValueFromId(buf, docSize + 1, TOKEN_SIZE);
+		benchSink += getBooleanValueFromId(buf, docSize + 1, TOKEN_SUPPORTS_POWER);
+		benchSink += getFieldStringValueAndPutInGpBuf(buf, docSize + 1, TOKEN_SERIAL);
+	}
+	endMeasurement(&each, start, rounds);
+
+	CFListSlot slots[] = { { TOKEN_SIZE }, { TOKEN_SERIAL }, { TOKEN_SUPPORTS_POWER } };
+	start = startMeasurement();
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		int64_t size = 0;
+		bool supportsPower = false;
+		char serial[CFLIST_RECORD_STRING_SIZE];
+		cFListProject(buf, docSize, slots, ARRAY_COUNT(slots), NULL);
+		cFListFieldToSigned(&slots[0].Field, &size);
+		cFListFieldToString(&slots[1].Field, serial, sizeof(serial), NULL);
+		cFListFieldToBoolean(&slots[2].Field, &supportsPower);
+		benchSink += (uint64_t)size + supportsPower + (uint8_t)serial[0];
+	}
+	endMeasurement(&project, start, rounds);
+
+	start = startMeasurement();
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		CFListRecord decoded;
+		cFListDecodeRecord(buf, docSize, &decoded);
+		benchSink += (uint64_t)decoded.Size + decoded.SupportsPower + (uint8_t)decoded.Serial[0];
+	}
+	endMeasurement(&record, start, rounds);
+
+	report("record", "lookupEach", CFLIST_SLOT_COUNT, sizeof(CFListRecord), &each);
+	report("record", "project", CFLIST_SLOT_COUNT, sizeof(CFListRecord), &project);
+	report("record", "decodeRecord", CFLIST_SLOT_COUNT, sizeof(CFListRecord), &record);
+}
+
+#define QUERY_BENCH_RECORDS 1000
+
+// Filtering a stream of framed cFList records: decoding each with the gpBuf functions vs queryBuffer()
+static void benchQuery(void)
+{
+	size_t streamSize = QUERY_BENCH_RECORDS * 256;
+	uint8_t *stream = (uint8_t*)malloc(streamSize);
+	if (!stream)
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	size_t streamLen = 0;
+	for (uint32_t i = 0; i < QUERY_BENCH_RECORDS; i++)
+	{
+		uint8_t *frame = stream + streamLen;
+		size_t docSize = 0;
+		START_CFLIST(frame + COMPRESSION_FRAME_HEADER_SIZE, streamSize - streamLen - COMPRESSION_FRAME_HEADER_SIZE);
+		ADD_CFLIST_STRING_FIELD(TOKEN_SERIAL, "Serial1234");
+		ADD_CFLIST_UNSIGNED_FIELD(TOKEN_SIZE, i);
+		ADD_CFLIST_BOOL_FIELD(TOKEN_SUPPORTS_POWER, (i % 3) == 0);
+		END_CFLIST_GET_SIZE(&docSize);
+		writeFrameHeader(frame, COMPRESSION_METHOD_STORED, COMPRESSION_DICT_NONE, (uint32_t)docSize, (uint32_t)docSize);
+		streamLen += COMPRESSION_FRAME_HEADER_SIZE + docSize;
+	}
+
+	QueryCondition filter[] = {
+		queryBooleanCondition(TOKEN_SUPPORTS_POWER, true),
+		queryUnsignedCondition(TOKEN_SIZE, QUERY_GT, QUERY_BENCH_RECORDS / 2),
+	};
+	Measurement decode = { 0 }, query = { 0 };
+	uint64_t rounds = getRounds(QUERY_BENCH_RECORDS, streamLen);
+	uint64_t start = startMeasurement();
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		size_t offset = 0;
+		while (offset < streamLen)
+		{
+			uint8_t *doc = stream + offset + COMPRESSION_FRAME_HEADER_SIZE;
+			size_t docSize = 0;
+			size_t frameLen = 0;
+			getFrameInfo(stream + offset, streamLen - offset, &docSize, &frameLen);
+			benchSink += getBooleanValueFromId(doc, docSize, TOKEN_SUPPORTS_POWER) && getIntegerValueFromId(doc, docSize, TOKEN_SIZE) > QUERY_BENCH_RECORDS / 2;
+			offset += frameLen;
+		}
+	}
+	endMeasurement(&decode, start, rounds * QUERY_BENCH_RECORDS);
+
+	start = startMeasurement();
+	for (uint64_t r = 0; r < rounds; r++)
+	{
+		QueryResult result;
+		queryBuffer(filter, ARRAY_COUNT(filter), stream, streamLen, &result);
+		benchSink += result.Matches;
+		queryResultFree(&result);
+	}
+	endMeasurement(&query, start, rounds * QUERY_BENCH_RECORDS);
+
+	report("query", "decodeEach", QUERY_BENCH_RECORDS, (uint32_t)(streamLen / QUERY_BENCH_RECORDS), &decode);
+	report("query", "queryBuffer", QUERY_BENCH_RECORDS, (uint32_t)(streamLen / QUERY_BENCH_RECORDS), &query);
+	free(stream);
+}
+
+/*
+*
+* Ring buffer
+*
+*/
+
+#define RING_BENCH_SIZE (1024 * 1024)
+
+static void benchRing(uint32_t payloadSize, bool multiProducer)
+{
+	static uint64_t ringMemory[RING_BENCH_SIZE / sizeof(uint64_t)];
+	RingBuffer ring;
+	ringBufferInit(&ring, (uint8_t*)ringMemory, RING_BENCH_SIZE, multiProducer);
+	if (payloadSize > ringBufferMaxRecordSize(&ring))
+	{
+		return;
+	}
+
+	uint8_t *payload = (uint8_t*)calloc(payloadSize, 1);
+	if (!payload)
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	// One thread producing and consuming, so this is the cost of the ring itself and the copy
+	Measurement transfer = { 0 };
+	uint64_t ops = getRounds(1, payloadSize);
+	uint64_t start = startMeasurement();
+	for (uint64_t op = 0; op < ops; op++)
+	{
+		const uint8_t *record = NULL;
+		uint32_t length = 0;
+		ringBufferWrite(&ring, payload, payloadSize);
+		ringBufferPeek(&ring, &record, &length);
+		benchSink += record[length - 1];
+		ringBufferRelease(&ring);
+	}
+	endMeasurement(&transfer, start, ops);
+
+	report("ring", multiProducer ? "writeReadMpsc" : "writeReadSpsc", 1, payloadSize, &transfer);
+	free(payload);
+}
+
+/*
+*
+* SDDS vs a plain struct
+*
+*/
+
+typedef struct test_struct
+{
+	BYTE a[1];
+	BYTE b[6];
+	char* c;
+} test_struct;
+
+static void testCSDDS(void)
+{
+	SDDS s = { 0 };
+	BYTE a[1] = { 1 };
+	addField(&s, "A", 8, a, 0);
+
+	BYTE b[6] = { 1, 2, 3, 4, 5 ,6 };
+	addField(&s, "B", 48, b, 0);
+
+	char* c = "Hello There!";
+	addField(&s, "C", cStrLen(c) * 8, (BYTE*)c, 0);
+	closeSDDS(&s);
+}
+
+static void testStruct(void)
+{
+	test_struct t = { 0 };
+	t.a[0] = 1;
+	BYTE b[6] = { 1, 2, 3, 4, 5 ,6 };
+	memcpy(&t.b, &b, 6);
+	t.c = "Hello There!";
+	benchSink += t.a[0] + t.b[5] + (uint64_t)t.c[0];
+}
+
+static void benchCompare(void)
+{
+	Measurement sdds = { 0 }, plain = { 0 };
+	uint64_t ops = config.TargetOps;
+
+	uint64_t start = startMeasurement();
+	for (uint64_t i = 0; i < ops; i++)
+	{
+		testCSDDS();
+	}
+	endMeasurement(&sdds, start, ops);
+
+	start = startMeasurement();
+	for (uint64_t i = 0; i < ops; i++)
+	{
+		testStruct();
+	}
+	endMeasurement(&plain, start, ops);
+
+	report("compare", "sdds", 3, 19, &sdds);
+	report("compare", "struct", 3, 19, &plain);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [--csv | --json] [--quick]\n", name);
+	fprintf(stderr, "  --csv    Print results as csv (default)\n");
+	fprintf(stderr, "  --json   Print results as one json object per line\n");
+	fprintf(stderr, "  --quick  Do a tenth of the work (for smoke runs and training)\n");
+}
+
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--csv") == 0)
+		{
+			config.Format = OUTPUT_CSV;
+		}
+		else if (strcmp(argv[i], "--json") == 0)
+		{
+			config.Format = OUTPUT_JSON;
+		}
+		else if (strcmp(argv[i], "--quick") == 0)
+		{
+			config.TargetOps /= QUICK_DIVISOR;
+			config.MaxSddsBytes /= QUICK_DIVISOR;
+			config.MaxTotalBytes /= QUICK_DIVISOR;
+		}
+		else
+		{
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printHeader();
+	benchCompare();
+
+	for (size_t f = 0; f < ARRAY_COUNT(FIELD_COUNTS); f++)
+	{
+		for (size_t p = 0; p < ARRAY_COUNT(PAYLOAD_SIZES); p++)
+		{
+			benchDynamic(FIELD_COUNTS[f], PAYLOAD_SIZES[p], false);
+			benchDynamic(FIELD_COUNTS[f], PAYLOAD_SIZES[p], true);
+			benchWriter(FIELD_COUNTS[f], PAYLOAD_SIZES[p]);
+		}
+		benchTyped(FIELD_COUNTS[f]);
+		benchConcurrent(FIELD_COUNTS[f]);
+		benchBounded(FIELD_COUNTS[f]);
+	}
+
+	for (CFListFieldKind kind = KIND_INTEGER; kind <= KIND_HEXBINDATA; kind++)
+	{
+		for (size_t f = 0; f < ARRAY_COUNT(FIELD_COUNTS); f++)
+		{
+			// Integer and Boolean fields are the same size no matter the payload size
+			size_t payloadCount = (kind == KIND_INTEGER || kind == KIND_BOOLEAN) ? 1 : ARRAY_COUNT(PAYLOAD_SIZES);
+			for (size_t p = 0; p < payloadCount; p++)
+			{
+				benchStatic(kind, FIELD_COUNTS[f], PAYLOAD_SIZES[p]);
+			}
+		}
+	}
+
+	for (size_t f = 0; f < ARRAY_COUNT(FIELD_COUNTS); f++)
+	{
+		benchProjection(FIELD_COUNTS[f]);
+	}
+	benchRecord();
+	benchQuery();
+
+	for (size_t p = 0; p < ARRAY_COUNT(PAYLOAD_SIZES); p++)
+	{
+		benchRing(PAYLOAD_SIZES[p], false);
+		benchRing(PAYLOAD_SIZES[p], true);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+// Compile / Run on Linux:
+// gcc -O2 -DNDEBUG -std=c99 -I../dynamic/cSDDS -I../static -I../stream Benchmark.c ../dynamic/cSDDS/BoundedSDDS.c ../dynamic/cSDDS/ConcurrentSDDS.c ../dynamic/cSDDS/SDDS.c ../dynamic/cSDDS/SDDSWriter.c ../dynamic/cSDDS/Memory.c ../static/CFListReader.c ../static/StaticSSDS.c ../stream/Compression.c ../stream/Query.c ../stream/RingBuffer.c -lpthread -o benchmark && ./benchmark --csv
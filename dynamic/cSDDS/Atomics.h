@@ -0,0 +1,85 @@
+// Header file for the few atomic operations cSDDS needs, on compilers without C11 atomics
+// (C) - Charles Machalow via the MIT License
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+
+// The interlocked functions are full barriers, which covers acquire and release
+static __inline uint32_t atomicLoadAcquire32(volatile uint32_t *p)
+{
+	return (uint32_t)_InterlockedOr((volatile long*)p, 0);
+}
+
+static __inline void atomicStoreRelease32(volatile uint32_t *p, uint32_t value)
+{
+	_InterlockedExchange((volatile long*)p, (long)value);
+}
+
+static __inline bool atomicCompareExchange32(volatile uint32_t *p, uint32_t expected, uint32_t desired)
+{
+	return (uint32_t)_InterlockedCompareExchange((volatile long*)p, (long)desired, (long)expected) == expected;
+}
+
+static __inline uint32_t atomicFetchAdd32(volatile uint32_t *p, uint32_t value)
+{
+	return (uint32_t)_InterlockedExchangeAdd((volatile long*)p, (long)value);
+}
+
+static __inline void* atomicLoadAcquirePointer(void *volatile *p)
+{
+	return _InterlockedCompareExchangePointer(p, NULL, NULL);
+}
+
+static __inline void* atomicExchangePointer(void *volatile *p, void *value)
+{
+	return _InterlockedExchangePointer(p, value);
+}
+
+// Orders every load and store before it with every one after it (including a store before with a load after)
+static __inline void atomicFence(void)
+{
+	volatile long fence = 0;
+	_InterlockedOr(&fence, 0);
+}
+#else
+static inline uint32_t atomicLoadAcquire32(volatile uint32_t *p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void atomicStoreRelease32(volatile uint32_t *p, uint32_t value)
+{
+	__atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+static inline bool atomicCompareExchange32(volatile uint32_t *p, uint32_t expected, uint32_t desired)
+{
+	return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t atomicFetchAdd32(volatile uint32_t *p, uint32_t value)
+{
+	return __atomic_fetch_add(p, value, __ATOMIC_ACQ_REL);
+}
+
+static inline void* atomicLoadAcquirePointer(void *volatile *p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void* atomicExchangePointer(void *volatile *p, void *value)
+{
+	return __atomic_exchange_n(p, value, __ATOMIC_ACQ_REL);
+}
+
+// Orders every load and store before it with every one after it (including a store before with a load after)
+static inline void atomicFence(void)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+#endif // _MSC_VER
@@ -0,0 +1,160 @@
+// Implementation file for an SDDS of bounded size that lives in a caller supplied block and never allocates
+// (C) - Charles Machalow via the MIT License
+
+// Local includes
+#include "BoundedSDDS.h"
+
+// The block is carved up as: Fields, FieldNames and FieldRefs (pointers), FieldSizes, FieldTypes, names, then payload.
+// Starting on a pointer boundary keeps every array aligned.
+#define BOUNDED_SDDS_ALIGNMENT sizeof(void*)
+
+size_t boundedSDDSBlockSize(uint32_t maxFields, uint32_t maxNameBytes, uint32_t maxPayloadBytes)
+{
+	uint64_t size = (BOUNDED_SDDS_ALIGNMENT - 1) + ((uint64_t)maxFields * ((3 * sizeof(void*)) + sizeof(uint32_t) + sizeof(BYTE))) + \
+		maxNameBytes + maxPayloadBytes;
+	return size > SIZE_MAX ? SIZE_MAX : (size_t)size;
+}
+
+bool boundedSDDSInit(BoundedSDDS *bsdds, void *block, size_t blockSize, uint32_t maxFields, uint32_t maxNameBytes, uint32_t maxPayloadBytes)
+{
+	if (!block || blockSize < boundedSDDSBlockSize(maxFields, maxNameBytes, maxPayloadBytes))
+	{
+		return false;
+	}
+
+	BYTE *cur = (BYTE*)block + ((BOUNDED_SDDS_ALIGNMENT - ((uintptr_t)block % BOUNDED_SDDS_ALIGNMENT)) % BOUNDED_SDDS_ALIGNMENT);
+	SDDS *view = &bsdds->View;
+	memset(view, 0, sizeof(SDDS));
+	view->Fields = (BYTE**)cur;
+	cur += maxFields * sizeof(BYTE*);
+	view->FieldNames = (char**)cur;
+	cur += maxFields * sizeof(char*);
+	view->FieldRefs = (SDDSFieldRef**)cur;
+	cur += maxFields * sizeof(SDDSFieldRef*);
+	view->FieldSizes = (uint32_t*)cur;
+	cur += maxFields * sizeof(uint32_t);
+	view->FieldTypes = cur;
+	cur += maxFields * sizeof(BYTE);
+	view->Initialized = true;
+
+	// Nothing here is ever shared with a snapshot
+	memset(view->FieldRefs, 0, maxFields * sizeof(SDDSFieldRef*));
+
+	bsdds->MaxFields = maxFields;
+	bsdds->Names = (char*)cur;
+	bsdds->NameBytesUsed = 0;
+	bsdds->MaxNameBytes = maxNameBytes;
+	bsdds->Payload = cur + maxNameBytes;
+	bsdds->PayloadBytesUsed = 0;
+	bsdds->MaxPayloadBytes = maxPayloadBytes;
+	return true;
+}
+
+bool boundedSDDSAddField(BoundedSDDS *bsdds, char *fieldName, uint32_t fieldSize, BYTE *rawField, BYTE fieldType)
+{
+	SDDS *view = &bsdds->View;
+	uint32_t nameLen = cStrLen(fieldName);
+	uint32_t byteSize = roundToByte(fieldSize);
+	if (!fieldName || view->FieldCount >= bsdds->MaxFields || (uint64_t)nameLen + 1 > bsdds->MaxNameBytes - bsdds->NameBytesUsed || \
+		byteSize > bsdds->MaxPayloadBytes - bsdds->PayloadBytesUsed || !isValidFieldType(fieldType, fieldSize, rawField) || \
+		getRawField(view, fieldName, NULL, NULL, NULL))
+	{
+		return false;
+	}
+
+	// Names and data are appended, so they stay in field order
+	uint32_t i = view->FieldCount;
+	view->FieldNames[i] = bsdds->Names + bsdds->NameBytesUsed;
+	memcpy(view->FieldNames[i], fieldName, nameLen + 1);
+	view->Fields[i] = bsdds->Payload + bsdds->PayloadBytesUsed;
+	if (byteSize)
+	{
+		memcpy(view->Fields[i], rawField, byteSize);
+	}
+	view->FieldSizes[i] = fieldSize;
+	view->FieldTypes[i] = fieldType;
+	bsdds->NameBytesUsed += nameLen + 1;
+	bsdds->PayloadBytesUsed += byteSize;
+
+	view->TotalBitSize += fieldSize;
+	view->XmlFieldsSize += getXmlFieldSize(nameLen, fieldSize, fieldType);
+	view->BinaryFieldsSize += getBinaryFieldSize(nameLen, fieldSize);
+	view->FieldCount++;
+	return true;
+}
+
+bool boundedSDDSAddU64(BoundedSDDS *bsdds, char *fieldName, uint64_t value)
+{
+	uint64_t stored = LITTLE_ENDIAN_64(value);
+	return boundedSDDSAddField(bsdds, fieldName, 64, (BYTE*)&stored, SDDS_TYPE_U64);
+}
+
+bool boundedSDDSAddI64(BoundedSDDS *bsdds, char *fieldName, int64_t value)
+{
+	uint64_t stored = LITTLE_ENDIAN_64((uint64_t)value);
+	return boundedSDDSAddField(bsdds, fieldName, 64, (BYTE*)&stored, SDDS_TYPE_I64);
+}
+
+bool boundedSDDSAddBool(BoundedSDDS *bsdds, char *fieldName, bool value)
+{
+	BYTE stored = value ? 1 : 0;
+	return boundedSDDSAddField(bsdds, fieldName, 1, &stored, SDDS_TYPE_BOOL);
+}
+
+bool boundedSDDSAddString(BoundedSDDS *bsdds, char *fieldName, const char *value)
+{
+	uint32_t fieldSize = 0;
+	if (!getStringFieldSize(value, &fieldSize))
+	{
+		return false;
+	}
+	return boundedSDDSAddField(bsdds, fieldName, fieldSize, (BYTE*)value, SDDS_TYPE_STRING);
+}
+
+bool boundedSDDSRemoveField(BoundedSDDS *bsdds, char *fieldName)
+{
+	SDDS *view = &bsdds->View;
+	uint32_t fieldIndex = 0;
+	if (!getRawField(view, fieldName, NULL, NULL, &fieldIndex))
+	{
+		return false;
+	}
+
+	// Take this field out of the running totals
+	uint32_t nameLen = cStrLen(view->FieldNames[fieldIndex]);
+	uint32_t fieldSize = view->FieldSizes[fieldIndex];
+	uint32_t byteSize = roundToByte(fieldSize);
+	view->TotalBitSize -= fieldSize;
+	view->XmlFieldsSize -= getXmlFieldSize(nameLen, fieldSize, view->FieldTypes[fieldIndex]);
+	view->BinaryFieldsSize -= getBinaryFieldSize(nameLen, fieldSize);
+
+	// Move the names and data after it down over it
+	char *nameEnd = view->FieldNames[fieldIndex] + nameLen + 1;
+	memmove(view->FieldNames[fieldIndex], nameEnd, (size_t)((bsdds->Names + bsdds->NameBytesUsed) - nameEnd));
+	BYTE *dataEnd = view->Fields[fieldIndex] + byteSize;
+	memmove(view->Fields[fieldIndex], dataEnd, (size_t)((bsdds->Payload + bsdds->PayloadBytesUsed) - dataEnd));
+	bsdds->NameBytesUsed -= nameLen + 1;
+	bsdds->PayloadBytesUsed -= byteSize;
+
+	// Move up everything after this
+	for (uint32_t i = fieldIndex; i < (view->FieldCount - 1); i++)
+	{
+		view->FieldSizes[i] = view->FieldSizes[i + 1];
+		view->FieldTypes[i] = view->FieldTypes[i + 1];
+		view->Fields[i] = view->Fields[i + 1] - byteSize;
+		view->FieldNames[i] = view->FieldNames[i + 1] - (nameLen + 1);
+	}
+
+	view->FieldCount--;
+	return true;
+}
+
+void boundedSDDSClear(BoundedSDDS *bsdds)
+{
+	bsdds->View.FieldCount = 0;
+	bsdds->View.TotalBitSize = 0;
+	bsdds->View.XmlFieldsSize = 0;
+	bsdds->View.BinaryFieldsSize = 0;
+	bsdds->NameBytesUsed = 0;
+	bsdds->PayloadBytesUsed = 0;
+}
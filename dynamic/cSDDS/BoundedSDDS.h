@@ -0,0 +1,76 @@
+// Header file for an SDDS of bounded size that lives in a caller supplied block and never allocates
+// (C) - Charles Machalow via the MIT License
+
+#pragma once
+
+// Local includes
+#include "SDDS.h"
+
+/// <summary>
+/// An SDDS with room for at most MaxFields fields, MaxNameBytes of names (null chars included) and MaxPayloadBytes of data,
+/// all kept in one caller block. No call here touches the allocator, and each one's worst case cost is given below
+/// (F fields, N bytes of a name, D bytes of a field's data).
+/// View is a regular SDDS over the block. It can be given to anything that only reads an SDDS and doesn't allocate:
+/// getRawField(), getWritableField(), the typed getters, the size getters, writeXml() and writeBinary()
+/// (both O(output size)). Functions that change it or allocate (addField(), removeField(), enableSortedIndex(),
+/// diffSDDS(), toXml(), toBinary(), toString(), snapshotSDDS(), closeSDDS()) must not be used on it.
+/// Lookups are linear, so getRawField() on it is O(F * N).
+/// </summary>
+typedef struct BoundedSDDS {
+	SDDS View;
+	uint32_t MaxFields;
+	char* Names;              // Names of the fields, packed in field order
+	uint32_t NameBytesUsed;
+	uint32_t MaxNameBytes;
+	BYTE* Payload;            // Data of the fields, packed in field order
+	uint32_t PayloadBytesUsed;
+	uint32_t MaxPayloadBytes;
+} BoundedSDDS;
+
+/// <summary>
+/// Returns how big a block boundedSDDSInit() needs for the given limits (with room to align it). O(1).
+/// </summary>
+size_t boundedSDDSBlockSize(uint32_t maxFields, uint32_t maxNameBytes, uint32_t maxPayloadBytes);
+
+/// <summary>
+/// Sets up an empty BoundedSDDS in block, which has to stay around as long as it is used (there is nothing to close).
+/// Returns false if blockSize is less than boundedSDDSBlockSize(). O(F) for the limit F.
+/// </summary>
+bool boundedSDDSInit(BoundedSDDS *bsdds, void *block, size_t blockSize, uint32_t maxFields, uint32_t maxNameBytes, uint32_t maxPayloadBytes);
+
+/// <summary>
+/// Adds a copy of the field, like addField(). Returns false if the name is taken, the data doesn't fit the type
+/// or a limit would be passed. O(F * N + D).
+/// </summary>
+bool boundedSDDSAddField(BoundedSDDS *bsdds, char *fieldName, uint32_t fieldSize, BYTE *rawField, BYTE fieldType);
+
+/// <summary>
+/// Adds a 64 bit unsigned field, like addU64(). O(F * N).
+/// </summary>
+bool boundedSDDSAddU64(BoundedSDDS *bsdds, char *fieldName, uint64_t value);
+
+/// <summary>
+/// Adds a 64 bit signed field, like addI64(). O(F * N).
+/// </summary>
+bool boundedSDDSAddI64(BoundedSDDS *bsdds, char *fieldName, int64_t value);
+
+/// <summary>
+/// Adds a 1 bit boolean field, like addBool(). O(F * N).
+/// </summary>
+bool boundedSDDSAddBool(BoundedSDDS *bsdds, char *fieldName, bool value);
+
+/// <summary>
+/// Adds a null terminated string field, like addString(). O(F * N + D).
+/// </summary>
+bool boundedSDDSAddString(BoundedSDDS *bsdds, char *fieldName, const char *value);
+
+/// <summary>
+/// Removes a field, like removeField(). The names and data after it are moved down so the space is reused.
+/// Returns false if there is no such field. O(F * N + the limits on name and payload bytes).
+/// </summary>
+bool boundedSDDSRemoveField(BoundedSDDS *bsdds, char *fieldName);
+
+/// <summary>
+/// Removes every field. O(1).
+/// </summary>
+void boundedSDDSClear(BoundedSDDS *bsdds);
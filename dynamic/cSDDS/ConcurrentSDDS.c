@@ -0,0 +1,149 @@
+// Implementation file for an SDDS shared by many reading threads and one writing thread
+// (C) - Charles Machalow via the MIT License
+
+#include "Atomics.h"
+#include "ConcurrentSDDS.h"
+
+/*
+*
+* Functions relating to versions
+*
+*/
+
+// Returns a new version holding a snapshot of sdds, or NULL if it can't be allocated
+static SDDS* newVersion(SDDS *sdds)
+{
+	SDDS *version = (SDDS*)memCalloc(1, sizeof(SDDS));
+	if (version && !snapshotSDDS(sdds, version))
+	{
+		memFree(version);
+		return NULL;
+	}
+	return version;
+}
+
+static void freeVersion(SDDS *version)
+{
+	closeSDDS(version);
+	memFree(version);
+}
+
+// Frees the retired versions that were replaced before the oldest epoch a reader has pinned
+static void reclaimVersions(ConcurrentSDDS *csdds)
+{
+	// Epochs wrap, so they are compared by their difference
+	uint32_t readerCount = atomicLoadAcquire32(&csdds->ReaderCount);
+	readerCount = readerCount < CONCURRENT_SDDS_MAX_READERS ? readerCount : CONCURRENT_SDDS_MAX_READERS;
+	bool reading = false;
+	uint32_t oldest = 0;
+	for (uint32_t i = 0; i < readerCount; i++)
+	{
+		uint32_t epoch = atomicLoadAcquire32(&csdds->ReaderEpochs[i]);
+		if (epoch && (!reading || (int32_t)(epoch - oldest) < 0))
+		{
+			oldest = epoch;
+			reading = true;
+		}
+	}
+
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < csdds->RetiredCount; i++)
+	{
+		if (reading && (int32_t)(csdds->Retired[i].Epoch - oldest) >= 0)
+		{
+			csdds->Retired[kept++] = csdds->Retired[i];
+		}
+		else
+		{
+			freeVersion(csdds->Retired[i].Version);
+		}
+	}
+	csdds->RetiredCount = kept;
+}
+
+bool concurrentSDDSOpen(ConcurrentSDDS *csdds)
+{
+	memset(csdds, 0, sizeof(ConcurrentSDDS));
+	initialize(&csdds->Writer);
+	csdds->Epoch = 1;
+	csdds->Current = newVersion(&csdds->Writer);
+	return csdds->Current != NULL;
+}
+
+uint32_t concurrentSDDSAddReader(ConcurrentSDDS *csdds)
+{
+	uint32_t reader = atomicFetchAdd32(&csdds->ReaderCount, 1);
+	return reader < CONCURRENT_SDDS_MAX_READERS ? reader : CONCURRENT_SDDS_NO_READER;
+}
+
+SDDS* concurrentSDDSReadBegin(ConcurrentSDDS *csdds, uint32_t reader)
+{
+	// The fence keeps the pinned epoch from being missed by a writer that has already swapped in a newer version.
+	// A writer that saw this reader as idle swapped before the fence, so the load below gets its new version.
+	atomicStoreRelease32(&csdds->ReaderEpochs[reader], atomicLoadAcquire32(&csdds->Epoch));
+	atomicFence();
+	return (SDDS*)atomicLoadAcquirePointer((void *volatile *)&csdds->Current);
+}
+
+void concurrentSDDSReadEnd(ConcurrentSDDS *csdds, uint32_t reader)
+{
+	atomicStoreRelease32(&csdds->ReaderEpochs[reader], 0);
+}
+
+SDDS* concurrentSDDSWriter(ConcurrentSDDS *csdds)
+{
+	return &csdds->Writer;
+}
+
+bool concurrentSDDSPublish(ConcurrentSDDS *csdds)
+{
+	// Make room to retire the current version first, so nothing can fail once it is replaced
+	ConcurrentSDDSRetired *retired = (ConcurrentSDDSRetired*)memRealloc(csdds->Retired, (csdds->RetiredCount + 1) * sizeof(ConcurrentSDDSRetired));
+	if (!retired)
+	{
+		return false;
+	}
+	csdds->Retired = retired;
+
+	SDDS *version = newVersion(&csdds->Writer);
+	if (!version)
+	{
+		return false;
+	}
+
+	// Readers that pin the next epoch are sure to see the new version, so the replaced one only waits on this epoch
+	uint32_t epoch = csdds->Epoch;
+	retired[csdds->RetiredCount].Version = (SDDS*)atomicExchangePointer((void *volatile *)&csdds->Current, version);
+	retired[csdds->RetiredCount].Epoch = epoch;
+	csdds->RetiredCount++;
+	atomicStoreRelease32(&csdds->Epoch, (epoch + 1) ? (epoch + 1) : 1);
+	atomicFence();
+
+	reclaimVersions(csdds);
+	return true;
+}
+
+bool concurrentSDDSAddField(ConcurrentSDDS *csdds, char *fieldName, uint32_t fieldSize, BYTE *rawField, BYTE fieldType)
+{
+	return addField(&csdds->Writer, fieldName, fieldSize, rawField, fieldType) && concurrentSDDSPublish(csdds);
+}
+
+bool concurrentSDDSRemoveField(ConcurrentSDDS *csdds, char *fieldName)
+{
+	return removeField(&csdds->Writer, fieldName) && concurrentSDDSPublish(csdds);
+}
+
+void concurrentSDDSClose(ConcurrentSDDS *csdds)
+{
+	for (uint32_t i = 0; i < csdds->RetiredCount; i++)
+	{
+		freeVersion(csdds->Retired[i].Version);
+	}
+	if (csdds->Current)
+	{
+		freeVersion(csdds->Current);
+	}
+	memFree(csdds->Retired);
+	closeSDDS(&csdds->Writer);
+	memset(csdds, 0, sizeof(ConcurrentSDDS));
+}
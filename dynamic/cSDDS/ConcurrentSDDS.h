@@ -0,0 +1,90 @@
+// Header file for an SDDS shared by many reading threads and one writing thread
+// (C) - Charles Machalow via the MIT License
+
+#pragma once
+
+// Local includes
+#include "SDDS.h"
+
+// Most reader threads one ConcurrentSDDS can have
+#define CONCURRENT_SDDS_MAX_READERS 64
+
+// Returned by concurrentSDDSAddReader() when every reader slot is taken
+#define CONCURRENT_SDDS_NO_READER   0xFFFFFFFF
+
+// A version the writer replaced, freed once no reader can still be looking at it
+typedef struct ConcurrentSDDSRetired {
+	SDDS* Version;
+	uint32_t Epoch; // Epoch it was replaced in
+} ConcurrentSDDSRetired;
+
+/// <summary>
+/// An SDDS that readers look fields up in without locks while a writer changes it.
+/// The writer changes its own SDDS and then publishes it: a snapshot of it (see snapshotSDDS(), so unchanged fields are shared)
+/// becomes the version readers see, with one pointer swap. Readers pin the current version for as long as they read it,
+/// and replaced versions are freed (epoch based reclamation) once every reader that could have pinned them has moved on.
+/// Reading never waits on the writer or on other readers, and the writer never waits on readers.
+/// </summary>
+typedef struct ConcurrentSDDS {
+	SDDS Writer;                    // Only touched by the writing thread
+	SDDS* volatile Current;         // Version readers see
+	volatile uint32_t Epoch;        // Goes up with every publish (skipping 0)
+	volatile uint32_t ReaderEpochs[CONCURRENT_SDDS_MAX_READERS]; // Epoch each reader pinned a version in, 0 while not reading
+	volatile uint32_t ReaderCount;  // Reader slots handed out
+	ConcurrentSDDSRetired* Retired; // Replaced versions still waiting on readers
+	uint32_t RetiredCount;
+} ConcurrentSDDS;
+
+/// <summary>
+/// Sets up a ConcurrentSDDS with an empty version. Returns false if it can't be allocated.
+/// </summary>
+bool concurrentSDDSOpen(ConcurrentSDDS *csdds);
+
+/// <summary>
+/// Gives the calling thread a reader slot to pass to the read calls (one per thread, kept until the ConcurrentSDDS is closed).
+/// Returns CONCURRENT_SDDS_NO_READER if all CONCURRENT_SDDS_MAX_READERS are taken.
+/// </summary>
+uint32_t concurrentSDDSAddReader(ConcurrentSDDS *csdds);
+
+/// <summary>
+/// Pins the current version and returns it. Anything that only reads an SDDS (getRawField(), the typed getters, toXml(), ...)
+/// can be used on it, and the pointers they give back stay valid until concurrentSDDSReadEnd(). Calls that build the sorted
+/// index must not be used (enable it on the writer instead, and every version will have it). Wait free.
+/// </summary>
+SDDS* concurrentSDDSReadBegin(ConcurrentSDDS *csdds, uint32_t reader);
+
+/// <summary>
+/// Unpins the version pinned by concurrentSDDSReadBegin()
+/// </summary>
+void concurrentSDDSReadEnd(ConcurrentSDDS *csdds, uint32_t reader);
+
+/// <summary>
+/// Returns the writer's SDDS, for making several changes that are published together by concurrentSDDSPublish().
+/// Every publish copies the field arrays (O(FieldCount)), so bulk changes should be made here and published once
+/// rather than through concurrentSDDSAddField()/concurrentSDDSRemoveField(), which publish each change.
+/// Data written in place has to go through getWritableField(), since published versions share it.
+/// </summary>
+SDDS* concurrentSDDSWriter(ConcurrentSDDS *csdds);
+
+/// <summary>
+/// Makes the writer's SDDS the version readers see, then frees the replaced versions no reader has pinned.
+/// Returns false if the new version can't be allocated (readers keep seeing the last one).
+/// </summary>
+bool concurrentSDDSPublish(ConcurrentSDDS *csdds);
+
+/// <summary>
+/// addField() on the writer's SDDS, published. Returns true on success. If only the publish fails,
+/// the field is still added and goes out with the next publish. For many fields use concurrentSDDSWriter() instead.
+/// </summary>
+bool concurrentSDDSAddField(ConcurrentSDDS *csdds, char *fieldName, uint32_t fieldSize, BYTE *rawField, BYTE fieldType);
+
+/// <summary>
+/// removeField() on the writer's SDDS, published. Returns true on success. If only the publish fails,
+/// the field is still removed and goes out with the next publish. For many fields use concurrentSDDSWriter() instead.
+/// </summary>
+bool concurrentSDDSRemoveField(ConcurrentSDDS *csdds, char *fieldName);
+
+/// <summary>
+/// Frees everything. No reader may be reading.
+/// </summary>
+void concurrentSDDSClose(ConcurrentSDDS *csdds);
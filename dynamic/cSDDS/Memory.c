@@ -3,6 +3,117 @@
 
 #include "Memory.h"
 
+/*
+*
+* Functions relating to allocations
+*
+*/
+
+static THREAD_LOCAL MemoryStats memoryStats;
+
+static void* defaultRealloc(void *context, void *ptr, size_t size)
+{
+	(void)context;
+	return realloc(ptr, size);
+}
+
+static void defaultFree(void *context, void *ptr)
+{
+	(void)context;
+	free(ptr);
+}
+
+static SDDSAllocator currentAllocator = { defaultRealloc, defaultFree, NULL };
+
+void setAllocator(const SDDSAllocator *allocator)
+{
+	if (allocator)
+	{
+		currentAllocator = *allocator;
+	}
+	else
+	{
+		currentAllocator.Realloc = defaultRealloc;
+		currentAllocator.Free = defaultFree;
+		currentAllocator.Context = NULL;
+	}
+}
+
+void* memAlloc(size_t size)
+{
+	memoryStats.Allocations++;
+	memoryStats.AllocatedBytes += size;
+	return currentAllocator.Realloc(currentAllocator.Context, NULL, size);
+}
+
+void* memCalloc(size_t count, size_t size)
+{
+	if (size && count > SIZE_MAX / size)
+	{
+		return NULL;
+	}
+
+	void *ptr = memAlloc(count * size);
+	if (ptr)
+	{
+		memset(ptr, 0, count * size);
+	}
+	return ptr;
+}
+
+void* memRealloc(void *ptr, size_t size)
+{
+	memoryStats.Allocations++;
+	memoryStats.AllocatedBytes += size;
+	return currentAllocator.Realloc(currentAllocator.Context, ptr, size);
+}
+
+void memFree(void *ptr)
+{
+	if (ptr)
+	{
+		memoryStats.Frees++;
+		currentAllocator.Free(currentAllocator.Context, ptr);
+	}
+}
+
+MemoryStats getMemoryStats(void)
+{
+	return memoryStats;
+}
+
+void resetMemoryStats(void)
+{
+	memset(&memoryStats, 0, sizeof(memoryStats));
+}
+
+/*
+*
+* Hot path instrumentation
+*
+*/
+
+#ifdef CSDDS_INSTRUMENTATION
+THREAD_LOCAL SDDSCounters sddsCounters;
+#endif // CSDDS_INSTRUMENTATION
+
+SDDSCounters getSDDSCounters(void)
+{
+#ifdef CSDDS_INSTRUMENTATION
+	return sddsCounters;
+#else
+	SDDSCounters counters = { 0 };
+	return counters;
+#endif // CSDDS_INSTRUMENTATION
+}
+
+void resetSDDSCounters(void)
+{
+#ifdef CSDDS_INSTRUMENTATION
+	memset(&sddsCounters, 0, sizeof(sddsCounters));
+#endif // CSDDS_INSTRUMENTATION
+}
+
 /*
 *
 * Functions relating to C Strings
@@ -20,6 +131,7 @@ uint32_t cStrLen(char *s)
 
 bool stringAppend(char **pOrigStr, char *newStr)
 {
+	COUNT_EVENT(StringAppends);
 	char *origStr;
 	if (pOrigStr)
 	{
@@ -32,7 +144,7 @@ bool stringAppend(char **pOrigStr, char *newStr)
 
 	uint32_t origLen = cStrLen(origStr);
 	uint32_t newLen = cStrLen(newStr);
-	char* appendedStr = (char*)realloc(origStr, origLen + newLen + 1); // Add 1 for null char
+	char* appendedStr = (char*)memRealloc(origStr, origLen + newLen + 1); // Add 1 for null char
 	if (appendedStr)
 	{
 		memcpy(appendedStr + origLen, newStr, newLen);
@@ -45,7 +157,8 @@ bool stringAppend(char **pOrigStr, char *newStr)
 
 bool newStrCopy(char **pNewName, char *oldName)
 {
-	char* newName = (char*)calloc(cStrLen(oldName) + 1, sizeof(char));
+	COUNT_EVENT(StringCopies);
+	char* newName = (char*)memCalloc(cStrLen(oldName) + 1, sizeof(char));
 	if (newName)
 	{
 		strcpy(newName, oldName);
@@ -55,6 +168,28 @@ bool newStrCopy(char **pNewName, char *oldName)
 	return false;
 }
 
+uint32_t countDecimalDigits(uint32_t value)
+{
+	uint32_t digits = 1;
+	while (value >= 10)
+	{
+		value /= 10;
+		digits++;
+	}
+	return digits;
+}
+
+uint32_t writeDecimal(char *dest, uint32_t value)
+{
+	uint32_t digits = countDecimalDigits(value);
+	for (uint32_t i = digits; i > 0; i--)
+	{
+		dest[i - 1] = (char)('0' + (value % 10));
+		value /= 10;
+	}
+	return digits;
+}
+
 /*
 *
 * Functions relating to raw memory
@@ -63,25 +198,85 @@ bool newStrCopy(char **pNewName, char *oldName)
 
 uint32_t roundToByte(uint32_t bits)
 {
-	return (uint32_t)ceill(bits / 8.0);
+	// Integer math only, and safe for bits near UINT32_MAX
+	return (bits / 8) + ((bits % 8) != 0);
 }
 
 bool newRawCopy(BYTE **pNewName, BYTE *oldName, uint32_t fieldSize)
 {
-	BYTE* newName = (BYTE*)calloc(fieldSize, sizeof(BYTE));
+	COUNT_EVENT(RawCopies);
+	uint32_t byteSize = roundToByte(fieldSize);
+	BYTE* newName = (BYTE*)memCalloc(byteSize, sizeof(BYTE));
 	if (newName)
 	{
-		memcpy(newName, oldName, roundToByte(fieldSize));
+		memcpy(newName, oldName, byteSize);
 		*pNewName = newName;
 		return true;
 	}
 	return false;
 }
 
+void* memAppend(void *dest, const void *src, size_t len)
+{
+	memcpy(dest, src, len);
+	return (BYTE*)dest + len;
+}
+
+void copyLittleEndian(void *dest, const void *src, uint32_t elementSize, size_t count)
+{
+	if (dest != src)
+	{
+		memcpy(dest, src, elementSize * count);
+	}
+#if SDDS_BIG_ENDIAN
+	BYTE *element = (BYTE*)dest;
+	for (size_t i = 0; i < count; i++, element += elementSize)
+	{
+		switch (elementSize)
+		{
+		case sizeof(uint16_t):
+		{
+			uint16_t value;
+			memcpy(&value, element, sizeof(value));
+			value = LITTLE_ENDIAN_16(value);
+			memcpy(element, &value, sizeof(value));
+			break;
+		}
+		case sizeof(uint32_t):
+		{
+			uint32_t value;
+			memcpy(&value, element, sizeof(value));
+			value = LITTLE_ENDIAN_32(value);
+			memcpy(element, &value, sizeof(value));
+			break;
+		}
+		case sizeof(uint64_t):
+		{
+			uint64_t value;
+			memcpy(&value, element, sizeof(value));
+			value = LITTLE_ENDIAN_64(value);
+			memcpy(element, &value, sizeof(value));
+			break;
+		}
+		default:
+			// Odd sizes get their bytes reversed one at a time
+			for (uint32_t low = 0, high = elementSize - 1; low < high; low++, high--)
+			{
+				BYTE tmp = element[low];
+				element[low] = element[high];
+				element[high] = tmp;
+			}
+			break;
+		}
+	}
+#endif // SDDS_BIG_ENDIAN
+}
+
 bool addTo32BitArray(uint32_t **array32, uint32_t newSize, uint32_t newValue)
 {
+	COUNT_EVENT(ArrayAppends);
 	// Allocate up 1.
-	uint32_t *tmp = (uint32_t*)realloc(*array32, newSize * sizeof(uint32_t));
+	uint32_t *tmp = (uint32_t*)memRealloc(*array32, newSize * sizeof(uint32_t));
 	if (tmp)
 	{
 		tmp[newSize - 1] = newValue;
@@ -93,8 +288,9 @@ bool addTo32BitArray(uint32_t **array32, uint32_t newSize, uint32_t newValue)
 
 bool addTo8BitArray(uint8_t **array8, uint32_t newSize, uint8_t newValue)
 {
+	COUNT_EVENT(ArrayAppends);
 	// Allocate up 1.
-	uint8_t *tmp = (uint8_t*)realloc(*array8, newSize * sizeof(uint8_t));
+	uint8_t *tmp = (uint8_t*)memRealloc(*array8, newSize * sizeof(uint8_t));
 	if (tmp)
 	{
 		tmp[newSize - 1] = newValue;
@@ -106,8 +302,9 @@ bool addTo8BitArray(uint8_t **array8, uint32_t newSize, uint8_t newValue)
 
 bool reallocPPPByte(BYTE ***pppByte, uint32_t newSize, uint8_t* newValue)
 {
+	COUNT_EVENT(PointerArrayReallocs);
 	// Allocate up 1.
-	uint8_t **tmp = (uint8_t**)realloc(*pppByte, newSize * sizeof(uint8_t**));
+	uint8_t **tmp = (uint8_t**)memRealloc(*pppByte, newSize * sizeof(uint8_t**));
 	if (tmp)
 	{
 		tmp[newSize - 1] = newValue;
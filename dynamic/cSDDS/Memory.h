@@ -7,7 +7,6 @@
 #pragma warning(disable:4996) // Disable unsecure function warnings like strcpy and keep this compatible with Linux
 #endif // _WIN32
 
-#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -16,6 +15,116 @@
 
 typedef uint8_t BYTE;
 
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+// Byte order. Everything cSDDS writes is little endian, so on little endian hosts the conversions compile away.
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define SDDS_BIG_ENDIAN 1
+#define LITTLE_ENDIAN_16(value) __builtin_bswap16(value) // Each converts either way between host and little endian
+#define LITTLE_ENDIAN_32(value) __builtin_bswap32(value)
+#define LITTLE_ENDIAN_64(value) __builtin_bswap64(value)
+#else
+#define SDDS_BIG_ENDIAN 0
+#define LITTLE_ENDIAN_16(value) (value)
+#define LITTLE_ENDIAN_32(value) (value)
+#define LITTLE_ENDIAN_64(value) (value)
+#endif
+
+/*
+*
+* Functions relating to allocations
+*
+*/
+
+// Counts of allocations made through the functions below (on the calling thread)
+typedef struct MemoryStats {
+	uint64_t Allocations;    // Calls to memAlloc, memCalloc and memRealloc
+	uint64_t AllocatedBytes; // Bytes requested by those calls
+	uint64_t Frees;          // Calls to memFree with a non-null pointer
+} MemoryStats;
+
+// Pluggable allocator. Realloc is given NULL for new allocations, and Free is never given NULL.
+typedef struct SDDSAllocator {
+	void* (*Realloc)(void *context, void *ptr, size_t size);
+	void (*Free)(void *context, void *ptr);
+	void *Context;
+} SDDSAllocator;
+
+/// <summary>
+/// Routes all SDDS allocations through the given allocator. Pass NULL to go back to realloc/free.
+/// Should be set before anything is allocated, since memory has to be freed by the allocator that made it.
+/// </summary>
+void setAllocator(const SDDSAllocator *allocator);
+
+/// <summary>
+/// malloc that is tracked in the MemoryStats
+/// </summary>
+void* memAlloc(size_t size);
+
+/// <summary>
+/// calloc that is tracked in the MemoryStats
+/// </summary>
+void* memCalloc(size_t count, size_t size);
+
+/// <summary>
+/// realloc that is tracked in the MemoryStats
+/// </summary>
+void* memRealloc(void *ptr, size_t size);
+
+/// <summary>
+/// free that is tracked in the MemoryStats. Use this for anything returned by the SDDS functions.
+/// </summary>
+void memFree(void *ptr);
+
+/// <summary>
+/// Returns the MemoryStats for the calling thread
+/// </summary>
+MemoryStats getMemoryStats(void);
+
+/// <summary>
+/// Zeros the MemoryStats for the calling thread
+/// </summary>
+void resetMemoryStats(void);
+
+/*
+*
+* Hot path instrumentation (compiled in with CSDDS_INSTRUMENTATION)
+*
+*/
+
+// Counts of hot path events (on the calling thread). Always zero unless built with CSDDS_INSTRUMENTATION.
+typedef struct SDDSCounters {
+	uint64_t StringAppends;        // Calls to stringAppend
+	uint64_t StringCopies;         // Calls to newStrCopy
+	uint64_t RawCopies;            // Calls to newRawCopy
+	uint64_t ArrayAppends;         // Calls to addTo32BitArray and addTo8BitArray
+	uint64_t PointerArrayReallocs; // Calls to reallocPPPByte
+	uint64_t LookupComparisons;    // Field name comparisons done by getRawField
+} SDDSCounters;
+
+#ifdef CSDDS_INSTRUMENTATION
+extern THREAD_LOCAL SDDSCounters sddsCounters;
+#define COUNT_EVENT(counter) (sddsCounters.counter++)
+#else
+#define COUNT_EVENT(counter) ((void)0)
+#endif // CSDDS_INSTRUMENTATION
+
+/// <summary>
+/// Returns the SDDSCounters for the calling thread
+/// </summary>
+SDDSCounters getSDDSCounters(void);
+
+/// <summary>
+/// Zeros the SDDSCounters for the calling thread
+/// </summary>
+void resetSDDSCounters(void);
+
 /*
 *
 * Functions relating to C Strings
@@ -37,6 +146,16 @@ bool stringAppend(char **pOrigStr, char *newStr);
 /// </summary>
 bool newStrCopy(char **pNewName, char *oldName);
 
+/// <summary>
+/// Returns the number of characters needed to print value in decimal
+/// </summary>
+uint32_t countDecimalDigits(uint32_t value);
+
+/// <summary>
+/// Writes value in decimal to dest (without a null char). Returns the number of characters written.
+/// </summary>
+uint32_t writeDecimal(char *dest, uint32_t value);
+
 /*
 *
 * Functions relating to raw memory
@@ -53,6 +172,17 @@ uint32_t roundToByte(uint32_t bits);
 /// </summary>
 bool newRawCopy(BYTE **pNewName, BYTE *oldName, uint32_t fieldSize);
 
+/// <summary>
+/// memcpy's len bytes of src to dest and returns the location just after what was copied
+/// </summary>
+void* memAppend(void *dest, const void *src, size_t len);
+
+/// <summary>
+/// Copies count elements of elementSize bytes, converting each between host and little endian byte order.
+/// A plain memcpy on little endian hosts. dest and src can be the same to convert in place.
+/// </summary>
+void copyLittleEndian(void *dest, const void *src, uint32_t elementSize, size_t count);
+
 /// <summary>
 /// Adds the new 32bit value to the array. Returns true on success.
 /// </summary>
@@ -0,0 +1,1548 @@
+// cSDDS - Self Describing Data Steam - Implementation of the SDDS
+// (C) - Charles Machalow via the MIT License 
+
+#include <assert.h>
+#include <inttypes.h>
+
+// Local includes
+#include "Atomics.h"
+#include "SDDS.h"
+
+// Hmm may not need this method if we are forcing users to set their SDDS to all 0.
+void initialize(SDDS *sdds)
+{
+	if (!sdds->Initialized)
+	{
+		sdds->Fields = NULL;            // List of raw fields
+		sdds->FieldNames = NULL;        // List of field names
+		sdds->FieldSizes = NULL;        // Used to know the size IN BITS of each field
+		sdds->FieldTypes = NULL;        // SDDSFieldType of each field
+		sdds->FieldCount = 0;           // Number of fields
+		sdds->TotalBitSize = 0;
+		sdds->XmlFieldsSize = 0;
+		sdds->BinaryFieldsSize = 0;
+		sdds->SortedIndex = NULL;       // Field indices in name order
+		sdds->FieldRefs = NULL;         // Reference counts of fields shared with snapshots
+		sdds->HasSortedIndex = false;
+	}
+	sdds->Initialized = true;
+}
+
+/*
+*
+* Functions relating to the sorted name index
+*
+*/
+
+// Compares at most compareLen characters (SIZE_MAX for all of them) of the name at the given sorted position against key
+static int compareSortedName(SDDS *sdds, uint32_t position, const char *key, size_t compareLen)
+{
+	COUNT_EVENT(LookupComparisons);
+	const char *name = sdds->FieldNames[sdds->SortedIndex[position]];
+	return (compareLen == SIZE_MAX) ? strcmp(name, key) : strncmp(name, key, compareLen);
+}
+
+// Returns the first sorted position whose name compares >= key (or > key if pastEqual), only looking at compareLen characters (SIZE_MAX for all)
+static uint32_t findSortedPosition(SDDS *sdds, const char *key, size_t compareLen, bool pastEqual)
+{
+	uint32_t low = 0;
+	uint32_t high = sdds->FieldCount;
+	while (low < high)
+	{
+		uint32_t mid = low + ((high - low) / 2);
+		int cmp = compareSortedName(sdds, mid, key, compareLen);
+		if (cmp < 0 || (pastEqual && cmp == 0))
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+// Returns the sorted position of the field with exactly this name, or SDDS_NO_INDEX
+static uint32_t findSortedName(SDDS *sdds, const char *fieldName)
+{
+	uint32_t position = findSortedPosition(sdds, fieldName, SIZE_MAX, false);
+	if (position < sdds->FieldCount && strcmp(sdds->FieldNames[sdds->SortedIndex[position]], fieldName) == 0)
+	{
+		return position;
+	}
+	return SDDS_NO_INDEX;
+}
+
+// Moves the field index at root down the heap of count entries until it is in place
+static void siftDown(SDDS *sdds, uint32_t *heap, uint32_t root, uint32_t count)
+{
+	for (uint32_t child = (2 * root) + 1; child < count; child = (2 * root) + 1)
+	{
+		if (child + 1 < count && strcmp(sdds->FieldNames[heap[child]], sdds->FieldNames[heap[child + 1]]) < 0)
+		{
+			child++;
+		}
+		if (strcmp(sdds->FieldNames[heap[root]], sdds->FieldNames[heap[child]]) >= 0)
+		{
+			return;
+		}
+		uint32_t tmp = heap[root];
+		heap[root] = heap[child];
+		heap[child] = tmp;
+		root = child;
+	}
+}
+
+// Sorts field indices by name in place (heap sort, so no extra memory and no global state for a comparator)
+static void sortFieldIndices(SDDS *sdds, uint32_t *indices, uint32_t count)
+{
+	for (uint32_t i = count / 2; i-- > 0;)
+	{
+		siftDown(sdds, indices, i, count);
+	}
+	for (uint32_t end = count; end-- > 1;)
+	{
+		uint32_t tmp = indices[0];
+		indices[0] = indices[end];
+		indices[end] = tmp;
+		siftDown(sdds, indices, 0, end);
+	}
+}
+
+bool enableSortedIndex(SDDS *sdds)
+{
+	initialize(sdds);
+	if (sdds->HasSortedIndex)
+	{
+		return true;
+	}
+
+	if (sdds->FieldCount)
+	{
+		uint32_t *sortedIndex = (uint32_t*)memRealloc(sdds->SortedIndex, sdds->FieldCount * sizeof(uint32_t));
+		if (!sortedIndex)
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < sdds->FieldCount; i++)
+		{
+			sortedIndex[i] = i;
+		}
+
+		// Names are unique, so an unstable sort is fine
+		sortFieldIndices(sdds, sortedIndex, sdds->FieldCount);
+		sdds->SortedIndex = sortedIndex;
+	}
+	sdds->HasSortedIndex = true;
+	return true;
+}
+
+uint32_t getSortedFieldIndex(SDDS *sdds, uint32_t position)
+{
+	assert(sdds->HasSortedIndex && position < sdds->FieldCount);
+	return sdds->SortedIndex[position];
+}
+
+uint32_t findFieldRange(SDDS *sdds, const char *firstName, const char *lastName, uint32_t *startPosition)
+{
+	*startPosition = 0;
+	if (!enableSortedIndex(sdds))
+	{
+		return 0;
+	}
+
+	uint32_t start = firstName ? findSortedPosition(sdds, firstName, SIZE_MAX, false) : 0;
+	uint32_t end = lastName ? findSortedPosition(sdds, lastName, SIZE_MAX, false) : sdds->FieldCount;
+	*startPosition = start;
+	return end > start ? end - start : 0;
+}
+
+uint32_t findFieldsWithPrefix(SDDS *sdds, const char *prefix, uint32_t *startPosition)
+{
+	*startPosition = 0;
+	if (!enableSortedIndex(sdds))
+	{
+		return 0;
+	}
+
+	// Cutting names down to the prefix length keeps them in order, so the matches are one run
+	size_t prefixLen = cStrLen((char*)prefix);
+	uint32_t start = findSortedPosition(sdds, prefix, prefixLen, false);
+	uint32_t end = findSortedPosition(sdds, prefix, prefixLen, true);
+	*startPosition = start;
+	return end - start;
+}
+
+// Returns true if the fields at the two indices hold the same size, type and data (data shared by a snapshot isn't compared)
+static bool fieldsMatch(SDDS *a, uint32_t aIndex, SDDS *b, uint32_t bIndex)
+{
+	return a->FieldSizes[aIndex] == b->FieldSizes[bIndex] && \
+		a->FieldTypes[aIndex] == b->FieldTypes[bIndex] && \
+		(a->Fields[aIndex] == b->Fields[bIndex] || memcmp(a->Fields[aIndex], b->Fields[bIndex], roundToByte(a->FieldSizes[aIndex])) == 0);
+}
+
+bool diffSDDS(SDDS *before, SDDS *after, SDDSDiffCallback callback, void *context)
+{
+	if (!enableSortedIndex(before) || !enableSortedIndex(after))
+	{
+		return false;
+	}
+
+	// Merge the two sorted name lists
+	uint32_t b = 0;
+	uint32_t a = 0;
+	while (b < before->FieldCount || a < after->FieldCount)
+	{
+		uint32_t beforeIndex = (b < before->FieldCount) ? before->SortedIndex[b] : SDDS_NO_INDEX;
+		uint32_t afterIndex = (a < after->FieldCount) ? after->SortedIndex[a] : SDDS_NO_INDEX;
+		int cmp;
+		if (beforeIndex == SDDS_NO_INDEX)
+		{
+			cmp = 1;
+		}
+		else if (afterIndex == SDDS_NO_INDEX)
+		{
+			cmp = -1;
+		}
+		else
+		{
+			cmp = strcmp(before->FieldNames[beforeIndex], after->FieldNames[afterIndex]);
+		}
+
+		if (cmp < 0)
+		{
+			callback(context, SDDS_DIFF_REMOVED, before->FieldNames[beforeIndex], beforeIndex, SDDS_NO_INDEX);
+			b++;
+		}
+		else if (cmp > 0)
+		{
+			callback(context, SDDS_DIFF_ADDED, after->FieldNames[afterIndex], SDDS_NO_INDEX, afterIndex);
+			a++;
+		}
+		else
+		{
+			if (!fieldsMatch(before, beforeIndex, after, afterIndex))
+			{
+				callback(context, SDDS_DIFF_CHANGED, before->FieldNames[beforeIndex], beforeIndex, afterIndex);
+			}
+			b++;
+			a++;
+		}
+	}
+	return true;
+}
+
+/*
+*
+* Functions relating to fields
+*
+*/
+
+// Returns true if the data fits the type. Types this version doesn't know about are treated as raw.
+bool isValidFieldType(BYTE fieldType, uint32_t fieldSize, const BYTE *rawField)
+{
+	switch (fieldType)
+	{
+	case SDDS_TYPE_U64:
+	case SDDS_TYPE_I64:
+		return fieldSize == 64;
+	case SDDS_TYPE_BOOL:
+		return fieldSize == 1 && rawField[0] <= 1;
+	case SDDS_TYPE_STRING:
+		// Exactly one null char, at the end
+		return fieldSize && (fieldSize % 8) == 0 && memchr(rawField, '\0', fieldSize / 8) == &rawField[(fieldSize / 8) - 1];
+	default:
+		return true;
+	}
+}
+
+// Returns the a pointer to the raw data for a given field name. Also, optionally can give back the field size, type and index
+BYTE* getRawField(SDDS *sdds, char *fieldName, uint32_t *fieldSize, BYTE *fieldType, uint32_t *fieldIndex)
+{
+	if (fieldName && sdds)
+	{
+		uint32_t i = SDDS_NO_INDEX;
+		if (sdds->HasSortedIndex)
+		{
+			uint32_t position = findSortedName(sdds, fieldName);
+			if (position != SDDS_NO_INDEX)
+			{
+				i = sdds->SortedIndex[position];
+			}
+		}
+		else
+		{
+			for (uint32_t j = 0; j < sdds->FieldCount; j++)
+			{
+				COUNT_EVENT(LookupComparisons);
+				if (strcmp(fieldName, sdds->FieldNames[j]) == 0)
+				{
+					i = j;
+					break;
+				}
+			}
+		}
+
+		if (i != SDDS_NO_INDEX)
+		{
+			if (fieldSize)
+			{
+				*fieldSize = sdds->FieldSizes[i];
+			}
+			if (fieldType)
+			{
+				*fieldType = sdds->FieldTypes[i];
+			}
+			if (fieldIndex)
+			{
+				*fieldIndex = i;
+			}
+			return sdds->Fields[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+*
+* Functions relating to snapshots
+*
+*/
+
+// Header of a block of SDDSFieldRefs, which follow it. One block holds the counts a snapshot hands out, so snapshotting
+// doesn't make an allocation per field.
+typedef struct SDDSRefBlock {
+	volatile uint32_t Live; // Counts in the block still holding a field
+} SDDSRefBlock;
+
+// Returns count new field refs in one block, each with a count of one, or NULL if it can't be allocated
+static SDDSFieldRef* newFieldRefs(uint32_t count)
+{
+	SDDSRefBlock *block = (SDDSRefBlock*)memAlloc(sizeof(SDDSRefBlock) + ((size_t)count * sizeof(SDDSFieldRef)));
+	if (!block)
+	{
+		return NULL;
+	}
+
+	SDDSFieldRef *refs = (SDDSFieldRef*)(block + 1);
+	block->Live = count;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		refs[i].Count = 1;
+		refs[i].Slot = i;
+	}
+	return refs;
+}
+
+// Called once a ref no longer holds a field. Frees its block if it was the last one in it.
+static void retireFieldRef(SDDSFieldRef *ref)
+{
+	SDDSRefBlock *block = ((SDDSRefBlock*)(ref - ref->Slot)) - 1;
+	if (atomicFetchAdd32(&block->Live, (uint32_t)-1) == 1)
+	{
+		memFree(block);
+	}
+}
+
+// Drops this SDDS's hold on the name and data of a field, freeing them if no snapshot shares them
+static void releaseField(SDDS *sdds, uint32_t fieldIndex)
+{
+	SDDSFieldRef *ref = sdds->FieldRefs[fieldIndex];
+	if (ref)
+	{
+		if (atomicFetchAdd32(&ref->Count, (uint32_t)-1) != 1)
+		{
+			return;
+		}
+		retireFieldRef(ref);
+	}
+	memFree(sdds->Fields[fieldIndex]);
+	memFree(sdds->FieldNames[fieldIndex]);
+}
+
+// Gives this SDDS its own copy of a shared field's name (and data if copyData, otherwise Fields[fieldIndex] becomes NULL)
+static bool unshareField(SDDS *sdds, uint32_t fieldIndex, bool copyData)
+{
+	SDDSFieldRef *ref = sdds->FieldRefs[fieldIndex];
+	if (!ref)
+	{
+		return true;
+	}
+
+	// If everything else let go, this is the only holder left, so nothing can take a new reference
+	if (atomicLoadAcquire32(&ref->Count) == 1)
+	{
+		retireFieldRef(ref);
+		sdds->FieldRefs[fieldIndex] = NULL;
+		if (!copyData)
+		{
+			memFree(sdds->Fields[fieldIndex]);
+			sdds->Fields[fieldIndex] = NULL;
+		}
+		return true;
+	}
+
+	char *copiedFieldName = NULL;
+	BYTE *copiedRawField = NULL;
+	if (!newStrCopy(&copiedFieldName, sdds->FieldNames[fieldIndex]) || \
+		(copyData && !newRawCopy(&copiedRawField, sdds->Fields[fieldIndex], sdds->FieldSizes[fieldIndex])))
+	{
+		memFree(copiedFieldName);
+		return false;
+	}
+	releaseField(sdds, fieldIndex);
+	sdds->Fields[fieldIndex] = copiedRawField;
+	sdds->FieldNames[fieldIndex] = copiedFieldName;
+	sdds->FieldRefs[fieldIndex] = NULL;
+	return true;
+}
+
+BYTE* getWritableField(SDDS *sdds, char *fieldName, uint32_t *fieldSize, BYTE *fieldType, uint32_t *fieldIndex)
+{
+	uint32_t i = 0;
+	BYTE *rawField = getRawField(sdds, fieldName, fieldSize, fieldType, &i);
+	if (!rawField || !unshareField(sdds, i, true))
+	{
+		return NULL;
+	}
+	if (fieldIndex)
+	{
+		*fieldIndex = i;
+	}
+	return sdds->Fields[i];
+}
+
+bool snapshotSDDS(SDDS *sdds, SDDS *snapshot)
+{
+	initialize(sdds);
+	snapshot->Initialized = false;
+	initialize(snapshot);
+
+	uint32_t count = sdds->FieldCount;
+	if (count)
+	{
+		snapshot->Fields = (BYTE**)memAlloc(count * sizeof(BYTE*));
+		snapshot->FieldNames = (char**)memAlloc(count * sizeof(char*));
+		snapshot->FieldSizes = (uint32_t*)memAlloc(count * sizeof(uint32_t));
+		snapshot->FieldTypes = (BYTE*)memAlloc(count * sizeof(BYTE));
+		snapshot->FieldRefs = (SDDSFieldRef**)memAlloc(count * sizeof(SDDSFieldRef*));
+		if (sdds->HasSortedIndex)
+		{
+			snapshot->SortedIndex = (uint32_t*)memAlloc(count * sizeof(uint32_t));
+		}
+		bool allocated = snapshot->Fields && snapshot->FieldNames && snapshot->FieldSizes && snapshot->FieldTypes && \
+			snapshot->FieldRefs && (snapshot->SortedIndex || !sdds->HasSortedIndex);
+
+		// Fields that aren't shared yet get a count for the one holder they have, all from one block
+		uint32_t unshared = 0;
+		for (uint32_t i = 0; allocated && i < count; i++)
+		{
+			unshared += sdds->FieldRefs[i] ? 0 : 1;
+		}
+		SDDSFieldRef *newRefs = (allocated && unshared) ? newFieldRefs(unshared) : NULL;
+		if (!allocated || (unshared && !newRefs))
+		{
+			closeSDDS(snapshot);
+			return false;
+		}
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (!sdds->FieldRefs[i])
+			{
+				sdds->FieldRefs[i] = newRefs++;
+			}
+			atomicFetchAdd32(&sdds->FieldRefs[i]->Count, 1);
+		}
+		memcpy(snapshot->Fields, sdds->Fields, count * sizeof(BYTE*));
+		memcpy(snapshot->FieldNames, sdds->FieldNames, count * sizeof(char*));
+		memcpy(snapshot->FieldSizes, sdds->FieldSizes, count * sizeof(uint32_t));
+		memcpy(snapshot->FieldTypes, sdds->FieldTypes, count * sizeof(BYTE));
+		memcpy(snapshot->FieldRefs, sdds->FieldRefs, count * sizeof(SDDSFieldRef*));
+		if (sdds->HasSortedIndex)
+		{
+			memcpy(snapshot->SortedIndex, sdds->SortedIndex, count * sizeof(uint32_t));
+		}
+	}
+	snapshot->HasSortedIndex = sdds->HasSortedIndex;
+	snapshot->FieldCount = count;
+	snapshot->TotalBitSize = sdds->TotalBitSize;
+	snapshot->XmlFieldsSize = sdds->XmlFieldsSize;
+	snapshot->BinaryFieldsSize = sdds->BinaryFieldsSize;
+	return true;
+}
+
+// Returns the number of characters toXml() uses for a single field
+uint64_t getXmlFieldSize(uint32_t nameLen, uint32_t fieldSize, BYTE fieldType)
+{
+	return CONST_STR_LEN(SDDS_XML_FIELD_NAME) + nameLen + CONST_STR_LEN(SDDS_XML_FIELD_SIZE) + countDecimalDigits(fieldSize) + \
+		CONST_STR_LEN(SDDS_XML_FIELD_TYPE) + countDecimalDigits(fieldType) + CONST_STR_LEN(SDDS_XML_FIELD_DATA) + \
+		(2 * (uint64_t)roundToByte(fieldSize)) + CONST_STR_LEN(SDDS_XML_FIELD_END);
+}
+
+// Returns the number of bytes toBinary() uses for a single field
+uint64_t getBinaryFieldSize(uint32_t nameLen, uint32_t fieldSize)
+{
+	return SDDS_BINARY_FIELD_OVERHEAD + nameLen + roundToByte(fieldSize);
+}
+
+// Gives the size in bits of a String field holding value (with its null char)
+bool getStringFieldSize(const char *value, uint32_t *fieldSize)
+{
+	if (!value)
+	{
+		return false;
+	}
+
+	// The size is in bits, so very long strings don't fit
+	size_t len = strlen(value);
+	if (len >= (UINT32_MAX / 8))
+	{
+		return false;
+	}
+	*fieldSize = ((uint32_t)len + 1) * 8;
+	return true;
+}
+
+bool removeField(SDDS* sdds, char *fieldName)
+{
+	uint32_t fieldIndex = 0;
+	BYTE* rawField = getRawField(sdds, fieldName, NULL, NULL, &fieldIndex);
+	if (rawField)
+	{
+		// Take this field out of the running totals
+		uint32_t nameLen = cStrLen(sdds->FieldNames[fieldIndex]);
+		uint32_t fieldSize = sdds->FieldSizes[fieldIndex];
+		sdds->TotalBitSize -= fieldSize;
+		sdds->XmlFieldsSize -= getXmlFieldSize(nameLen, fieldSize, sdds->FieldTypes[fieldIndex]);
+		sdds->BinaryFieldsSize -= getBinaryFieldSize(nameLen, fieldSize);
+
+		// Take it out of the sorted index and renumber the fields after it
+		if (sdds->HasSortedIndex)
+		{
+			uint32_t position = findSortedName(sdds, fieldName);
+			memmove(&sdds->SortedIndex[position], &sdds->SortedIndex[position + 1], (sdds->FieldCount - position - 1) * sizeof(uint32_t));
+			for (uint32_t i = 0; i < (sdds->FieldCount - 1); i++)
+			{
+				sdds->SortedIndex[i] -= (sdds->SortedIndex[i] > fieldIndex);
+			}
+		}
+
+		// free the raw field and field name (unless a snapshot still has them)
+		releaseField(sdds, fieldIndex);
+
+		// Move up everything after this
+		for (uint32_t i = fieldIndex; i < (sdds->FieldCount - 1); i++)
+		{
+			sdds->FieldSizes[i] = sdds->FieldSizes[i + 1];
+			sdds->FieldTypes[i] = sdds->FieldTypes[i + 1];
+			sdds->Fields[i] = sdds->Fields[i + 1];
+			sdds->FieldNames[i] = sdds->FieldNames[i + 1];
+			sdds->FieldRefs[i] = sdds->FieldRefs[i + 1];
+		}
+
+		sdds->FieldCount--;
+		return true;
+	}
+	// Field with this name does not exist
+	return false;
+}
+
+// Adds an already allocated name and raw field to the SDDS. The SDDS owns them only if this returns true.
+static bool addOwnedField(SDDS *sdds, char* ownedFieldName, uint32_t fieldSize, BYTE* ownedRawField, BYTE fieldType)
+{
+	// Add size to list
+	if (!addTo32BitArray(&sdds->FieldSizes, sdds->FieldCount + 1, fieldSize))
+	{
+		return false;
+	}
+
+	// Add field type to the list
+	if (!addTo8BitArray(&sdds->FieldTypes, sdds->FieldCount + 1, fieldType))
+	{
+		return false;
+	}
+
+	// Realloc the Fields, FieldNames and FieldRefs
+	if (!(reallocPPPByte(&sdds->Fields, sdds->FieldCount + 1, ownedRawField) && \
+		reallocPPPByte(((BYTE***)&sdds->FieldNames), sdds->FieldCount + 1, (BYTE*)ownedFieldName) && \
+		reallocPPPByte(((BYTE***)&sdds->FieldRefs), sdds->FieldCount + 1, NULL)))
+	{
+		return false;
+	}
+
+	// Make room in the sorted index
+	if (sdds->HasSortedIndex && !addTo32BitArray(&sdds->SortedIndex, sdds->FieldCount + 1, 0))
+	{
+		return false;
+	}
+
+	// Only set and increment the FieldCount (and totals) if everything went well.
+	if (sdds->HasSortedIndex)
+	{
+		uint32_t position = findSortedPosition(sdds, ownedFieldName, SIZE_MAX, false);
+		memmove(&sdds->SortedIndex[position + 1], &sdds->SortedIndex[position], (sdds->FieldCount - position) * sizeof(uint32_t));
+		sdds->SortedIndex[position] = sdds->FieldCount;
+	}
+	uint32_t nameLen = cStrLen(ownedFieldName);
+	sdds->TotalBitSize += fieldSize;
+	sdds->XmlFieldsSize += getXmlFieldSize(nameLen, fieldSize, fieldType);
+	sdds->BinaryFieldsSize += getBinaryFieldSize(nameLen, fieldSize);
+	sdds->FieldCount++;
+	return true;
+}
+
+// Adds field to the SDDS
+bool addField(SDDS *sdds, char* fieldName, uint32_t fieldSize, BYTE* rawField, BYTE fieldType)
+{
+	initialize(sdds);
+
+	if (!isValidFieldType(fieldType, fieldSize, rawField))
+	{
+		return false;
+	}
+
+	// Make sure the new fieldName is unique
+	if (getRawField(sdds, fieldName, NULL, NULL, NULL))
+	{
+		// Name conflict, name already exists.
+		return false;
+	}
+
+	// Copy name over
+	char *copiedFieldName = NULL;
+	if (!newStrCopy(&copiedFieldName, fieldName))
+	{
+		return false;
+	}
+
+	// Copy raw data
+	BYTE *copiedRawField = NULL;
+	if (!newRawCopy(&copiedRawField, rawField, fieldSize))
+	{
+		// free already allocated
+		memFree(copiedFieldName);
+		return false;
+	}
+
+	if (!addOwnedField(sdds, copiedFieldName, fieldSize, copiedRawField, fieldType))
+	{
+		// free already allocated
+		memFree(copiedFieldName);
+		memFree(copiedRawField);
+		return false;
+	}
+	return true; 
+}
+
+bool addLittleEndianField(SDDS *sdds, char* fieldName, uint32_t fieldSize, BYTE* rawField, uint32_t elementSize)
+{
+	if (!elementSize || (fieldSize % 8) || ((fieldSize / 8) % elementSize))
+	{
+		return false;
+	}
+	if (!addField(sdds, fieldName, fieldSize, rawField, SDDS_TYPE_RAW))
+	{
+		return false;
+	}
+
+	// Convert the copy (the last field) in place. Nothing happens on little endian hosts.
+	BYTE *copiedRawField = sdds->Fields[sdds->FieldCount - 1];
+	copyLittleEndian(copiedRawField, copiedRawField, elementSize, (fieldSize / 8) / elementSize);
+	return true;
+}
+
+/*
+*
+* Functions relating to typed fields
+*
+*/
+
+// Typed numbers are stored little endian, so on most hosts this is a plain 64 bit load
+static uint64_t loadLittleEndian64(const BYTE *rawField)
+{
+	uint64_t value;
+	memcpy(&value, rawField, sizeof(value));
+	return LITTLE_ENDIAN_64(value);
+}
+
+// Returns the raw data of the field if it has the given type
+static BYTE* getTypedField(SDDS *sdds, char *fieldName, SDDSFieldType fieldType)
+{
+	BYTE type = SDDS_TYPE_RAW;
+	BYTE *rawField = getRawField(sdds, fieldName, NULL, &type, NULL);
+	return (rawField && type == fieldType) ? rawField : NULL;
+}
+
+bool addU64(SDDS *sdds, char *fieldName, uint64_t value)
+{
+	uint64_t stored = LITTLE_ENDIAN_64(value);
+	return addField(sdds, fieldName, 64, (BYTE*)&stored, SDDS_TYPE_U64);
+}
+
+bool addI64(SDDS *sdds, char *fieldName, int64_t value)
+{
+	uint64_t stored = LITTLE_ENDIAN_64((uint64_t)value);
+	return addField(sdds, fieldName, 64, (BYTE*)&stored, SDDS_TYPE_I64);
+}
+
+bool addBool(SDDS *sdds, char *fieldName, bool value)
+{
+	BYTE stored = value ? 1 : 0;
+	return addField(sdds, fieldName, 1, &stored, SDDS_TYPE_BOOL);
+}
+
+bool addString(SDDS *sdds, char *fieldName, const char *value)
+{
+	uint32_t fieldSize = 0;
+	if (!getStringFieldSize(value, &fieldSize))
+	{
+		return false;
+	}
+	return addField(sdds, fieldName, fieldSize, (BYTE*)value, SDDS_TYPE_STRING);
+}
+
+bool getU64(SDDS *sdds, char *fieldName, uint64_t *value)
+{
+	BYTE *rawField = getTypedField(sdds, fieldName, SDDS_TYPE_U64);
+	if (!rawField)
+	{
+		return false;
+	}
+	*value = loadLittleEndian64(rawField);
+	return true;
+}
+
+bool getI64(SDDS *sdds, char *fieldName, int64_t *value)
+{
+	BYTE *rawField = getTypedField(sdds, fieldName, SDDS_TYPE_I64);
+	if (!rawField)
+	{
+		return false;
+	}
+	*value = (int64_t)loadLittleEndian64(rawField);
+	return true;
+}
+
+bool getBool(SDDS *sdds, char *fieldName, bool *value)
+{
+	BYTE *rawField = getTypedField(sdds, fieldName, SDDS_TYPE_BOOL);
+	if (!rawField)
+	{
+		return false;
+	}
+	*value = rawField[0] != 0;
+	return true;
+}
+
+bool getString(SDDS *sdds, char *fieldName, const char **value)
+{
+	BYTE *rawField = getTypedField(sdds, fieldName, SDDS_TYPE_STRING);
+	if (!rawField)
+	{
+		return false;
+	}
+	*value = (const char*)rawField;
+	return true;
+}
+
+uint32_t getFieldCount(SDDS *sdds)
+{
+	return sdds->FieldCount;
+}
+
+// Returns the size in bits
+uint64_t getTotalBitSize(SDDS *sdds)
+{
+	return sdds->TotalBitSize;
+}
+
+uint64_t getTotalByteSize(SDDS *sdds)
+{
+	return (sdds->TotalBitSize + 7) / 8;
+}
+
+// Returns the length of the string toXml() will give back (not including the null char)
+uint64_t getXmlSize(SDDS *sdds)
+{
+	return CONST_STR_LEN(SDDS_XML_START) + sdds->XmlFieldsSize + CONST_STR_LEN(SDDS_XML_END);
+}
+
+// Returns the number of bytes toBinary() will give back
+uint64_t getBinarySize(SDDS *sdds)
+{
+	return SDDS_BINARY_HEADER_SIZE + sdds->BinaryFieldsSize + sizeof(uint32_t);
+}
+
+// Writes toXml() output (with the null char) into buffer. Returns the length without the null char, or 0 if bufferSize is too small.
+uint64_t writeXml(SDDS *sdds, char *buffer, uint64_t bufferSize)
+{
+	static const char hexChars[] = "0123456789ABCDEF";
+
+	uint64_t xmlSize = getXmlSize(sdds);
+	if (bufferSize <= xmlSize)
+	{
+		return 0;
+	}
+
+	char* cur = buffer;
+	cur = memAppend(cur, SDDS_XML_START, CONST_STR_LEN(SDDS_XML_START));
+	for (uint32_t i = 0; i < sdds->FieldCount; i++)
+	{
+		cur = memAppend(cur, SDDS_XML_FIELD_NAME, CONST_STR_LEN(SDDS_XML_FIELD_NAME));
+		cur = memAppend(cur, sdds->FieldNames[i], cStrLen(sdds->FieldNames[i]));
+		cur = memAppend(cur, SDDS_XML_FIELD_SIZE, CONST_STR_LEN(SDDS_XML_FIELD_SIZE));
+		cur += writeDecimal(cur, sdds->FieldSizes[i]);
+		cur = memAppend(cur, SDDS_XML_FIELD_TYPE, CONST_STR_LEN(SDDS_XML_FIELD_TYPE));
+		cur += writeDecimal(cur, sdds->FieldTypes[i]);
+		cur = memAppend(cur, SDDS_XML_FIELD_DATA, CONST_STR_LEN(SDDS_XML_FIELD_DATA));
+
+		// Add raw buffer data
+		uint32_t byteSize = roundToByte(sdds->FieldSizes[i]);
+		for (uint32_t j = 0; j < byteSize; j++)
+		{
+			*cur++ = hexChars[sdds->Fields[i][j] >> 4];
+			*cur++ = hexChars[sdds->Fields[i][j] & 0xF];
+		}
+		cur = memAppend(cur, SDDS_XML_FIELD_END, CONST_STR_LEN(SDDS_XML_FIELD_END));
+	}
+	cur = memAppend(cur, SDDS_XML_END, CONST_STR_LEN(SDDS_XML_END));
+	*cur = '\0';
+
+	assert((uint64_t)(cur - buffer) == xmlSize);
+	return xmlSize;
+}
+
+char* toXml(SDDS *sdds)          // Method to describe the SDDS
+{
+	// Everything is sized ahead of time, so this is the only allocation
+	uint64_t xmlSize = getXmlSize(sdds);
+	char* retStr = (char*)memAlloc((size_t)xmlSize + 1);
+	if (retStr)
+	{
+		writeXml(sdds, retStr, xmlSize + 1);
+	}
+	return retStr;
+}
+
+// Appends a little endian 32 bit value
+static BYTE* appendU32(BYTE *cur, uint32_t value)
+{
+	uint32_t stored = LITTLE_ENDIAN_32(value);
+	return memAppend(cur, &stored, sizeof(stored));
+}
+
+// Writes toBinary() output into buffer. Returns the number of bytes written, or 0 if bufferSize is too small.
+// Layout: SDDS_BINARY_MAGIC, version byte, then per field: name length (4), name, size in bits (4), type (1), data.
+// The lengths and sizes are little endian no matter the host.
+// The stream is ended with SDDS_BINARY_END_MARKER in place of a name length.
+uint64_t writeBinary(SDDS *sdds, BYTE *buffer, uint64_t bufferSize)
+{
+	uint64_t binarySize = getBinarySize(sdds);
+	if (bufferSize < binarySize)
+	{
+		return 0;
+	}
+
+	BYTE version = SDDS_BINARY_VERSION;
+	BYTE* cur = buffer;
+	cur = memAppend(cur, SDDS_BINARY_MAGIC, CONST_STR_LEN(SDDS_BINARY_MAGIC));
+	cur = memAppend(cur, &version, sizeof(version));
+	for (uint32_t i = 0; i < sdds->FieldCount; i++)
+	{
+		uint32_t nameLen = cStrLen(sdds->FieldNames[i]);
+		cur = appendU32(cur, nameLen);
+		cur = memAppend(cur, sdds->FieldNames[i], nameLen);
+		cur = appendU32(cur, sdds->FieldSizes[i]);
+		cur = memAppend(cur, &sdds->FieldTypes[i], sizeof(BYTE));
+		cur = memAppend(cur, sdds->Fields[i], roundToByte(sdds->FieldSizes[i]));
+	}
+	cur = appendU32(cur, SDDS_BINARY_END_MARKER);
+
+	assert((uint64_t)(cur - buffer) == binarySize);
+	return binarySize;
+}
+
+// Serializes the SDDS to bytes. The size of the returned buffer is given by getBinarySize().
+BYTE* toBinary(SDDS *sdds)
+{
+	uint64_t binarySize = getBinarySize(sdds);
+	BYTE* retBuf = (BYTE*)memAlloc((size_t)binarySize);
+	if (retBuf)
+	{
+		writeBinary(sdds, retBuf, binarySize);
+	}
+	return retBuf;
+}
+
+/*
+*
+* Parsing
+*
+*/
+
+// Consumes literal at *cur. Tells apart running out of input from a mismatch.
+static SDDSParseStatus expectLiteral(const char **cur, const char *end, const char *literal, size_t len)
+{
+	size_t remaining = (size_t)(end - *cur);
+	if (remaining < len)
+	{
+		return memcmp(*cur, literal, remaining) == 0 ? SDDS_PARSE_TRUNCATED : SDDS_PARSE_MALFORMED;
+	}
+	if (memcmp(*cur, literal, len) != 0)
+	{
+		return SDDS_PARSE_MALFORMED;
+	}
+	*cur += len;
+	return SDDS_PARSE_OK;
+}
+
+// expectLiteral() for byte input. Goes through a char cursor, since writing *cur through a char** breaks strict aliasing.
+static SDDSParseStatus expectMagic(const BYTE **cur, const BYTE *end, const char *magic, size_t len)
+{
+	const char *charCur = (const char*)*cur;
+	SDDSParseStatus status = expectLiteral(&charCur, (const char*)end, magic, len);
+	*cur = (const BYTE*)charCur;
+	return status;
+}
+
+// Reads a decimal number (at most maxValue) at *cur
+static SDDSParseStatus readDecimal(const char **cur, const char *end, uint32_t maxValue, uint32_t *value)
+{
+	const char *start = *cur;
+	uint32_t result = 0;
+	while (*cur < end && **cur >= '0' && **cur <= '9')
+	{
+		uint32_t digit = (uint32_t)(**cur - '0');
+		if (result > (maxValue - digit) / 10)
+		{
+			return SDDS_PARSE_BAD_VALUE;
+		}
+		result = (result * 10) + digit;
+		(*cur)++;
+	}
+
+	if (*cur == start)
+	{
+		return *cur == end ? SDDS_PARSE_TRUNCATED : SDDS_PARSE_MALFORMED;
+	}
+	*value = result;
+	return SDDS_PARSE_OK;
+}
+
+// Returns the value of a hex digit, or -1
+static int getHexNibble(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if (c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	return -1;
+}
+
+// Copies a name of nameLen bytes out of the input. Names can't hold a null char since they are C strings.
+static SDDSParseStatus copyName(const char *name, size_t nameLen, char **pCopiedName)
+{
+	if (memchr(name, '\0', nameLen))
+	{
+		return SDDS_PARSE_MALFORMED;
+	}
+
+	char *copiedName = (char*)memAlloc(nameLen + 1);
+	if (!copiedName)
+	{
+		return SDDS_PARSE_NO_MEMORY;
+	}
+	memcpy(copiedName, name, nameLen);
+	copiedName[nameLen] = '\0';
+	*pCopiedName = copiedName;
+	return SDDS_PARSE_OK;
+}
+
+// Adds a parsed field (taking ownership of the name and raw field, even on failure)
+static SDDSParseStatus addParsedField(SDDS *sdds, char *name, uint32_t fieldSize, BYTE *rawField, BYTE fieldType)
+{
+	SDDSParseStatus status = SDDS_PARSE_OK;
+	if (!isValidFieldType(fieldType, fieldSize, rawField))
+	{
+		status = SDDS_PARSE_BAD_VALUE;
+	}
+	else if (getRawField(sdds, name, NULL, NULL, NULL))
+	{
+		status = SDDS_PARSE_DUPLICATE;
+	}
+	else if (!addOwnedField(sdds, name, fieldSize, rawField, fieldType))
+	{
+		status = SDDS_PARSE_NO_MEMORY;
+	}
+
+	if (status != SDDS_PARSE_OK)
+	{
+		memFree(name);
+		memFree(rawField);
+	}
+	return status;
+}
+
+static SDDSParseStatus parseXmlField(SDDS *sdds, const char **cur, const char *end)
+{
+	SDDSParseStatus status;
+	uint32_t fieldSize = 0;
+	uint32_t fieldType = 0;
+
+	if ((status = expectLiteral(cur, end, SDDS_XML_FIELD_NAME, CONST_STR_LEN(SDDS_XML_FIELD_NAME))) != SDDS_PARSE_OK)
+	{
+		return status;
+	}
+
+	const char *name = *cur;
+	const char *nameEnd = (const char*)memchr(name, '"', (size_t)(end - name));
+	if (!nameEnd)
+	{
+		return SDDS_PARSE_TRUNCATED;
+	}
+	*cur = nameEnd;
+
+	if ((status = expectLiteral(cur, end, SDDS_XML_FIELD_SIZE, CONST_STR_LEN(SDDS_XML_FIELD_SIZE))) != SDDS_PARSE_OK ||
+		(status = readDecimal(cur, end, UINT32_MAX, &fieldSize)) != SDDS_PARSE_OK ||
+		(status = expectLiteral(cur, end, SDDS_XML_FIELD_TYPE, CONST_STR_LEN(SDDS_XML_FIELD_TYPE))) != SDDS_PARSE_OK ||
+		(status = readDecimal(cur, end, UINT8_MAX, &fieldType)) != SDDS_PARSE_OK ||
+		(status = expectLiteral(cur, end, SDDS_XML_FIELD_DATA, CONST_STR_LEN(SDDS_XML_FIELD_DATA))) != SDDS_PARSE_OK)
+	{
+		return status;
+	}
+
+	// Make sure all of the hex is there before allocating for it
+	uint32_t byteSize = roundToByte(fieldSize);
+	if ((uint64_t)(end - *cur) < 2 * (uint64_t)byteSize)
+	{
+		return SDDS_PARSE_TRUNCATED;
+	}
+
+	char *copiedName = NULL;
+	if ((status = copyName(name, (size_t)(nameEnd - name), &copiedName)) != SDDS_PARSE_OK)
+	{
+		return status;
+	}
+
+	BYTE *rawField = (BYTE*)memAlloc(byteSize ? byteSize : 1);
+	if (!rawField)
+	{
+		memFree(copiedName);
+		return SDDS_PARSE_NO_MEMORY;
+	}
+
+	for (uint32_t i = 0; i < byteSize; i++)
+	{
+		int high = getHexNibble((*cur)[i * 2]);
+		int low = getHexNibble((*cur)[(i * 2) + 1]);
+		if ((high | low) < 0)
+		{
+			memFree(copiedName);
+			memFree(rawField);
+			return SDDS_PARSE_BAD_VALUE;
+		}
+		rawField[i] = (BYTE)((high << 4) | low);
+	}
+	*cur += 2 * (size_t)byteSize;
+
+	if ((status = expectLiteral(cur, end, SDDS_XML_FIELD_END, CONST_STR_LEN(SDDS_XML_FIELD_END))) != SDDS_PARSE_OK)
+	{
+		memFree(copiedName);
+		memFree(rawField);
+		return status;
+	}
+
+	return addParsedField(sdds, copiedName, fieldSize, rawField, (BYTE)fieldType);
+}
+
+SDDSParseStatus fromXml(SDDS *sdds, const char *xml, size_t xmlLen)
+{
+	initialize(sdds);
+
+	const char *cur = xml;
+	const char *end = xml + xmlLen;
+	SDDSParseStatus status = expectLiteral(&cur, end, SDDS_XML_START, CONST_STR_LEN(SDDS_XML_START));
+	while (status == SDDS_PARSE_OK)
+	{
+		// Either the end of the fields or another field
+		if (cur + 1 < end && cur[1] == '/')
+		{
+			status = expectLiteral(&cur, end, SDDS_XML_END, CONST_STR_LEN(SDDS_XML_END));
+			if (status == SDDS_PARSE_OK && cur != end)
+			{
+				status = SDDS_PARSE_MALFORMED; // trailing data
+			}
+			break;
+		}
+		status = parseXmlField(sdds, &cur, end);
+	}
+
+	if (status != SDDS_PARSE_OK)
+	{
+		closeSDDS(sdds);
+	}
+	return status;
+}
+
+// Reads a fixed size value at *cur
+static SDDSParseStatus readBinary(const BYTE **cur, const BYTE *end, void *value, size_t size)
+{
+	if ((size_t)(end - *cur) < size)
+	{
+		return SDDS_PARSE_TRUNCATED;
+	}
+	memcpy(value, *cur, size);
+	*cur += size;
+	return SDDS_PARSE_OK;
+}
+
+// Reads a little endian 32 bit value at *cur
+static SDDSParseStatus readU32(const BYTE **cur, const BYTE *end, uint32_t *value)
+{
+	SDDSParseStatus status = readBinary(cur, end, value, sizeof(*value));
+	*value = LITTLE_ENDIAN_32(*value);
+	return status;
+}
+
+static SDDSParseStatus parseBinaryField(SDDS *sdds, const BYTE **cur, const BYTE *end, uint32_t nameLen)
+{
+	SDDSParseStatus status;
+	uint32_t fieldSize = 0;
+	BYTE fieldType = 0;
+
+	if ((size_t)(end - *cur) < nameLen)
+	{
+		return SDDS_PARSE_TRUNCATED;
+	}
+	const char *name = (const char*)*cur;
+	*cur += nameLen;
+
+	if ((status = readU32(cur, end, &fieldSize)) != SDDS_PARSE_OK ||
+		(status = readBinary(cur, end, &fieldType, sizeof(fieldType))) != SDDS_PARSE_OK)
+	{
+		return status;
+	}
+
+	uint32_t byteSize = roundToByte(fieldSize);
+	if ((size_t)(end - *cur) < byteSize)
+	{
+		return SDDS_PARSE_TRUNCATED;
+	}
+
+	char *copiedName = NULL;
+	if ((status = copyName(name, nameLen, &copiedName)) != SDDS_PARSE_OK)
+	{
+		return status;
+	}
+
+	BYTE *rawField = NULL;
+	if (!newRawCopy(&rawField, (BYTE*)*cur, fieldSize))
+	{
+		memFree(copiedName);
+		return SDDS_PARSE_NO_MEMORY;
+	}
+	*cur += byteSize;
+
+	return addParsedField(sdds, copiedName, fieldSize, rawField, fieldType);
+}
+
+SDDSParseStatus fromBinary(SDDS *sdds, const BYTE *binary, size_t binarySize)
+{
+	initialize(sdds);
+
+	const BYTE *cur = binary;
+	const BYTE *end = binary + binarySize;
+	BYTE version = 0;
+	SDDSParseStatus status = expectMagic(&cur, end, SDDS_BINARY_MAGIC, CONST_STR_LEN(SDDS_BINARY_MAGIC));
+	if (status == SDDS_PARSE_OK && (status = readBinary(&cur, end, &version, sizeof(version))) == SDDS_PARSE_OK && version != SDDS_BINARY_VERSION)
+	{
+		status = SDDS_PARSE_BAD_VALUE;
+	}
+
+	while (status == SDDS_PARSE_OK)
+	{
+		uint32_t nameLen = 0;
+		if ((status = readU32(&cur, end, &nameLen)) != SDDS_PARSE_OK)
+		{
+			break;
+		}
+
+		if (nameLen == SDDS_BINARY_END_MARKER)
+		{
+			if (cur != end)
+			{
+				status = SDDS_PARSE_MALFORMED; // trailing data
+			}
+			break;
+		}
+		status = parseBinaryField(sdds, &cur, end, nameLen);
+	}
+
+	if (status != SDDS_PARSE_OK)
+	{
+		closeSDDS(sdds);
+	}
+	return status;
+}
+
+/*
+*
+* Functions relating to deltas
+*
+*/
+
+// Writes a delta, or with a NULL Cur just adds up how big it would be
+typedef struct DeltaWriter {
+	BYTE *Cur;
+	uint64_t Size;
+	SDDS *After;
+} DeltaWriter;
+
+static void deltaAppend(DeltaWriter *writer, const void *src, size_t len)
+{
+	if (writer->Cur)
+	{
+		writer->Cur = memAppend(writer->Cur, src, len);
+	}
+	writer->Size += len;
+}
+
+static void deltaAppendU32(DeltaWriter *writer, uint32_t value)
+{
+	uint32_t stored = LITTLE_ENDIAN_32(value);
+	deltaAppend(writer, &stored, sizeof(stored));
+}
+
+static void deltaAppendName(DeltaWriter *writer, BYTE op, const char *fieldName)
+{
+	uint32_t nameLen = cStrLen((char*)fieldName);
+	deltaAppend(writer, &op, sizeof(op));
+	deltaAppendU32(writer, nameLen);
+	deltaAppend(writer, fieldName, nameLen);
+}
+
+// Adds a set entry for the field at the given index of after
+static void deltaAppendSet(DeltaWriter *writer, uint32_t afterIndex)
+{
+	SDDS *after = writer->After;
+	deltaAppendName(writer, SDDS_DELTA_SET, after->FieldNames[afterIndex]);
+	deltaAppendU32(writer, after->FieldSizes[afterIndex]);
+	deltaAppend(writer, &after->FieldTypes[afterIndex], sizeof(BYTE));
+	deltaAppend(writer, after->Fields[afterIndex], roundToByte(after->FieldSizes[afterIndex]));
+}
+
+// Removed and changed fields come from the diff. Added ones are written afterwards in insertion order.
+static void deltaDiffCallback(void *context, SDDSDiffKind kind, const char *fieldName, uint32_t beforeIndex, uint32_t afterIndex)
+{
+	DeltaWriter *writer = (DeltaWriter*)context;
+	if (kind == SDDS_DIFF_REMOVED)
+	{
+		deltaAppendName(writer, SDDS_DELTA_REMOVE, fieldName);
+	}
+	else if (kind == SDDS_DIFF_CHANGED)
+	{
+		deltaAppendSet(writer, afterIndex);
+	}
+}
+
+// Writes (or sizes) the whole delta
+static bool writeDelta(SDDS *before, SDDS *after, DeltaWriter *writer)
+{
+	BYTE version = SDDS_BINARY_VERSION;
+	BYTE end = SDDS_DELTA_END;
+	deltaAppend(writer, SDDS_DELTA_MAGIC, CONST_STR_LEN(SDDS_DELTA_MAGIC));
+	deltaAppend(writer, &version, sizeof(version));
+	if (!diffSDDS(before, after, deltaDiffCallback, writer))
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < after->FieldCount; i++)
+	{
+		if (!getRawField(before, after->FieldNames[i], NULL, NULL, NULL))
+		{
+			deltaAppendSet(writer, i);
+		}
+	}
+	deltaAppend(writer, &end, sizeof(end));
+	return true;
+}
+
+BYTE* toDelta(SDDS *before, SDDS *after, uint64_t *deltaSize)
+{
+	// Size it first so there is one allocation
+	DeltaWriter writer = { NULL, 0, after };
+	if (!writeDelta(before, after, &writer))
+	{
+		return NULL;
+	}
+
+	BYTE *retBuf = (BYTE*)memAlloc((size_t)writer.Size);
+	if (!retBuf)
+	{
+		return NULL;
+	}
+	*deltaSize = writer.Size;
+	writer.Cur = retBuf;
+	writer.Size = 0;
+	writeDelta(before, after, &writer);
+
+	assert(writer.Size == *deltaSize);
+	return retBuf;
+}
+
+// Swaps in a new raw field for the field at fieldIndex, keeping the running totals right. The SDDS owns ownedRawField only if this returns true.
+static bool replaceOwnedField(SDDS *sdds, uint32_t fieldIndex, uint32_t fieldSize, BYTE *ownedRawField, BYTE fieldType)
+{
+	// A snapshot sharing the field keeps the old data
+	if (!unshareField(sdds, fieldIndex, false))
+	{
+		return false;
+	}
+
+	uint32_t nameLen = cStrLen(sdds->FieldNames[fieldIndex]);
+	uint32_t oldSize = sdds->FieldSizes[fieldIndex];
+	sdds->TotalBitSize += (uint64_t)fieldSize - oldSize;
+	sdds->XmlFieldsSize += getXmlFieldSize(nameLen, fieldSize, fieldType) - getXmlFieldSize(nameLen, oldSize, sdds->FieldTypes[fieldIndex]);
+	sdds->BinaryFieldsSize += getBinaryFieldSize(nameLen, fieldSize) - getBinaryFieldSize(nameLen, oldSize);
+
+	memFree(sdds->Fields[fieldIndex]);
+	sdds->Fields[fieldIndex] = ownedRawField;
+	sdds->FieldSizes[fieldIndex] = fieldSize;
+	sdds->FieldTypes[fieldIndex] = fieldType;
+	return true;
+}
+
+// Reads one delta entry. The name and data point into the delta.
+static SDDSParseStatus readDeltaEntry(const BYTE **cur, const BYTE *end, BYTE *op, const char **name, uint32_t *nameLen,
+	uint32_t *fieldSize, BYTE *fieldType, const BYTE **data)
+{
+	SDDSParseStatus status;
+	if ((status = readBinary(cur, end, op, sizeof(*op))) != SDDS_PARSE_OK || *op == SDDS_DELTA_END)
+	{
+		return status;
+	}
+	if (*op != SDDS_DELTA_SET && *op != SDDS_DELTA_REMOVE)
+	{
+		return SDDS_PARSE_MALFORMED;
+	}
+
+	if ((status = readU32(cur, end, nameLen)) != SDDS_PARSE_OK)
+	{
+		return status;
+	}
+	if ((size_t)(end - *cur) < *nameLen)
+	{
+		return SDDS_PARSE_TRUNCATED;
+	}
+	*name = (const char*)*cur;
+	*cur += *nameLen;
+	if (memchr(*name, '\0', *nameLen))
+	{
+		return SDDS_PARSE_MALFORMED;
+	}
+
+	if (*op == SDDS_DELTA_SET)
+	{
+		if ((status = readU32(cur, end, fieldSize)) != SDDS_PARSE_OK ||
+			(status = readBinary(cur, end, fieldType, sizeof(*fieldType))) != SDDS_PARSE_OK)
+		{
+			return status;
+		}
+		uint32_t byteSize = roundToByte(*fieldSize);
+		if ((size_t)(end - *cur) < byteSize)
+		{
+			return SDDS_PARSE_TRUNCATED;
+		}
+		*data = *cur;
+		*cur += byteSize;
+		if (!isValidFieldType(*fieldType, *fieldSize, *data))
+		{
+			return SDDS_PARSE_BAD_VALUE;
+		}
+	}
+	return SDDS_PARSE_OK;
+}
+
+// Applies one entry that readDeltaEntry() already checked
+static SDDSParseStatus applyDeltaEntry(SDDS *sdds, BYTE op, const char *name, uint32_t nameLen, uint32_t fieldSize, BYTE fieldType, const BYTE *data)
+{
+	char *copiedName = NULL;
+	SDDSParseStatus status = copyName(name, nameLen, &copiedName);
+	if (status != SDDS_PARSE_OK)
+	{
+		return status;
+	}
+
+	uint32_t fieldIndex = 0;
+	bool exists = getRawField(sdds, copiedName, NULL, NULL, &fieldIndex) != NULL;
+	if (op == SDDS_DELTA_REMOVE)
+	{
+		if (exists)
+		{
+			removeField(sdds, copiedName);
+		}
+		memFree(copiedName);
+		return SDDS_PARSE_OK;
+	}
+
+	BYTE *rawField = NULL;
+	if (!newRawCopy(&rawField, (BYTE*)data, fieldSize))
+	{
+		memFree(copiedName);
+		return SDDS_PARSE_NO_MEMORY;
+	}
+
+	if (exists)
+	{
+		memFree(copiedName);
+		if (!replaceOwnedField(sdds, fieldIndex, fieldSize, rawField, fieldType))
+		{
+			memFree(rawField);
+			return SDDS_PARSE_NO_MEMORY;
+		}
+		return SDDS_PARSE_OK;
+	}
+	return addParsedField(sdds, copiedName, fieldSize, rawField, fieldType);
+}
+
+SDDSParseStatus applyDelta(SDDS *sdds, const BYTE *delta, size_t deltaSize)
+{
+	initialize(sdds);
+
+	const BYTE *end = delta + deltaSize;
+	BYTE version = 0;
+	const BYTE *cur = delta;
+	SDDSParseStatus status = expectMagic(&cur, end, SDDS_DELTA_MAGIC, CONST_STR_LEN(SDDS_DELTA_MAGIC));
+	if (status == SDDS_PARSE_OK && (status = readBinary(&cur, end, &version, sizeof(version))) == SDDS_PARSE_OK && version != SDDS_BINARY_VERSION)
+	{
+		status = SDDS_PARSE_BAD_VALUE;
+	}
+	const BYTE *entries = cur;
+
+	// Check everything first, then apply
+	for (int pass = 0; pass < 2 && status == SDDS_PARSE_OK; pass++)
+	{
+		cur = entries;
+		while (status == SDDS_PARSE_OK)
+		{
+			BYTE op = 0;
+			const char *name = NULL;
+			uint32_t nameLen = 0;
+			uint32_t fieldSize = 0;
+			BYTE fieldType = 0;
+			const BYTE *data = NULL;
+			if ((status = readDeltaEntry(&cur, end, &op, &name, &nameLen, &fieldSize, &fieldType, &data)) != SDDS_PARSE_OK)
+			{
+				break;
+			}
+
+			if (op == SDDS_DELTA_END)
+			{
+				if (cur != end)
+				{
+					status = SDDS_PARSE_MALFORMED; // trailing data
+				}
+				break;
+			}
+			if (pass == 1)
+			{
+				status = applyDeltaEntry(sdds, op, name, nameLen, fieldSize, fieldType, data);
+			}
+		}
+	}
+	return status;
+}
+
+// Appends the value of the field at fieldIndex, formatted by its type
+static bool appendFieldValue(char **pStr, SDDS *sdds, uint32_t fieldIndex)
+{
+	static const char hexChars[] = "0123456789ABCDEF";
+
+	char number[32];
+	BYTE *rawField = sdds->Fields[fieldIndex];
+	switch (sdds->FieldTypes[fieldIndex])
+	{
+	case SDDS_TYPE_U64:
+		snprintf(number, sizeof(number), "%" PRIu64, loadLittleEndian64(rawField));
+		return stringAppend(pStr, number);
+	case SDDS_TYPE_I64:
+		snprintf(number, sizeof(number), "%" PRId64, (int64_t)loadLittleEndian64(rawField));
+		return stringAppend(pStr, number);
+	case SDDS_TYPE_BOOL:
+		return stringAppend(pStr, rawField[0] ? "True" : "False");
+	case SDDS_TYPE_STRING:
+		return stringAppend(pStr, "\"") && stringAppend(pStr, (char*)rawField) && stringAppend(pStr, "\"");
+	default:
+		break;
+	}
+
+	// Raw (or unknown) fields are shown as hex
+	uint32_t byteSize = roundToByte(sdds->FieldSizes[fieldIndex]);
+	char *hex = (char*)memAlloc((2 * (size_t)byteSize) + sizeof("0x"));
+	if (!hex)
+	{
+		return false;
+	}
+	char *cur = memAppend(hex, "0x", 2);
+	for (uint32_t i = 0; i < byteSize; i++)
+	{
+		*cur++ = hexChars[rawField[i] >> 4];
+		*cur++ = hexChars[rawField[i] & 0xF];
+	}
+	*cur = '\0';
+	bool appended = stringAppend(pStr, hex);
+	memFree(hex);
+	return appended;
+}
+
+char* toString(SDDS *sdds)         // Method to parse the SDDS
+{
+	char* retStr = NULL;
+	for (uint32_t i = 0; i < sdds->FieldCount; i++)
+	{
+		if (!(stringAppend(&retStr, sdds->FieldNames[i]) && stringAppend(&retStr, ": ") && \
+			appendFieldValue(&retStr, sdds, i) && stringAppend(&retStr, "\n")))
+		{
+			memFree(retStr);
+			return NULL;
+		}
+	}
+	return retStr;
+}
+
+// Used to free all allocations.
+void closeSDDS(SDDS *sdds)
+{
+	sdds->Initialized = false;
+	for (uint32_t i = 0; i < sdds->FieldCount; i++)
+	{
+		releaseField(sdds, i);
+	}
+	memFree(sdds->FieldSizes);
+	memFree(sdds->FieldTypes);
+	memFree(sdds->Fields);
+	memFree(sdds->FieldNames);
+	memFree(sdds->SortedIndex);
+	memFree(sdds->FieldRefs);
+	sdds->Fields = NULL;
+	sdds->FieldNames = NULL;
+	sdds->FieldSizes = NULL;
+	sdds->FieldTypes = NULL;
+	sdds->SortedIndex = NULL;
+	sdds->FieldRefs = NULL;
+	sdds->HasSortedIndex = false;
+	sdds->FieldCount = 0;
+	sdds->TotalBitSize = 0;
+	sdds->XmlFieldsSize = 0;
+	sdds->BinaryFieldsSize = 0;
+}
@@ -0,0 +1,304 @@
+// cSDDS - Self Describing Data Steam - A way to store raw byte data in a way that is self-describing with names
+// (C) - Charles Machalow via the MIT License 
+
+#pragma once
+
+// Local includes
+#include "Memory.h"
+
+// What a field holds. Typed fields are checked when added or parsed, so the typed getters can load them directly.
+typedef enum SDDSFieldType {
+	SDDS_TYPE_RAW = 0, // Any bytes (what addField() callers get with a type of 0)
+	SDDS_TYPE_U64,     // 64 bits, little endian
+	SDDS_TYPE_I64,     // 64 bits, little endian two's complement
+	SDDS_TYPE_BOOL,    // 1 bit, 0 or 1
+	SDDS_TYPE_STRING,  // Characters with a single null char at the end (which is part of the field)
+	SDDS_TYPE_COUNT
+} SDDSFieldType;
+
+// Reference count of a field's name and data shared with snapshots. Counts are allocated a block at a time, and Slot
+// finds the block again so it is freed with its last count.
+typedef struct SDDSFieldRef {
+	volatile uint32_t Count; // SDDSes holding the field
+	uint32_t Slot;           // Position in its block
+} SDDSFieldRef;
+
+// Self Describing Data Stream
+typedef struct SDDS {
+	BYTE** Fields;
+	char** FieldNames;
+	uint32_t* FieldSizes;
+	BYTE* FieldTypes;          // SDDSFieldType of each field
+	uint32_t FieldCount;
+	uint64_t TotalBitSize;     // Running sum of FieldSizes
+	uint64_t XmlFieldsSize;    // Running length of the <Field> lines that toXml() emits
+	uint64_t BinaryFieldsSize; // Running length of the field entries that toBinary() emits
+	uint32_t* SortedIndex;     // Field indices in name order. Only kept up to date once enableSortedIndex() is called.
+	SDDSFieldRef** FieldRefs;  // Shared reference count of each field's name and data, NULL while no snapshot shares them
+	bool HasSortedIndex;
+	bool Initialized;
+} SDDS, *PSDDS;
+
+// Fixed pieces of the xml format
+#define SDDS_XML_START             "<Fields>\n"
+#define SDDS_XML_FIELD_NAME        "<Field FieldName=\""
+#define SDDS_XML_FIELD_SIZE        "\" FieldSize="
+#define SDDS_XML_FIELD_TYPE        " FieldModifier=" // Holds the SDDSFieldType (named for what the byte used to be, so older streams still parse)
+#define SDDS_XML_FIELD_DATA        ">"
+#define SDDS_XML_FIELD_END         "</Field>\n"
+#define SDDS_XML_END               "</Fields>\n"
+#define CONST_STR_LEN(s)           (sizeof(s) - 1)
+
+// Fixed pieces of the binary format. Integers are little endian on every host, so streams can move between them.
+#define SDDS_BINARY_MAGIC          "SDDS"
+#define SDDS_BINARY_VERSION        1
+#define SDDS_BINARY_END_MARKER     0xFFFFFFFF // Takes the place of a name length to end the stream
+#define SDDS_BINARY_HEADER_SIZE    (CONST_STR_LEN(SDDS_BINARY_MAGIC) + sizeof(uint8_t))
+#define SDDS_BINARY_FIELD_OVERHEAD (sizeof(uint32_t) + sizeof(uint32_t) + sizeof(BYTE)) // name length, size, type
+
+// Fixed pieces of the delta format (see toDelta()). Set entries use the same layout as a toBinary() field.
+#define SDDS_DELTA_MAGIC           "SDDD"
+#define SDDS_DELTA_SET             0    // Add the field, or replace it if it is there
+#define SDDS_DELTA_REMOVE          1    // Remove the field
+#define SDDS_DELTA_END             0xFF // Ends the delta
+
+// Result of parsing a serialized SDDS. Parsing never asserts; every problem comes back as one of these.
+typedef enum SDDSParseStatus {
+	SDDS_PARSE_OK = 0,
+	SDDS_PARSE_TRUNCATED, // The input ended in the middle of something
+	SDDS_PARSE_MALFORMED, // The input doesn't follow the format
+	SDDS_PARSE_BAD_VALUE, // A number or hex payload can't be read
+	SDDS_PARSE_DUPLICATE, // Two fields have the same name
+	SDDS_PARSE_NO_MEMORY  // An allocation failed
+} SDDSParseStatus;
+
+// Passed in place of a field index when the field isn't there
+#define SDDS_NO_INDEX              0xFFFFFFFF
+
+// How a field differs between two SDDS
+typedef enum SDDSDiffKind {
+	SDDS_DIFF_ADDED = 0, // Only in the after SDDS
+	SDDS_DIFF_REMOVED,   // Only in the before SDDS
+	SDDS_DIFF_CHANGED    // In both, but the size, type or data differ
+} SDDSDiffKind;
+
+// Called by diffSDDS() for each differing field, in name order. beforeIndex/afterIndex are SDDS_NO_INDEX if the field isn't in that SDDS.
+typedef void (*SDDSDiffCallback)(void *context, SDDSDiffKind kind, const char *fieldName, uint32_t beforeIndex, uint32_t afterIndex);
+
+/// <summary>
+/// Sets up an SDDS. Called by addField, so a zeroed SDDS is ready to use.
+/// </summary>
+void initialize(SDDS *sdds);
+
+/// <summary>
+/// Returns true if the data fits the type (see SDDSFieldType). Types this version doesn't know about are treated as raw.
+/// </summary>
+bool isValidFieldType(BYTE fieldType, uint32_t fieldSize, const BYTE *rawField);
+
+/// <summary>
+/// Returns the a pointer to the raw data for a given field name. Also, optionally can give back the field size, type and index
+/// </summary>
+BYTE* getRawField(SDDS *sdds, char *fieldName, uint32_t *fieldSize, BYTE *fieldType, uint32_t *fieldIndex);
+
+/// <summary>
+/// getRawField() for data that is about to be written in place. If a snapshot shares the field, the field is copied first
+/// so the snapshot doesn't see the write. Returns NULL if there is no such field or the copy can't be allocated.
+/// </summary>
+BYTE* getWritableField(SDDS *sdds, char *fieldName, uint32_t *fieldSize, BYTE *fieldType, uint32_t *fieldIndex);
+
+/// <summary>
+/// Removes the field with the given name. Returns true on success.
+/// </summary>
+bool removeField(SDDS* sdds, char *fieldName);
+
+/// <summary>
+/// Adds a copy of the field to the SDDS. fieldSize is in bits and fieldType is an SDDSFieldType.
+/// Returns true on success (false if the name is taken or the data doesn't fit the type).
+/// </summary>
+bool addField(SDDS *sdds, char* fieldName, uint32_t fieldSize, BYTE* rawField, BYTE fieldType);
+
+/// <summary>
+/// Adds a copy of an array of host order integers, each elementSize bytes, stored little endian so any host can read it back
+/// (with copyLittleEndian()). The same as addField() on little endian hosts. fieldSize is in bits and has to be a whole number of elements.
+/// Returns true on success.
+/// </summary>
+bool addLittleEndianField(SDDS *sdds, char* fieldName, uint32_t fieldSize, BYTE* rawField, uint32_t elementSize);
+
+/// <summary>
+/// Adds a 64 bit unsigned field. Returns true on success.
+/// </summary>
+bool addU64(SDDS *sdds, char *fieldName, uint64_t value);
+
+/// <summary>
+/// Adds a 64 bit signed field. Returns true on success.
+/// </summary>
+bool addI64(SDDS *sdds, char *fieldName, int64_t value);
+
+/// <summary>
+/// Adds a 1 bit boolean field. Returns true on success.
+/// </summary>
+bool addBool(SDDS *sdds, char *fieldName, bool value);
+
+/// <summary>
+/// Adds a copy of a null terminated string (null char included). Returns true on success.
+/// </summary>
+bool addString(SDDS *sdds, char *fieldName, const char *value);
+
+/// <summary>
+/// Reads a field added with addU64(). Returns false if there is no such field or it is of another type.
+/// </summary>
+bool getU64(SDDS *sdds, char *fieldName, uint64_t *value);
+
+/// <summary>
+/// Reads a field added with addI64(). Returns false if there is no such field or it is of another type.
+/// </summary>
+bool getI64(SDDS *sdds, char *fieldName, int64_t *value);
+
+/// <summary>
+/// Reads a field added with addBool(). Returns false if there is no such field or it is of another type.
+/// </summary>
+bool getBool(SDDS *sdds, char *fieldName, bool *value);
+
+/// <summary>
+/// Points value at a string added with addString() (no copy is made, so it is valid until the field is changed or removed).
+/// Returns false if there is no such field or it is of another type.
+/// </summary>
+bool getString(SDDS *sdds, char *fieldName, const char **value);
+
+/// <summary>
+/// Builds a sorted index over the field names and keeps it up to date from then on.
+/// Lookups become binary searches and the ordered queries below become available. Output still uses insertion order.
+/// Returns false if the index can't be allocated.
+/// </summary>
+bool enableSortedIndex(SDDS *sdds);
+
+/// <summary>
+/// Returns the index of the field at the given position in name order. Needs the sorted index.
+/// </summary>
+uint32_t getSortedFieldIndex(SDDS *sdds, uint32_t position);
+
+/// <summary>
+/// Finds the fields with names in [firstName, lastName) (NULL for an open end). Builds the sorted index if needed.
+/// Returns how many there are; they are at positions *startPosition onwards (see getSortedFieldIndex()).
+/// </summary>
+uint32_t findFieldRange(SDDS *sdds, const char *firstName, const char *lastName, uint32_t *startPosition);
+
+/// <summary>
+/// Finds the fields with names starting with prefix (like "Temp."). Builds the sorted index if needed.
+/// Returns how many there are; they are at positions *startPosition onwards (see getSortedFieldIndex()).
+/// </summary>
+uint32_t findFieldsWithPrefix(SDDS *sdds, const char *prefix, uint32_t *startPosition);
+
+/// <summary>
+/// Walks both SDDS in name order and calls callback for each added, removed or changed field.
+/// Builds the sorted indexes if needed. Returns false if they can't be built.
+/// </summary>
+bool diffSDDS(SDDS *before, SDDS *after, SDDSDiffCallback callback, void *context);
+
+/// <summary>
+/// Returns the number of fields
+/// </summary>
+uint32_t getFieldCount(SDDS *sdds);
+
+/// <summary>
+/// Returns the size in bits
+/// </summary>
+uint64_t getTotalBitSize(SDDS *sdds);
+
+/// <summary>
+/// Returns the size in bytes
+/// </summary>
+uint64_t getTotalByteSize(SDDS *sdds);
+
+/// <summary>
+/// Returns the length of the string toXml() will give back (not including the null char)
+/// </summary>
+uint64_t getXmlSize(SDDS *sdds);
+
+/// <summary>
+/// Returns the number of bytes toBinary() will give back
+/// </summary>
+uint64_t getBinarySize(SDDS *sdds);
+
+/// <summary>
+/// Returns the number of characters toXml() uses for a single field
+/// </summary>
+uint64_t getXmlFieldSize(uint32_t nameLen, uint32_t fieldSize, BYTE fieldType);
+
+/// <summary>
+/// Returns the number of bytes toBinary() uses for a single field
+/// </summary>
+uint64_t getBinaryFieldSize(uint32_t nameLen, uint32_t fieldSize);
+
+/// <summary>
+/// Gives the fieldSize (in bits, null char included) of a String field holding value. Returns false if value is NULL
+/// or too long for a bit size to hold. Used by every add string call.
+/// </summary>
+bool getStringFieldSize(const char *value, uint32_t *fieldSize);
+
+/// <summary>
+/// Method to describe the SDDS. The returned string must be freed.
+/// </summary>
+char* toXml(SDDS *sdds);
+
+/// <summary>
+/// Serializes the SDDS to bytes. The returned buffer must be freed.
+/// </summary>
+BYTE* toBinary(SDDS *sdds);
+
+/// <summary>
+/// Writes toXml() output (with the null char) into a caller buffer, like one reserved in a ring buffer.
+/// Returns the length without the null char, or 0 if bufferSize isn't more than getXmlSize().
+/// </summary>
+uint64_t writeXml(SDDS *sdds, char *buffer, uint64_t bufferSize);
+
+/// <summary>
+/// Writes toBinary() output into a caller buffer. Returns the number of bytes written, or 0 if bufferSize is less than getBinarySize().
+/// </summary>
+uint64_t writeBinary(SDDS *sdds, BYTE *buffer, uint64_t bufferSize);
+
+/// <summary>
+/// Fills an empty SDDS from xmlLen characters of toXml() output. Everything is bounds checked, so this is safe for untrusted input.
+/// On failure the SDDS is closed.
+/// </summary>
+SDDSParseStatus fromXml(SDDS *sdds, const char *xml, size_t xmlLen);
+
+/// <summary>
+/// Fills an empty SDDS from binarySize bytes of toBinary() output. Everything is bounds checked, so this is safe for untrusted input.
+/// On failure the SDDS is closed.
+/// </summary>
+SDDSParseStatus fromBinary(SDDS *sdds, const BYTE *binary, size_t binarySize);
+
+/// <summary>
+/// Makes a delta that turns before into after. *deltaSize gets its size. The returned buffer must be freed.
+/// Builds the sorted indexes if needed. Added fields are in the order they were added to after.
+/// </summary>
+BYTE* toDelta(SDDS *before, SDDS *after, uint64_t *deltaSize);
+
+/// <summary>
+/// Applies deltaSize bytes of toDelta() output to the SDDS. Changed fields keep their place, added ones go on the end.
+/// Removing a field that isn't there is not an error. The whole delta is checked before anything is changed,
+/// so only running out of memory part way through can leave the SDDS partly patched.
+/// </summary>
+SDDSParseStatus applyDelta(SDDS *sdds, const BYTE *delta, size_t deltaSize);
+
+/// <summary>
+/// Describes the SDDS with one "name: value" line per field, with each value formatted by its type (raw fields as hex).
+/// The returned string must be freed.
+/// </summary>
+char* toString(SDDS *sdds);
+
+/// <summary>
+/// Fills an empty SDDS with a snapshot of sdds that shares its field names and data instead of copying them.
+/// The cost is a pointer copy per field, whatever their size, plus one block of reference counts for the fields not shared before.
+/// Either SDDS can then be changed or closed; a shared field is only copied when it is written through getWritableField()
+/// or replaced by applyDelta(), and freed when the last SDDS holding it lets go. The snapshot can be handed to another
+/// thread and read there without locks while the original keeps changing (each SDDS still has one user at a time).
+/// Returns false if an allocation fails, leaving the snapshot empty.
+/// </summary>
+bool snapshotSDDS(SDDS *sdds, SDDS *snapshot);
+
+/// <summary>
+/// Used to free all allocations.
+/// </summary>
+void closeSDDS(SDDS *sdds);
@@ -0,0 +1,370 @@
+// Implementation file for writing an SDDS field by field, without building it in memory first
+// (C) - Charles Machalow via the MIT License
+
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif // _WIN32
+
+// Local includes
+#include "SDDSWriter.h"
+
+/*
+*
+* Functions relating to sinks
+*
+*/
+
+// Hands len bytes straight to an fd or callback sink
+static bool sinkWrite(SDDSWriter *writer, const BYTE *data, size_t len)
+{
+	if (writer->Sink == SDDS_SINK_CALLBACK)
+	{
+		return writer->Callback(writer->Context, data, len);
+	}
+
+	while (len)
+	{
+#ifdef _WIN32
+		unsigned int chunk = len > INT32_MAX ? INT32_MAX : (unsigned int)len;
+		int written = _write(writer->Fd, data, chunk);
+#else
+		ssize_t written = write(writer->Fd, data, len);
+		if (written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+#endif // _WIN32
+		if (written <= 0)
+		{
+			return false;
+		}
+		data += written;
+		len -= (size_t)written;
+	}
+	return true;
+}
+
+// Hands the gathered bytes to the sink. Returns false (and sets the status) if it fails.
+static bool flushWriter(SDDSWriter *writer)
+{
+	if (writer->Sink != SDDS_SINK_BUFFER && writer->Used)
+	{
+		if (!sinkWrite(writer, writer->Buffer, writer->Used))
+		{
+			writer->Status = SDDS_WRITER_SINK_ERROR;
+			return false;
+		}
+		writer->Used = 0;
+	}
+	return true;
+}
+
+// Returns where the next output byte goes, with *room set to how many fit there (at least minRoom).
+// Returns NULL (and sets the status) if there isn't that much room.
+static BYTE* getOutputSpace(SDDSWriter *writer, size_t minRoom, size_t *room)
+{
+	if (writer->Sink == SDDS_SINK_BUFFER)
+	{
+		*room = writer->OutputSize - writer->Used;
+		if (*room < minRoom)
+		{
+			writer->Status = SDDS_WRITER_FULL;
+			return NULL;
+		}
+		return writer->Output + writer->Used;
+	}
+
+	if (SDDS_WRITER_BUFFER_SIZE - writer->Used < minRoom && !flushWriter(writer))
+	{
+		return NULL;
+	}
+	*room = SDDS_WRITER_BUFFER_SIZE - writer->Used;
+	return writer->Buffer + writer->Used;
+}
+
+static void writeBytes(SDDSWriter *writer, const void *data, size_t len)
+{
+	const BYTE *cur = (const BYTE*)data;
+	if (writer->Status != SDDS_WRITER_OK)
+	{
+		return;
+	}
+
+	// Big pieces go straight to the sink rather than through the buffer
+	if (writer->Sink != SDDS_SINK_BUFFER && len >= SDDS_WRITER_BUFFER_SIZE)
+	{
+		if (flushWriter(writer))
+		{
+			if (sinkWrite(writer, cur, len))
+			{
+				writer->Size += len;
+			}
+			else
+			{
+				writer->Status = SDDS_WRITER_SINK_ERROR;
+			}
+		}
+		return;
+	}
+
+	while (len)
+	{
+		size_t room = 0;
+		BYTE *dest = getOutputSpace(writer, 1, &room);
+		if (!dest)
+		{
+			return;
+		}
+		size_t chunk = len < room ? len : room;
+		memcpy(dest, cur, chunk);
+		writer->Used += chunk;
+		writer->Size += chunk;
+		cur += chunk;
+		len -= chunk;
+	}
+}
+
+// Writes data as the two hex digits per byte that toXml() uses
+static void writeHex(SDDSWriter *writer, const BYTE *data, size_t len)
+{
+	static const char hexChars[] = "0123456789ABCDEF";
+
+	while (len && writer->Status == SDDS_WRITER_OK)
+	{
+		size_t room = 0;
+		BYTE *dest = getOutputSpace(writer, 2, &room);
+		if (!dest)
+		{
+			return;
+		}
+		size_t chunk = len < (room / 2) ? len : (room / 2);
+		for (size_t i = 0; i < chunk; i++)
+		{
+			*dest++ = hexChars[data[i] >> 4];
+			*dest++ = hexChars[data[i] & 0xF];
+		}
+		writer->Used += 2 * chunk;
+		writer->Size += 2 * chunk;
+		data += chunk;
+		len -= chunk;
+	}
+}
+
+static void writeU32(SDDSWriter *writer, uint32_t value)
+{
+	uint32_t stored = LITTLE_ENDIAN_32(value);
+	writeBytes(writer, &stored, sizeof(stored));
+}
+
+static void writeDecimalText(SDDSWriter *writer, uint32_t value)
+{
+	char digits[16];
+	writeBytes(writer, digits, writeDecimal(digits, value));
+}
+
+/*
+*
+* Functions relating to opening and closing
+*
+*/
+
+// Sets up everything but the sink and writes the start of the output
+static SDDSWriterStatus openWriter(SDDSWriter *writer, SDDSWriterFormat format, SDDSSinkKind sink)
+{
+	writer->Format = format;
+	writer->Sink = sink;
+	writer->Used = 0;
+	writer->Size = 0;
+	writer->FieldCount = 0;
+	writer->FieldBytesLeft = 0;
+	writer->InField = false;
+	writer->Status = SDDS_WRITER_OK;
+
+	if (format == SDDS_WRITER_XML)
+	{
+		writeBytes(writer, SDDS_XML_START, CONST_STR_LEN(SDDS_XML_START));
+	}
+	else
+	{
+		BYTE version = SDDS_BINARY_VERSION;
+		writeBytes(writer, SDDS_BINARY_MAGIC, CONST_STR_LEN(SDDS_BINARY_MAGIC));
+		writeBytes(writer, &version, sizeof(version));
+	}
+	return writer->Status;
+}
+
+SDDSWriterStatus sddsWriterOpenBuffer(SDDSWriter *writer, SDDSWriterFormat format, BYTE *buffer, size_t bufferSize)
+{
+	writer->Output = buffer;
+	writer->OutputSize = bufferSize;
+	return openWriter(writer, format, SDDS_SINK_BUFFER);
+}
+
+SDDSWriterStatus sddsWriterOpenFd(SDDSWriter *writer, SDDSWriterFormat format, int fd)
+{
+	writer->Fd = fd;
+	return openWriter(writer, format, SDDS_SINK_FD);
+}
+
+SDDSWriterStatus sddsWriterOpenCallback(SDDSWriter *writer, SDDSWriterFormat format, SDDSSinkCallback callback, void *context)
+{
+	writer->Callback = callback;
+	writer->Context = context;
+	return openWriter(writer, format, SDDS_SINK_CALLBACK);
+}
+
+SDDSWriterStatus sddsWriterClose(SDDSWriter *writer)
+{
+	if (writer->InField && writer->Status == SDDS_WRITER_OK)
+	{
+		writer->Status = SDDS_WRITER_BAD_FIELD;
+	}
+
+	if (writer->Format == SDDS_WRITER_XML)
+	{
+		writeBytes(writer, SDDS_XML_END, CONST_STR_LEN(SDDS_XML_END));
+	}
+	else
+	{
+		writeU32(writer, SDDS_BINARY_END_MARKER);
+	}
+
+	if (writer->Status == SDDS_WRITER_OK)
+	{
+		flushWriter(writer);
+	}
+	return writer->Status;
+}
+
+/*
+*
+* Functions relating to fields
+*
+*/
+
+SDDSWriterStatus sddsWriterBeginField(SDDSWriter *writer, const char *fieldName, uint32_t fieldSize, BYTE fieldType)
+{
+	if (writer->Status != SDDS_WRITER_OK)
+	{
+		return writer->Status;
+	}
+	if (writer->InField)
+	{
+		return SDDS_WRITER_BAD_FIELD;
+	}
+
+	uint32_t nameLen = cStrLen((char*)fieldName);
+	if (writer->Format == SDDS_WRITER_XML)
+	{
+		writeBytes(writer, SDDS_XML_FIELD_NAME, CONST_STR_LEN(SDDS_XML_FIELD_NAME));
+		writeBytes(writer, fieldName, nameLen);
+		writeBytes(writer, SDDS_XML_FIELD_SIZE, CONST_STR_LEN(SDDS_XML_FIELD_SIZE));
+		writeDecimalText(writer, fieldSize);
+		writeBytes(writer, SDDS_XML_FIELD_TYPE, CONST_STR_LEN(SDDS_XML_FIELD_TYPE));
+		writeDecimalText(writer, fieldType);
+		writeBytes(writer, SDDS_XML_FIELD_DATA, CONST_STR_LEN(SDDS_XML_FIELD_DATA));
+	}
+	else
+	{
+		writeU32(writer, nameLen);
+		writeBytes(writer, fieldName, nameLen);
+		writeU32(writer, fieldSize);
+		writeBytes(writer, &fieldType, sizeof(fieldType));
+	}
+
+	writer->FieldBytesLeft = roundToByte(fieldSize);
+	writer->InField = true;
+	return writer->Status;
+}
+
+SDDSWriterStatus sddsWriterAddFieldData(SDDSWriter *writer, const BYTE *data, size_t len)
+{
+	if (writer->Status != SDDS_WRITER_OK)
+	{
+		return writer->Status;
+	}
+	if (!writer->InField || len > writer->FieldBytesLeft)
+	{
+		return SDDS_WRITER_BAD_FIELD;
+	}
+
+	if (writer->Format == SDDS_WRITER_XML)
+	{
+		writeHex(writer, data, len);
+	}
+	else
+	{
+		writeBytes(writer, data, len);
+	}
+	writer->FieldBytesLeft -= len;
+	return writer->Status;
+}
+
+SDDSWriterStatus sddsWriterEndField(SDDSWriter *writer)
+{
+	if (writer->Status != SDDS_WRITER_OK)
+	{
+		return writer->Status;
+	}
+	if (!writer->InField)
+	{
+		return SDDS_WRITER_BAD_FIELD;
+	}
+	if (writer->FieldBytesLeft)
+	{
+		// What was written can't be taken back, so the output is broken
+		writer->Status = SDDS_WRITER_BAD_FIELD;
+		return writer->Status;
+	}
+
+	if (writer->Format == SDDS_WRITER_XML)
+	{
+		writeBytes(writer, SDDS_XML_FIELD_END, CONST_STR_LEN(SDDS_XML_FIELD_END));
+	}
+	writer->InField = false;
+	writer->FieldCount++;
+	return writer->Status;
+}
+
+SDDSWriterStatus sddsWriterAddField(SDDSWriter *writer, const char *fieldName, uint32_t fieldSize, const BYTE *rawField, BYTE fieldType)
+{
+	if (writer->Status == SDDS_WRITER_OK && (writer->InField || !isValidFieldType(fieldType, fieldSize, rawField)))
+	{
+		return SDDS_WRITER_BAD_FIELD;
+	}
+	sddsWriterBeginField(writer, fieldName, fieldSize, fieldType);
+	sddsWriterAddFieldData(writer, rawField, roundToByte(fieldSize));
+	return sddsWriterEndField(writer);
+}
+
+SDDSWriterStatus sddsWriterAddU64(SDDSWriter *writer, const char *fieldName, uint64_t value)
+{
+	uint64_t stored = LITTLE_ENDIAN_64(value);
+	return sddsWriterAddField(writer, fieldName, 64, (const BYTE*)&stored, SDDS_TYPE_U64);
+}
+
+SDDSWriterStatus sddsWriterAddI64(SDDSWriter *writer, const char *fieldName, int64_t value)
+{
+	uint64_t stored = LITTLE_ENDIAN_64((uint64_t)value);
+	return sddsWriterAddField(writer, fieldName, 64, (const BYTE*)&stored, SDDS_TYPE_I64);
+}
+
+SDDSWriterStatus sddsWriterAddBool(SDDSWriter *writer, const char *fieldName, bool value)
+{
+	BYTE stored = value ? 1 : 0;
+	return sddsWriterAddField(writer, fieldName, 1, &stored, SDDS_TYPE_BOOL);
+}
+
+SDDSWriterStatus sddsWriterAddString(SDDSWriter *writer, const char *fieldName, const char *value)
+{
+	uint32_t fieldSize = 0;
+	if (!getStringFieldSize(value, &fieldSize))
+	{
+		return writer->Status == SDDS_WRITER_OK ? SDDS_WRITER_BAD_FIELD : writer->Status;
+	}
+	return sddsWriterAddField(writer, fieldName, fieldSize, (const BYTE*)value, SDDS_TYPE_STRING);
+}
@@ -0,0 +1,126 @@
+// Header file for writing an SDDS field by field, without building it in memory first
+// (C) - Charles Machalow via the MIT License
+
+#pragma once
+
+// Local includes
+#include "SDDS.h"
+
+// Bytes a writer gathers before handing them to an fd or callback sink. This is all the memory a writer uses.
+#define SDDS_WRITER_BUFFER_SIZE 4096
+
+// Called with each full buffer (and what is left at the end). Returns false to stop the writer.
+typedef bool (*SDDSSinkCallback)(void *context, const BYTE *data, size_t len);
+
+/// <summary>
+/// Result of a writer call. Once the sink fails every call after it returns the same status.
+/// </summary>
+typedef enum SDDSWriterStatus {
+	SDDS_WRITER_OK = 0,
+	SDDS_WRITER_SINK_ERROR, // The fd write failed or the callback returned false
+	SDDS_WRITER_FULL,       // A buffer sink ran out of room
+	SDDS_WRITER_BAD_FIELD   // The field doesn't fit its type, or field data doesn't match the size it was started with
+} SDDSWriterStatus;
+
+/// <summary>
+/// What a writer produces: exactly what toXml() (without the null char) or toBinary() gives for the same fields
+/// </summary>
+typedef enum SDDSWriterFormat {
+	SDDS_WRITER_XML = 0,
+	SDDS_WRITER_BINARY
+} SDDSWriterFormat;
+
+/// <summary>
+/// Where a writer's output goes
+/// </summary>
+typedef enum SDDSSinkKind {
+	SDDS_SINK_BUFFER = 0, // Written straight into a caller buffer
+	SDDS_SINK_FD,         // Gathered and written to a file descriptor
+	SDDS_SINK_CALLBACK    // Gathered and passed to a callback
+} SDDSSinkKind;
+
+/// <summary>
+/// Encodes fields as they are added. Nothing is kept about a field once it is written and nothing is allocated,
+/// so output of any size takes SDDS_WRITER_BUFFER_SIZE bytes. Field names are not checked for duplicates
+/// (fromXml() and fromBinary() reject output that has them). Not thread safe.
+/// </summary>
+typedef struct SDDSWriter {
+	SDDSWriterFormat Format;
+	SDDSSinkKind Sink;
+	BYTE *Output;        // Caller buffer with SDDS_SINK_BUFFER
+	size_t OutputSize;
+	int Fd;
+	SDDSSinkCallback Callback;
+	void *Context;
+	size_t Used;         // Bytes in Output (SDDS_SINK_BUFFER) or Buffer not handed to the sink yet
+	uint64_t Size;       // Bytes of output so far
+	uint32_t FieldCount;
+	uint64_t FieldBytesLeft; // Data still owed to a field started with sddsWriterBeginField()
+	bool InField;
+	SDDSWriterStatus Status;
+	BYTE Buffer[SDDS_WRITER_BUFFER_SIZE];
+} SDDSWriter;
+
+/// <summary>
+/// Starts writing into buffer. sddsWriterClose() returns SDDS_WRITER_FULL if the output didn't fit.
+/// </summary>
+SDDSWriterStatus sddsWriterOpenBuffer(SDDSWriter *writer, SDDSWriterFormat format, BYTE *buffer, size_t bufferSize);
+
+/// <summary>
+/// Starts writing to fd at its current offset. The fd is not closed by the writer.
+/// </summary>
+SDDSWriterStatus sddsWriterOpenFd(SDDSWriter *writer, SDDSWriterFormat format, int fd);
+
+/// <summary>
+/// Starts writing to a callback, which gets the output at most SDDS_WRITER_BUFFER_SIZE bytes at a time
+/// (large field data may be passed straight through in bigger pieces).
+/// </summary>
+SDDSWriterStatus sddsWriterOpenCallback(SDDSWriter *writer, SDDSWriterFormat format, SDDSSinkCallback callback, void *context);
+
+/// <summary>
+/// Writes a field, like addField(). fieldSize is in bits and fieldType is an SDDSFieldType.
+/// Returns SDDS_WRITER_BAD_FIELD (without writing anything) if the data doesn't fit the type.
+/// </summary>
+SDDSWriterStatus sddsWriterAddField(SDDSWriter *writer, const char *fieldName, uint32_t fieldSize, const BYTE *rawField, BYTE fieldType);
+
+/// <summary>
+/// Writes a 64 bit unsigned field, like addU64()
+/// </summary>
+SDDSWriterStatus sddsWriterAddU64(SDDSWriter *writer, const char *fieldName, uint64_t value);
+
+/// <summary>
+/// Writes a 64 bit signed field, like addI64()
+/// </summary>
+SDDSWriterStatus sddsWriterAddI64(SDDSWriter *writer, const char *fieldName, int64_t value);
+
+/// <summary>
+/// Writes a 1 bit boolean field, like addBool()
+/// </summary>
+SDDSWriterStatus sddsWriterAddBool(SDDSWriter *writer, const char *fieldName, bool value);
+
+/// <summary>
+/// Writes a null terminated string field (null char included), like addString()
+/// </summary>
+SDDSWriterStatus sddsWriterAddString(SDDSWriter *writer, const char *fieldName, const char *value);
+
+/// <summary>
+/// Starts a field whose data is given in pieces by sddsWriterAddFieldData(), for data too big to hold at once.
+/// The size has to be known up front; the data isn't checked against the type.
+/// </summary>
+SDDSWriterStatus sddsWriterBeginField(SDDSWriter *writer, const char *fieldName, uint32_t fieldSize, BYTE fieldType);
+
+/// <summary>
+/// Writes the next len bytes of the field started by sddsWriterBeginField()
+/// </summary>
+SDDSWriterStatus sddsWriterAddFieldData(SDDSWriter *writer, const BYTE *data, size_t len);
+
+/// <summary>
+/// Ends the field started by sddsWriterBeginField(). Returns SDDS_WRITER_BAD_FIELD if not all of its data was given.
+/// </summary>
+SDDSWriterStatus sddsWriterEndField(SDDSWriter *writer);
+
+/// <summary>
+/// Ends the output and hands everything left to the sink. writer->Size is then the size of the whole output.
+/// Returns the first error seen over the writer's life.
+/// </summary>
+SDDSWriterStatus sddsWriterClose(SDDSWriter *writer);
@@ -10,231 +10,91 @@
 #include <inttypes.h>
 
 // Local includes
-#include "Memory.h"
-
-// Self Describing Data Stream
-typedef struct SDDS {
-	BYTE** Fields;
-	char** FieldNames;
-	uint32_t* FieldSizes;
-	BYTE* FieldStrModifiers;
-	uint32_t FieldCount;
-	bool Initialized;
-} SDDS, *PSDDS;
-
-// Hmm may not need this method if we are forcing users to set their SDDS to all 0.
-void initialize(SDDS *sdds)
+#include "BoundedSDDS.h"
+#include "ConcurrentSDDS.h"
+#include "SDDSWriter.h"
+
+// Example allocator that keeps track of how much memory the SDDS has live
+typedef struct FootprintAllocator {
+	size_t LiveBytes;
+	size_t PeakBytes;
+} FootprintAllocator;
+
+// Each allocation is prefixed with its size so it can be taken off on free
+static void* footprintRealloc(void *context, void *ptr, size_t size)
 {
-	if (!sdds->Initialized)
-	{
-		sdds->Fields = NULL;            // List of raw fields
-		sdds->FieldNames = NULL;        // List of field names
-		sdds->FieldSizes = NULL;        // Used to know the size IN BITS of each field
-		sdds->FieldStrModifiers = NULL; // Used to describe in string format
-		sdds->FieldCount = 0;           // Number of fields
-	}
-	sdds->Initialized = true;
-}
+	FootprintAllocator *footprint = (FootprintAllocator*)context;
+	size_t *block = ptr ? ((size_t*)ptr) - 1 : NULL;
+	size_t oldSize = block ? *block : 0;
 
-// Returns the a pointer to the raw data for a given field name. Also, optionally can give back the field size and field str modifier
-BYTE* getRawField(SDDS *sdds, char *fieldName, uint32_t *fieldSize, BYTE *fieldStrModifier, uint32_t *fieldIndex)
-{
-	if (fieldName && sdds)
+	size_t *newBlock = (size_t*)realloc(block, sizeof(size_t) + size);
+	if (!newBlock)
 	{
-		for (uint32_t i = 0; i < sdds->FieldCount; i++)
-		{
-			if (strcmp(fieldName, sdds->FieldNames[i]) == 0)
-			{
-				if (fieldSize)
-				{
-					*fieldSize = sdds->FieldSizes[i];
-				}
-				if (fieldStrModifier)
-				{
-					*fieldStrModifier = sdds->FieldStrModifiers[i];
-				}
-				if (fieldIndex)
-				{
-					*fieldIndex = i;
-				}
-				return sdds->Fields[i];
-			}
-		}
+		return NULL;
 	}
-	return NULL;
-}
-
-bool removeField(SDDS* sdds, char *fieldName)
-{
-	uint32_t fieldIndex = 0;
-	BYTE* rawField = getRawField(sdds, fieldName, NULL, NULL, &fieldIndex);
-	if (rawField)
+	*newBlock = size;
+	footprint->LiveBytes += size - oldSize;
+	if (footprint->LiveBytes > footprint->PeakBytes)
 	{
-		// free the raw field and field name
-		free(sdds->Fields[fieldIndex]);
-		free(sdds->FieldNames[fieldIndex]);
-
-		// Move up everything after this
-		for (uint32_t i = fieldIndex; i < (sdds->FieldCount - 1); i++)
-		{
-			sdds->FieldSizes[i] = sdds->FieldSizes[i + 1];
-			sdds->FieldStrModifiers[i] = sdds->FieldStrModifiers[i + 1];
-			sdds->Fields[i] = sdds->Fields[i + 1];
-			sdds->FieldNames[i] = sdds->FieldNames[i + 1];
-		}
-
-		sdds->FieldCount--;
-		return true;
+		footprint->PeakBytes = footprint->LiveBytes;
 	}
-	// Field with this name does not exist
-	return false;
+	return newBlock + 1;
 }
 
-// Adds field to the SDDS
-bool addField(SDDS *sdds, char* fieldName, uint32_t fieldSize, BYTE* rawField, BYTE fieldStrModifier)
+static void footprintFree(void *context, void *ptr)
 {
-	initialize(sdds);
-
-	// Make sure the new fieldName is unique
-	if (getRawField(sdds, fieldName, NULL, NULL, NULL))
-	{
-		// Name conflict, name already exists.
-		return false;
-	}
-
-	// Copy name over
-	char *copiedFieldName = NULL;
-	if (!newStrCopy(&copiedFieldName, fieldName))
-	{
-		return false;
-	}
-
-	// Copy raw data
-	BYTE *copiedRawField = NULL;
-	if (!newRawCopy(&copiedRawField, rawField, fieldSize))
-	{
-		// free already allocated
-		free(copiedFieldName);
-		return false;
-	}
-
-	// Add size to list
-	if (!addTo32BitArray(&sdds->FieldSizes, sdds->FieldCount + 1, fieldSize))
-	{
-		// free already allocated
-		free(copiedFieldName);
-		free(copiedRawField);
-		return false;
-	}
-
-	// Add field str modifier to the list
-	if (!addTo8BitArray(&sdds->FieldStrModifiers, sdds->FieldCount + 1, fieldStrModifier))
-	{
-		// free already allocated
-		free(copiedFieldName);
-		free(copiedRawField);
-		return false;
-	}
-
-	// Realloc the Fields and FieldNames
-	if (!(reallocPPPByte(&sdds->Fields, sdds->FieldCount + 1, copiedRawField) && \
-		reallocPPPByte(((BYTE***)&sdds->FieldNames), sdds->FieldCount + 1, (BYTE*)copiedFieldName)))
-	{
-		// free already allocated
-		free(copiedFieldName);
-		free(copiedRawField);
-		return false;
-	}
-
-	// Only set and increment the FieldCount if everything went well.
-	sdds->FieldCount++;
-	return true; 
+	FootprintAllocator *footprint = (FootprintAllocator*)context;
+	size_t *block = ((size_t*)ptr) - 1;
+	footprint->LiveBytes -= *block;
+	free(block);
 }
 
-uint32_t getFieldCount(SDDS *sdds)
+// Prints each difference found by diffSDDS() and counts them by kind
+static void countDiff(void *context, SDDSDiffKind kind, const char *fieldName, uint32_t beforeIndex, uint32_t afterIndex)
 {
-	return sdds->FieldCount;
+	static const char *kindNames[] = { "added", "removed", "changed" };
+	((uint32_t*)context)[kind]++;
+	printf("  %s %s\n", fieldName, kindNames[kind]);
+	(void)beforeIndex;
+	(void)afterIndex;
 }
 
-// Returns the size in bits
-uint64_t getTotalBitSize(SDDS *sdds)
+// Allocator for code that must not allocate: counts every call and fails it
+static void* refusingRealloc(void *context, void *ptr, size_t size)
 {
-	uint64_t totalSize = 0;
-	for (uint64_t i = 0; i < sdds->FieldCount; i++)
-	{
-		totalSize += sdds->FieldSizes[i];
-	}
-	return totalSize;
-}
-
-uint64_t getTotalByteSize(SDDS *sdds)
-{
-	return (uint64_t)ceill(getTotalBitSize(sdds) / 8.0);
+	(*(uint32_t*)context)++;
+	(void)ptr;
+	(void)size;
+	return NULL;
 }
 
-char* toXml(SDDS *sdds)          // Method to describe the SDDS
+static void refusingFree(void *context, void *ptr)
 {
-	char* retStr = NULL;
-	stringAppend(&retStr, "<Fields>\n");
-	for (uint32_t i = 0; i < sdds->FieldCount; i++)
-	{
-		stringAppend(&retStr, "<Field FieldName=\"");
-		stringAppend(&retStr, sdds->FieldNames[i]);
-		stringAppend(&retStr, "\" ");
-		stringAppend(&retStr, "FieldSize=");
-		char buf[BUFSIZ] = "\0";
-		sprintf(buf, "%u", sdds->FieldSizes[i]);
-		stringAppend(&retStr, buf);
-		stringAppend(&retStr, " ");
-		stringAppend(&retStr, "FieldModifier=");
-		memset(&buf, 0, sizeof(buf));
-		sprintf(buf, "%d", sdds->FieldStrModifiers[i]);
-		stringAppend(&retStr, buf);
-		stringAppend(&retStr, ">");
-
-		// Add raw buffer data
-		for (uint32_t j = 0; j < roundToByte(sdds->FieldSizes[i]); j++)
-		{
-			memset(&buf, 0, sizeof(buf));
-			sprintf(buf, "%02X", sdds->Fields[i][j]);
-			stringAppend(&retStr, buf);
-		}
-		stringAppend(&retStr, "</Field>\n");
-	}
-	stringAppend(&retStr, "</Fields>\n");
-
-	return retStr;
+	(*(uint32_t*)context)++;
+	(void)ptr;
 }
 
-char* toString(SDDS *sdds)         // Method to parse the SDDS
-{
-	char* retStr = NULL;
-	for (uint32_t i = 0; i < sdds->FieldCount; i++)
-	{
-		stringAppend(&retStr, sdds->FieldNames[i]);
-		stringAppend(&retStr, "\n");
-	}
-	return retStr;
-}
+// Counts what a streaming writer hands its sink, and how much at most in one call
+typedef struct SinkCount {
+	uint64_t Bytes;
+	size_t Largest;
+} SinkCount;
 
-// Used to free all allocations.
-void close(SDDS *sdds)
+static bool countSink(void *context, const BYTE *data, size_t len)
 {
-	sdds->Initialized = false;
-	for (uint32_t i = 0; i < sdds->FieldCount; i++)
-	{
-		free(sdds->Fields[i]);
-		free(sdds->FieldNames[i]);
-	}
-	free(sdds->FieldSizes);
-	free(sdds->FieldStrModifiers);
-	free(sdds->Fields);
-	free(sdds->FieldNames);
-	sdds->FieldCount = 0;
+	SinkCount *sink = (SinkCount*)context;
+	sink->Bytes += len;
+	sink->Largest = len > sink->Largest ? len : sink->Largest;
+	(void)data;
+	return true;
 }
 
 int main()
 {
+	FootprintAllocator footprint = { 0 };
+	SDDSAllocator allocator = { footprintRealloc, footprintFree, &footprint };
+	setAllocator(&allocator);
+
 	SDDS s = { 0 };
 	BYTE a[1] = { 1 };
 	addField(&s, "A", 8, a, 0);
@@ -251,11 +111,14 @@ int main()
 	printf("Size in Bytes: %" PRIu64 "\n", getTotalByteSize(&s));
 	char * xml = toXml(&s);
 	printf("xml:\n%s\n", xml);
+	assert(strlen(xml) == getXmlSize(&s));
 
-	assert(removeField(&s, "B"));
+	bool removed = removeField(&s, "B");
+	assert(removed);
+	(void)removed;
 
-	free(fields);
-	free(xml);
+	memFree(fields);
+	memFree(xml);
 
 	printf("After removing B:\n\n");
 	fields = toString(&s);
@@ -264,72 +127,291 @@ int main()
 	printf("Size in Bytes: %" PRIu64 "\n", getTotalByteSize(&s));
 	xml = toXml(&s);
 	printf("xml:\n%s\n", xml);
+	assert(strlen(xml) == getXmlSize(&s));
+	BYTE* binary = toBinary(&s);
+	printf("Size in Binary: %" PRIu64 "\n", getBinarySize(&s));
+
+	// Both serializations parse back into the same SDDS
+	SDDS parsedXml = { 0 };
+	SDDS parsedBinary = { 0 };
+	SDDSParseStatus status = fromXml(&parsedXml, xml, (size_t)getXmlSize(&s));
+	assert(status == SDDS_PARSE_OK);
+	status = fromBinary(&parsedBinary, binary, (size_t)getBinarySize(&s));
+	assert(status == SDDS_PARSE_OK);
+	assert(getFieldCount(&parsedXml) == getFieldCount(&s) && getFieldCount(&parsedBinary) == getFieldCount(&s));
+	closeSDDS(&parsedXml);
+	status = fromXml(&parsedXml, xml, (size_t)getXmlSize(&s) - 1);
+	assert(status == SDDS_PARSE_TRUNCATED);
+	(void)status;
+	closeSDDS(&parsedBinary);
+
+	memFree(fields);
+	memFree(xml);
+	memFree(binary);
+
+	closeSDDS(&s);
+
+	// Typed fields are checked on the way in, so reads are direct loads with no copies
+	SDDS device = { 0 };
+	bool added = addU64(&device, "Capacity", 4000787030016ULL) && addI64(&device, "Temp.Offset", -3) && \
+		addBool(&device, "Healthy", true) && addString(&device, "Serial", "SN0123456789");
+	assert(added && !addField(&device, "Bad", 32, a, SDDS_TYPE_U64));
+	(void)added;
+	uint64_t capacity = 0;
+	int64_t offset = 0;
+	bool healthy = false;
+	const char *serial = NULL;
+	bool read = getU64(&device, "Capacity", &capacity) && getI64(&device, "Temp.Offset", &offset) && \
+		getBool(&device, "Healthy", &healthy) && getString(&device, "Serial", &serial);
+	assert(read && capacity == 4000787030016ULL && offset == -3 && healthy && strcmp(serial, "SN0123456789") == 0);
+	assert(!getU64(&device, "Temp.Offset", &capacity) && !getString(&device, "Missing", &serial));
+	(void)read;
+
+	// Types survive serialization
+	BYTE *deviceBinary = toBinary(&device);
+	SDDS parsedDevice = { 0 };
+	status = fromBinary(&parsedDevice, deviceBinary, (size_t)getBinarySize(&device));
+	assert(status == SDDS_PARSE_OK && getI64(&parsedDevice, "Temp.Offset", &offset) && offset == -3);
+	fields = toString(&parsedDevice);
+	printf("Typed fields:\n%s\n", fields);
+	memFree(fields);
+	memFree(deviceBinary);
+	closeSDDS(&parsedDevice);
+
+	// Raw integers can be stored little endian too, so the xml and binary are the same from any host
+	uint16_t fanSpeeds[2] = { 0x1234, 0xABCD };
+	added = addLittleEndianField(&device, "Fan.Speeds", sizeof(fanSpeeds) * 8, (BYTE*)fanSpeeds, sizeof(uint16_t));
+	assert(added);
+	xml = toXml(&device);
+	assert(strstr(xml, ">3412CDAB</Field>"));
+	uint16_t readSpeeds[2] = { 0 };
+	copyLittleEndian(readSpeeds, getRawField(&device, "Fan.Speeds", NULL, NULL, NULL), sizeof(uint16_t), 2);
+	assert(readSpeeds[0] == 0x1234 && readSpeeds[1] == 0xABCD);
+	deviceBinary = toBinary(&device);
+	assert(deviceBinary[5] == CONST_STR_LEN("Capacity") && deviceBinary[6] == 0); // The first name length, little endian
+	memFree(deviceBinary);
+	memFree(xml);
+	closeSDDS(&device);
+
+	// Ordered queries through the sorted index
+	SDDS temps = { 0 };
+	bool indexed = enableSortedIndex(&temps);
+	assert(indexed);
+	(void)indexed;
+	BYTE reading[2] = { 0x12, 0x34 };
+	addField(&temps, "Temp.Inlet", 16, reading, 0);
+	addField(&temps, "Fan", 8, reading, 0);
+	addField(&temps, "Temp.Outlet", 16, reading, 0);
+	addField(&temps, "Temp.Ambient", 16, reading, 0);
+	addField(&temps, "Voltage", 16, reading, 0);
+	removeField(&temps, "Fan");
+
+	uint32_t position = 0;
+	uint32_t count = findFieldsWithPrefix(&temps, "Temp.", &position);
+	assert(count == 3);
+	printf("Fields starting with Temp.:\n");
+	for (uint32_t i = position; i < position + count; i++)
+	{
+		printf("  %s\n", temps.FieldNames[getSortedFieldIndex(&temps, i)]);
+	}
+	count = findFieldRange(&temps, "Temp.B", "Temp.P", &position);
+	assert(count == 2 && strcmp(temps.FieldNames[getSortedFieldIndex(&temps, position)], "Temp.Inlet") == 0);
+	uint32_t voltageIndex = 0;
+	assert(getRawField(&temps, "Voltage", NULL, NULL, &voltageIndex) && voltageIndex == 3);
+	(void)voltageIndex;
+
+	// Diff against a copy with one field changed, one removed and one added
+	SDDS changed = { 0 };
+	BYTE otherReading[2] = { 0x56, 0x78 };
+	addField(&changed, "Temp.Inlet", 16, otherReading, 0);
+	addField(&changed, "Temp.Outlet", 16, reading, 0);
+	addField(&changed, "Voltage", 16, reading, 0);
+	addField(&changed, "Current", 16, reading, 0);
+	uint32_t diffCounts[3] = { 0 };
+	printf("Differences:\n");
+	bool diffed = diffSDDS(&temps, &changed, countDiff, diffCounts);
+	assert(diffed && diffCounts[SDDS_DIFF_ADDED] == 1 && diffCounts[SDDS_DIFF_REMOVED] == 1 && diffCounts[SDDS_DIFF_CHANGED] == 1);
+	(void)diffed;
+
+	// Patching temps with a delta makes it the same as changed
+	uint64_t deltaSize = 0;
+	BYTE *delta = toDelta(&temps, &changed, &deltaSize);
+	assert(delta);
+	SDDSParseStatus applied = applyDelta(&temps, delta, (size_t)deltaSize);
+	assert(applied == SDDS_PARSE_OK);
+	(void)applied;
+	diffCounts[SDDS_DIFF_ADDED] = diffCounts[SDDS_DIFF_REMOVED] = diffCounts[SDDS_DIFF_CHANGED] = 0;
+	diffed = diffSDDS(&temps, &changed, countDiff, diffCounts);
+	assert(diffed && !diffCounts[SDDS_DIFF_ADDED] && !diffCounts[SDDS_DIFF_REMOVED] && !diffCounts[SDDS_DIFF_CHANGED]);
+	printf("Delta: %" PRIu64 " bytes, full binary: %" PRIu64 " bytes\n", deltaSize, getBinarySize(&changed));
+	memFree(delta);
+
+	// A snapshot shares the fields instead of copying them, so it costs the same however big they are
+	BYTE *image = (BYTE*)memCalloc(64 * 1024, sizeof(BYTE));
+	addField(&changed, "Image", 64 * 1024 * 8, image, 0);
+	memFree(image);
+	size_t liveBefore = footprint.LiveBytes;
+	SDDS snapshot = { 0 };
+	bool snapped = snapshotSDDS(&changed, &snapshot);
+	assert(snapped && footprint.LiveBytes - liveBefore < 1024);
+	assert(getRawField(&snapshot, "Image", NULL, NULL, NULL) == getRawField(&changed, "Image", NULL, NULL, NULL));
+	printf("Snapshot of %" PRIu64 " bytes of fields: %zu bytes\n", getTotalByteSize(&changed), footprint.LiveBytes - liveBefore);
+	(void)snapped;
+
+	// Changing the original only copies the field written to; the snapshot still reads as it was
+	BYTE *inlet = getWritableField(&changed, "Temp.Inlet", NULL, NULL, NULL);
+	assert(inlet && inlet != getRawField(&snapshot, "Temp.Inlet", NULL, NULL, NULL));
+	inlet[0] = 0x9A;
+	removeField(&changed, "Image");
+	addField(&changed, "Power", 16, reading, 0);
+	assert(getRawField(&snapshot, "Temp.Inlet", NULL, NULL, NULL)[0] == 0x56 && getRawField(&snapshot, "Image", NULL, NULL, NULL));
+	diffCounts[SDDS_DIFF_ADDED] = diffCounts[SDDS_DIFF_REMOVED] = diffCounts[SDDS_DIFF_CHANGED] = 0;
+	diffed = diffSDDS(&snapshot, &changed, countDiff, diffCounts);
+	assert(diffed && diffCounts[SDDS_DIFF_ADDED] == 1 && diffCounts[SDDS_DIFF_REMOVED] == 1 && diffCounts[SDDS_DIFF_CHANGED] == 1);
+	closeSDDS(&snapshot);
+
+	closeSDDS(&changed);
+	closeSDDS(&temps);
+
+	// Readers pin a version and look fields up in it without locks while the writer publishes new ones
+	ConcurrentSDDS shared = { 0 };
+	bool opened = concurrentSDDSOpen(&shared);
+	assert(opened);
+	(void)opened;
+	enableSortedIndex(concurrentSDDSWriter(&shared));
+	concurrentSDDSAddField(&shared, "Temp.Inlet", 16, reading, 0);
+	uint32_t reader = concurrentSDDSAddReader(&shared);
+	assert(reader != CONCURRENT_SDDS_NO_READER);
+	SDDS *pinned = concurrentSDDSReadBegin(&shared, reader);
+	BYTE *pinnedInlet = getRawField(pinned, "Temp.Inlet", NULL, NULL, NULL);
+	concurrentSDDSAddField(&shared, "Voltage", 16, otherReading, 0);
+	concurrentSDDSRemoveField(&shared, "Temp.Inlet");
+
+	// The pinned version is kept as it was until the reader is done with it
+	assert(getFieldCount(pinned) == 1 && pinnedInlet[0] == 0x12 && shared.RetiredCount == 2);
+	concurrentSDDSReadEnd(&shared, reader);
+	pinned = concurrentSDDSReadBegin(&shared, reader);
+	assert(getFieldCount(pinned) == 1 && getRawField(pinned, "Voltage", NULL, NULL, NULL) && !getRawField(pinned, "Temp.Inlet", NULL, NULL, NULL));
+	concurrentSDDSReadEnd(&shared, reader);
+	concurrentSDDSPublish(&shared);
+	assert(shared.RetiredCount == 0);
+	(void)pinnedInlet;
+	concurrentSDDSClose(&shared);
+
+	// The streaming writer gives the same output as toXml() and toBinary(), without the SDDS being built first
+	SDDS built = { 0 };
+	addU64(&built, "Count", 42);
+	addString(&built, "Name", "Fan tray");
+	addBool(&built, "Ok", true);
+	addField(&built, "Raw", 16, reading, 0);
+	char *builtXml = toXml(&built);
+	BYTE *builtBinary = toBinary(&built);
+	for (SDDSWriterFormat format = SDDS_WRITER_XML; format <= SDDS_WRITER_BINARY; format++)
+	{
+		BYTE streamed[512];
+		SDDSWriter writer;
+		sddsWriterOpenBuffer(&writer, format, streamed, sizeof(streamed));
+		sddsWriterAddU64(&writer, "Count", 42);
+		sddsWriterAddString(&writer, "Name", "Fan tray");
+		sddsWriterAddBool(&writer, "Ok", true);
+		sddsWriterAddField(&writer, "Raw", 16, reading, 0);
+		SDDSWriterStatus written = sddsWriterClose(&writer);
+		assert(written == SDDS_WRITER_OK);
+		assert(format == SDDS_WRITER_XML ? (writer.Size == getXmlSize(&built) && memcmp(streamed, builtXml, (size_t)writer.Size) == 0) :
+			(writer.Size == getBinarySize(&built) && memcmp(streamed, builtBinary, (size_t)writer.Size) == 0));
+		(void)written;
+	}
+	memFree(builtXml);
+	memFree(builtBinary);
+	closeSDDS(&built);
+
+	// Output of any size goes through the writer's own small buffer, with nothing allocated
+	static const BYTE block[4096] = { 0 };
+	SinkCount sink = { 0 };
+	SDDSWriter streamWriter;
+	uint64_t allocationsBefore = getMemoryStats().Allocations;
+	sddsWriterOpenCallback(&streamWriter, SDDS_WRITER_XML, countSink, &sink);
+	sddsWriterAddU64(&streamWriter, "Width", 2048);
+	sddsWriterBeginField(&streamWriter, "Image", 8 * 1024 * 1024 * 8, SDDS_TYPE_RAW);
+	for (uint32_t i = 0; i < (8 * 1024 * 1024) / sizeof(block); i++)
+	{
+		sddsWriterAddFieldData(&streamWriter, block, sizeof(block));
+	}
+	sddsWriterEndField(&streamWriter);
+	SDDSWriterStatus streamed = sddsWriterClose(&streamWriter);
+	assert(streamed == SDDS_WRITER_OK && sink.Bytes == streamWriter.Size && sink.Largest <= SDDS_WRITER_BUFFER_SIZE);
+	assert(getMemoryStats().Allocations == allocationsBefore);
+	printf("Streamed %" PRIu64 " bytes of xml through a %d byte buffer\n", streamWriter.Size, SDDS_WRITER_BUFFER_SIZE);
+	(void)streamed;
+	(void)allocationsBefore;
+
+	// A bounded SDDS does everything in a block given to it, so a control loop can use it with allocation turned off
+	static uint64_t controlBlock[256];
+	uint32_t allocatorCalls = 0;
+	SDDSAllocator refusing = { refusingRealloc, refusingFree, &allocatorCalls };
+	assert(boundedSDDSBlockSize(8, 64, 128) <= sizeof(controlBlock));
+	setAllocator(&refusing);
+	BoundedSDDS control;
+	bool ready = boundedSDDSInit(&control, controlBlock, sizeof(controlBlock), 8, 64, 128);
+	for (uint32_t tick = 0; tick < 100; tick++)
+	{
+		ready &= boundedSDDSAddU64(&control, "Tick", tick) && boundedSDDSAddI64(&control, "Error", -(int64_t)tick) && \
+			boundedSDDSAddBool(&control, "Saturated", tick > 90) && boundedSDDSAddString(&control, "Mode", "closed loop");
+		ready &= boundedSDDSRemoveField(&control, "Error") && boundedSDDSAddI64(&control, "Error", (int64_t)tick);
+
+		uint64_t readTick = 0;
+		int64_t readError = 0;
+		const char *mode = NULL;
+		ready &= getU64(&control.View, "Tick", &readTick) && readTick == tick && getI64(&control.View, "Error", &readError) && \
+			readError == (int64_t)tick && getString(&control.View, "Mode", &mode) && strcmp(mode, "closed loop") == 0;
+
+		char xml[512];
+		BYTE binary[256];
+		ready &= writeXml(&control.View, xml, sizeof(xml)) == getXmlSize(&control.View) && \
+			writeBinary(&control.View, binary, sizeof(binary)) == getBinarySize(&control.View);
+		if (tick == 99)
+		{
+			assert(strstr(xml, "<Field FieldName=\"Error\" FieldSize=64 FieldModifier=2>6300000000000000</Field>"));
+		}
+		boundedSDDSClear(&control);
+	}
 
-	free(fields);
-	free(xml);
-
-	close(&s);
-
-	return 1;
-}
-
-//
-// Misc Testing Code
-//
-
-// for performance comparison
-typedef struct test_struct
-{
-	BYTE a[1];
-	BYTE b[6];
-	char* c;
-} test_struct;
-
-
-void testCSDDS()
-{
-	SDDS s = { 0 };
-	BYTE a[1] = { 1 };
-	addField(&s, "A", 8, a, 0);
-
-	BYTE b[6] = { 1, 2, 3, 4, 5 ,6 };
-	addField(&s, "B", 48, b, 0);
-
-	char* c = "Hello There!";
-	addField(&s, "C", cStrLen(c) * 8, (BYTE*)c, 0);
-	close(&s);
-}
-
-void testStruct()
-{
-	test_struct t = { 0 };
-	t.a[0] = 1;
-	BYTE b[6] = { 1, 2, 3, 4, 5 ,6 };
-	memcpy(&t.b, &b, 6);
-	t.c = "Hello There!";
+	// Limits are checked rather than grown past
+	char bigName[80];
+	memset(bigName, 'N', sizeof(bigName) - 1);
+	bigName[sizeof(bigName) - 1] = '\0';
+	ready &= !boundedSDDSAddU64(&control, bigName, 1) && boundedSDDSAddField(&control, "Full", 128 * 8, (BYTE*)controlBlock, 0) && \
+		!boundedSDDSAddBool(&control, "OneMore", true) && boundedSDDSRemoveField(&control, "Full");
+	for (uint32_t i = 0; i < 9; i++)
+	{
+		char name[8];
+		snprintf(name, sizeof(name), "F%u", i);
+		ready &= boundedSDDSAddU64(&control, name, i) == (i < 8);
+	}
+	setAllocator(&allocator);
+	assert(ready && allocatorCalls == 0);
+	printf("Bounded SDDS: 100 control loop ticks with %u allocator calls\n", allocatorCalls);
+	(void)ready;
+
+	SDDSCounters counters = getSDDSCounters();
+	printf("Peak SDDS memory: %zu bytes (%zu still live)\n", footprint.PeakBytes, footprint.LiveBytes);
+	printf("Counters (need CSDDS_INSTRUMENTATION): %" PRIu64 " appends, %" PRIu64 " raw copies, %" PRIu64 " lookup comparisons\n",
+		counters.StringAppends, counters.RawCopies, counters.LookupComparisons);
+	setAllocator(NULL);
+
+	return 0;
 }
 
-//
-// End Misc Testing
-//
-
 // Compile / Run / Delete on Linux:
-// gcc -Wall -pedantic Source.c Memory.c -std=c99 -lm && ./a.out && rm a.out
+// gcc -Wall -pedantic Source.c BoundedSDDS.c ConcurrentSDDS.c SDDS.c SDDSWriter.c Memory.c -std=c99 && ./a.out && rm a.out
+// (add -DCSDDS_INSTRUMENTATION to count hot path events)
 
 
 // Overall Todos:
 /*
-- (Re)Move testing codememo
-- Better split up SDDS files into headers/implementation files maybe even forward declare.
-- Implement usage of FieldStrModifiers, and make toString() use it.
-	- May want to convert the modifiers into actual strings to allow users to do things like "0x%08X" as opposed to just 'X'
-		Would also be more forward compatible
+- Let typed fields carry a display format (like "0x%08X") for toString()
 - Add way to go 'toBytes' and get a native byte-buffer representation of just the data (without names, etc)
-- Add way to create from xml
-- Performance (bring all lookups down to O(log(n))). Still not O(1), but much better than O(log(n))
-	- Consider using binary search style sorting for names
-		- Would probably still want to keep track of correct ordering for 'toBytes'
-			- Maybe have a linked list for actual ordering and use the array-style ordering for field name sorting
+- Performance
 	- Consider preallocating memory for structures to not have to do as many callocs/reallocs
 - Add support for nesting
 
@@ -0,0 +1,177 @@
+// FuzzCFList.c - libFuzzer harness for the cFList reader
+// MIT License - 2018 - Charles Machalow
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "CFListDelta.h"
+#include "CFListReader.h"
+
+// Big enough for most fuzzer inputs, small enough that TOO_SMALL gets exercised
+#define OUT_SIZE 256
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	// cFListDecodeRecord() would quietly decode into the wrong members if the token table drifted from TOKEN_*
+	static bool tableChecked = false;
+	if (!tableChecked)
+	{
+		if (!cFListCheckTokenTable())
+		{
+			abort();
+		}
+		tableChecked = true;
+	}
+
+	CFListStatus validStatus = cFListValidate(data, size);
+
+	// Walk every field and convert it by its type
+	CFListReader reader;
+	CFListField field;
+	CFListStatus status = cFListReaderInit(&reader, data, size);
+	bool allConverted = true;
+	while (status == CFLIST_OK && (status = cFListNextField(&reader, &field)) == CFLIST_OK)
+	{
+		char str[OUT_SIZE];
+		uint8_t bin[OUT_SIZE];
+		size_t outLen = 0;
+		uint64_t u;
+		int64_t i;
+		bool b;
+		CFListStatus convertStatus = CFLIST_OK;
+
+		// Pointers handed back must stay inside the input
+		if (field.Value < (const char*)data || field.Value + field.ValueLen > (const char*)data + size)
+		{
+			abort();
+		}
+
+		switch (field.Type)
+		{
+		case CFLIST_TYPE_INTEGER:
+			convertStatus = cFListFieldToSigned(&field, &i);
+			if (convertStatus == CFLIST_BAD_VALUE)
+			{
+				convertStatus = cFListFieldToUnsigned(&field, &u);
+			}
+			break;
+		case CFLIST_TYPE_BOOLEAN:
+			convertStatus = cFListFieldToBoolean(&field, &b);
+			break;
+		case CFLIST_TYPE_STRING:
+			convertStatus = cFListFieldToString(&field, str, sizeof(str), &outLen);
+			if (convertStatus == CFLIST_OK && (outLen >= sizeof(str) || str[outLen] != 0))
+			{
+				abort();
+			}
+			if (convertStatus == CFLIST_TOO_SMALL)
+			{
+				convertStatus = cFListFieldToString(&field, NULL, 0, NULL);
+			}
+			break;
+		case CFLIST_TYPE_HEXBINDATA:
+			convertStatus = cFListFieldToHexBinary(&field, bin, sizeof(bin), &outLen);
+			if (convertStatus == CFLIST_TOO_SMALL)
+			{
+				convertStatus = cFListFieldToHexBinary(&field, NULL, 0, NULL);
+			}
+			break;
+		default:
+			break;
+		}
+
+		allConverted = allConverted && convertStatus == CFLIST_OK;
+	}
+
+	// Validation passes exactly when the walk reaches the end and every value converts
+	if ((validStatus == CFLIST_OK) != (status == CFLIST_END && allConverted))
+	{
+		abort();
+	}
+
+	// The input as a delta for a fixed document, and as the target of a delta from it
+	static const char base[] = "<cFList><field type=\"String\" token=\"B\">Test</field><field type=\"Integer\" token=\"A\">5</field></cFList>";
+	uint8_t delta[4096];
+	uint8_t patched[8192];
+	size_t deltaLen = 0;
+	size_t patchedLen = 0;
+	if (cFListApplyDelta((const uint8_t*)base, sizeof(base) - 1, data, size, patched, sizeof(patched), &patchedLen) == CFLIST_OK)
+	{
+		CFListReader check;
+		CFListField checkField;
+		CFListStatus checkStatus = cFListReaderInit(&check, patched, patchedLen);
+		while (checkStatus == CFLIST_OK)
+		{
+			checkStatus = cFListNextField(&check, &checkField);
+		}
+		if (checkStatus != CFLIST_END)
+		{
+			abort();
+		}
+	}
+	if (cFListMakeDelta((const uint8_t*)base, sizeof(base) - 1, data, size, delta, sizeof(delta), &deltaLen) == CFLIST_OK &&
+		cFListApplyDelta((const uint8_t*)base, sizeof(base) - 1, delta, deltaLen, patched, sizeof(patched), &patchedLen) == CFLIST_OK)
+	{
+		// Every token of the input has to come back with the same (first) value
+		cFListReaderInit(&reader, data, size);
+		while (cFListNextField(&reader, &field) == CFLIST_OK)
+		{
+			char token[OUT_SIZE];
+			CFListField first;
+			CFListField patchedField;
+			if (field.TokenLen >= sizeof(token) || memchr(field.Token, '\0', field.TokenLen))
+			{
+				continue;
+			}
+			memcpy(token, field.Token, field.TokenLen);
+			token[field.TokenLen] = '\0';
+			if (cFListFindField(data, size, token, &first) != CFLIST_OK ||
+				cFListFindField(patched, patchedLen, token, &patchedField) != CFLIST_OK ||
+				patchedField.ValueLen != first.ValueLen || memcmp(patchedField.Value, first.Value, first.ValueLen) != 0)
+			{
+				abort();
+			}
+		}
+	}
+
+	// Lookups by the known tokens
+	uint64_t size_ = 0;
+	bool supportsPower = false;
+	char serial[OUT_SIZE];
+	cFListGetUnsigned(data, size, TOKEN_SIZE, &size_);
+	cFListGetString(data, size, TOKEN_SERIAL, serial, sizeof(serial), NULL);
+	cFListGetBoolean(data, size, TOKEN_SUPPORTS_POWER, &supportsPower);
+
+	// One projection pass has to find the same fields as a lookup per token
+	CFListSlot slots[] = { { TOKEN_SIZE }, { TOKEN_SERIAL }, { TOKEN_SUPPORTS_POWER }, { TOKEN_SIZE } };
+	size_t slotCount = sizeof(slots) / sizeof(slots[0]);
+	if (cFListProject(data, size, slots, slotCount, NULL) == CFLIST_OK)
+	{
+		size_t s = 0;
+		for (; s < slotCount; s++)
+		{
+			CFListField first;
+			if (!slots[s].Found || cFListFindField(data, size, slots[s].TokenId, &first) != CFLIST_OK ||
+				first.Value != slots[s].Field.Value)
+			{
+				abort();
+			}
+		}
+	}
+
+	// The record decode has to agree with the lookups
+	CFListRecord record;
+	if (cFListDecodeRecord(data, size, &record) == CFLIST_OK)
+	{
+		int64_t recordSize = 0;
+		char recordSerial[CFLIST_RECORD_STRING_SIZE];
+		bool recordSupportsPower = false;
+		if (cFListGetSigned(data, size, TOKEN_SIZE, &recordSize) != CFLIST_OK || recordSize != record.Size ||
+			cFListGetString(data, size, TOKEN_SERIAL, recordSerial, sizeof(recordSerial), NULL) != CFLIST_OK || strcmp(recordSerial, record.Serial) != 0 ||
+			cFListGetBoolean(data, size, TOKEN_SUPPORTS_POWER, &recordSupportsPower) != CFLIST_OK || recordSupportsPower != record.SupportsPower)
+		{
+			abort();
+		}
+	}
+	return 0;
+}
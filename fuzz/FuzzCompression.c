@@ -0,0 +1,41 @@
+// FuzzCompression.c - libFuzzer harness for the block codec and frames
+// (C) - Charles Machalow via the MIT License
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Compression.h"
+
+// Big enough for most fuzzer inputs
+#define MAX_INPUT 65536
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	static uint8_t out[MAX_INPUT];
+	static uint8_t frame[COMPRESSION_FRAME_BOUND(MAX_INPUT)];
+	size_t outLen = 0;
+
+	// The input as a frame and as a block with each dictionary
+	decompressFrame(data, size, out, sizeof(out), &outLen);
+	for (uint8_t id = COMPRESSION_DICT_NONE; id <= COMPRESSION_DICT_CFLIST; id++)
+	{
+		decompressBlock(data, size, out, sizeof(out), &outLen, getCompressionDictionary(id));
+	}
+
+	// The input has to survive a round trip with each dictionary
+	if (size > MAX_INPUT)
+	{
+		return 0;
+	}
+	for (uint8_t id = COMPRESSION_DICT_NONE; id <= COMPRESSION_DICT_CFLIST; id++)
+	{
+		size_t frameLen = compressFrame(data, size, id, frame, sizeof(frame));
+		if (frameLen == 0 || frameLen > COMPRESSION_FRAME_BOUND(size) ||
+			decompressFrame(frame, frameLen, out, sizeof(out), &outLen) != COMPRESSION_OK ||
+			outLen != size || memcmp(out, data, size) != 0)
+		{
+			abort();
+		}
+	}
+	return 0;
+}
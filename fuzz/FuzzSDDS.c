@@ -0,0 +1,150 @@
+// FuzzSDDS.c - libFuzzer harness for parsing the dynamic SDDS xml and binary formats
+// (C) - Charles Machalow via the MIT License
+
+#include <stdlib.h>
+
+#include "SDDS.h"
+
+// Any difference between SDDS that should be the same is a bug
+static void failOnDiff(void *context, SDDSDiffKind kind, const char *fieldName, uint32_t beforeIndex, uint32_t afterIndex)
+{
+	abort();
+}
+
+// Typed fields are checked on the way in, so the typed getters have to work on every one of them
+static void checkTypedFields(SDDS *parsed)
+{
+	for (uint32_t i = 0; i < getFieldCount(parsed); i++)
+	{
+		char *name = parsed->FieldNames[i];
+		uint64_t u64 = 0;
+		int64_t i64 = 0;
+		bool boolean = false;
+		const char *string = NULL;
+		bool read = true;
+		switch (parsed->FieldTypes[i])
+		{
+		case SDDS_TYPE_U64:
+			read = getU64(parsed, name, &u64);
+			break;
+		case SDDS_TYPE_I64:
+			read = getI64(parsed, name, &i64);
+			break;
+		case SDDS_TYPE_BOOL:
+			read = getBool(parsed, name, &boolean);
+			break;
+		case SDDS_TYPE_STRING:
+			read = getString(parsed, name, &string) && strlen(string) + 1 == parsed->FieldSizes[i] / 8;
+			break;
+		}
+		if (!read)
+		{
+			abort();
+		}
+	}
+
+	char *str = toString(parsed);
+	if (getFieldCount(parsed) && !str)
+	{
+		abort();
+	}
+	memFree(str);
+}
+
+// Serializing a parsed SDDS and parsing it again has to give back the same SDDS
+static void checkRoundTrip(SDDS *parsed)
+{
+	char *xml = toXml(parsed);
+	BYTE *binary = toBinary(parsed);
+	if (!xml || !binary)
+	{
+		abort();
+	}
+
+	checkTypedFields(parsed);
+
+	SDDS fromXmlCopy = { 0 };
+	SDDS fromBinaryCopy = { 0 };
+	if (!enableSortedIndex(&fromBinaryCopy))
+	{
+		abort();
+	}
+	if (fromXml(&fromXmlCopy, xml, (size_t)getXmlSize(parsed)) != SDDS_PARSE_OK ||
+		fromBinary(&fromBinaryCopy, binary, (size_t)getBinarySize(parsed)) != SDDS_PARSE_OK)
+	{
+		abort();
+	}
+
+	// The binary copy kept its sorted index up to date while parsing, the xml copy gets one built here
+	if (!diffSDDS(&fromXmlCopy, &fromBinaryCopy, failOnDiff, NULL))
+	{
+		abort();
+	}
+
+	char *xmlAgain = toXml(&fromXmlCopy);
+	char *xmlFromBinary = toXml(&fromBinaryCopy);
+	if (!xmlAgain || !xmlFromBinary || strcmp(xml, xmlAgain) != 0 || strcmp(xml, xmlFromBinary) != 0)
+	{
+		abort();
+	}
+
+	// A delta from nothing rebuilds the SDDS in the same order
+	SDDS empty = { 0 };
+	SDDS patched = { 0 };
+	uint64_t deltaSize = 0;
+	BYTE *delta = toDelta(&empty, parsed, &deltaSize);
+	if (!delta || applyDelta(&patched, delta, (size_t)deltaSize) != SDDS_PARSE_OK)
+	{
+		abort();
+	}
+	char *xmlPatched = toXml(&patched);
+	if (!xmlPatched || strcmp(xml, xmlPatched) != 0)
+	{
+		abort();
+	}
+
+	// And a delta back to nothing empties it
+	memFree(delta);
+	delta = toDelta(&patched, &empty, &deltaSize);
+	if (!delta || applyDelta(&patched, delta, (size_t)deltaSize) != SDDS_PARSE_OK || getFieldCount(&patched) != 0)
+	{
+		abort();
+	}
+
+	memFree(xmlPatched);
+	memFree(delta);
+	closeSDDS(&patched);
+	closeSDDS(&empty);
+	memFree(xmlFromBinary);
+	memFree(xmlAgain);
+	memFree(binary);
+	memFree(xml);
+	closeSDDS(&fromBinaryCopy);
+	closeSDDS(&fromXmlCopy);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	SDDS s = { 0 };
+	if (fromXml(&s, (const char*)data, size) == SDDS_PARSE_OK)
+	{
+		checkRoundTrip(&s);
+	}
+	closeSDDS(&s);
+
+	if (fromBinary(&s, data, size) == SDDS_PARSE_OK)
+	{
+		checkRoundTrip(&s);
+	}
+	closeSDDS(&s);
+
+	// Whatever is left of a bad delta has to still be a consistent SDDS
+	BYTE a[1] = { 1 };
+	addField(&s, "A", 8, a, 0);
+	addField(&s, "B", 3, a, 0);
+	addI64(&s, "C", -1);
+	applyDelta(&s, data, size);
+	checkRoundTrip(&s);
+	closeSDDS(&s);
+	return 0;
+}
@@ -0,0 +1,63 @@
+// StandaloneFuzzMain.c - Runs a libFuzzer harness over files, for compilers without -fsanitize=fuzzer
+// (C) - Charles Machalow via the MIT License
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+// Reads all of f. Returns NULL on failure.
+static uint8_t* readAll(FILE *f, size_t *size)
+{
+	size_t capacity = 4096;
+	uint8_t *data = (uint8_t*)malloc(capacity);
+	*size = 0;
+	while (data)
+	{
+		*size += fread(data + *size, 1, capacity - *size, f);
+		if (*size < capacity)
+		{
+			break;
+		}
+
+		uint8_t *bigger = (uint8_t*)realloc(data, capacity * 2);
+		if (!bigger)
+		{
+			free(data);
+			return NULL;
+		}
+		data = bigger;
+		capacity *= 2;
+	}
+	return data;
+}
+
+// Runs each file given (or stdin with no arguments) through the harness
+int main(int argc, char **argv)
+{
+	for (int i = (argc > 1 ? 1 : 0); i < argc; i++)
+	{
+		FILE *f = (argc > 1) ? fopen(argv[i], "rb") : stdin;
+		if (!f)
+		{
+			fprintf(stderr, "Unable to open %s\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+
+		size_t size = 0;
+		uint8_t *data = readAll(f, &size);
+		if (f != stdin)
+		{
+			fclose(f);
+		}
+		if (!data)
+		{
+			return EXIT_FAILURE;
+		}
+
+		LLVMFuzzerTestOneInput(data, size);
+		free(data);
+	}
+	return EXIT_SUCCESS;
+}
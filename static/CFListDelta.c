@@ -0,0 +1,326 @@
+// CFListDelta.c - Deltas between cFList documents, so only changed fields need to be sent
+// MIT License - 2018 - Charles Machalow
+
+#include <string.h>
+
+#include "CFListDelta.h"
+
+#define LITERAL_LEN(s) (sizeof(s) - 1)
+
+// Biggest length a delta can hold
+#define MAX_DELTA_LEN 0xFFFFFFFF
+
+// Writes into a caller buffer, or just counts once it runs out of room
+typedef struct DeltaBuffer {
+	uint8_t* Buf;
+	size_t Size;
+	size_t Len;
+} DeltaBuffer;
+
+static void put(DeltaBuffer* out, const void* data, size_t len)
+{
+	if (out->Buf && out->Len + len <= out->Size)
+	{
+		memcpy(out->Buf + out->Len, data, len);
+	}
+	out->Len += len;
+}
+
+static void putByte(DeltaBuffer* out, uint8_t byte)
+{
+	put(out, &byte, 1);
+}
+
+static void putVarint(DeltaBuffer* out, size_t value)
+{
+	do
+	{
+		uint8_t byte = value & 0x7F;
+		value >>= 7;
+		putByte(out, byte | (value ? 0x80 : 0));
+	} while (value);
+}
+
+// Writes a length then the bytes
+static void putBytes(DeltaBuffer* out, const char* data, size_t len)
+{
+	putVarint(out, len);
+	put(out, data, len);
+}
+
+// Writes a field as XML_FIELD lays it out
+static void putField(DeltaBuffer* out, const char* type, size_t typeLen, const char* token, size_t tokenLen, const char* value, size_t valueLen)
+{
+	put(out, "<field type=\"", LITERAL_LEN("<field type=\""));
+	put(out, type, typeLen);
+	put(out, "\" token=\"", LITERAL_LEN("\" token=\""));
+	put(out, token, tokenLen);
+	put(out, "\">", LITERAL_LEN("\">"));
+	put(out, value, valueLen);
+	put(out, "</field>", LITERAL_LEN("</field>"));
+}
+
+// Finds the first field of doc with the given token
+static CFListStatus findToken(const uint8_t* doc, size_t docLen, const char* token, size_t tokenLen, CFListField* field)
+{
+	CFListReader reader;
+	CFListStatus status = cFListReaderInit(&reader, doc, docLen);
+	while (status == CFLIST_OK && (status = cFListNextField(&reader, field)) == CFLIST_OK)
+	{
+		if (cFListFieldHasToken(field, token, tokenLen))
+		{
+			return CFLIST_OK;
+		}
+	}
+	return status == CFLIST_END ? CFLIST_NOT_FOUND : status;
+}
+
+// Checks that the document can be walked to its end
+static CFListStatus checkStructure(const uint8_t* doc, size_t docLen)
+{
+	CFListReader reader;
+	CFListField field;
+	CFListStatus status = cFListReaderInit(&reader, doc, docLen);
+	while (status == CFLIST_OK)
+	{
+		status = cFListNextField(&reader, &field);
+	}
+	return status == CFLIST_END ? CFLIST_OK : status;
+}
+
+CFListStatus cFListMakeDelta(const uint8_t* before, size_t beforeLen, const uint8_t* after, size_t afterLen,
+	uint8_t* delta, size_t deltaSize, size_t* deltaLen)
+{
+	CFListStatus status;
+	if ((status = checkStructure(before, beforeLen)) != CFLIST_OK || (status = checkStructure(after, afterLen)) != CFLIST_OK)
+	{
+		return status;
+	}
+
+	DeltaBuffer out = { delta, deltaSize, 0 };
+	CFListReader reader;
+	CFListField field;
+	CFListField match;
+	put(&out, CFLIST_DELTA_MAGIC, LITERAL_LEN(CFLIST_DELTA_MAGIC));
+	putByte(&out, CFLIST_DELTA_VERSION);
+
+	// Removed fields
+	cFListReaderInit(&reader, before, beforeLen);
+	while (cFListNextField(&reader, &field) == CFLIST_OK)
+	{
+		if (findToken(after, afterLen, field.Token, field.TokenLen, &match) == CFLIST_NOT_FOUND)
+		{
+			putByte(&out, CFLIST_DELTA_REMOVE);
+			putBytes(&out, field.Token, field.TokenLen);
+		}
+	}
+
+	// Changed and added fields, in the order of after. Later fields with a token already seen don't count.
+	cFListReaderInit(&reader, after, afterLen);
+	while (cFListNextField(&reader, &field) == CFLIST_OK)
+	{
+		if (findToken(after, afterLen, field.Token, field.TokenLen, &match) == CFLIST_OK && match.Value != field.Value)
+		{
+			continue;
+		}
+		if (findToken(before, beforeLen, field.Token, field.TokenLen, &match) == CFLIST_OK &&
+			match.TypeLen == field.TypeLen && memcmp(match.TypeStr, field.TypeStr, field.TypeLen) == 0 &&
+			match.ValueLen == field.ValueLen && memcmp(match.Value, field.Value, field.ValueLen) == 0)
+		{
+			continue;
+		}
+		putByte(&out, CFLIST_DELTA_SET);
+		putBytes(&out, field.Token, field.TokenLen);
+		putBytes(&out, field.TypeStr, field.TypeLen);
+		putBytes(&out, field.Value, field.ValueLen);
+	}
+	putByte(&out, CFLIST_DELTA_END);
+
+	*deltaLen = out.Len;
+	return (delta && out.Len > deltaSize) ? CFLIST_TOO_SMALL : CFLIST_OK;
+}
+
+/*
+*
+* Applying
+*
+*/
+
+// One entry of a delta. All pointers point into the delta.
+typedef struct DeltaEntry {
+	uint8_t Op;
+	const char* Token;
+	size_t TokenLen;
+	const char* Type;
+	size_t TypeLen;
+	const char* Value;
+	size_t ValueLen;
+} DeltaEntry;
+
+static CFListStatus readVarint(const uint8_t** cur, const uint8_t* end, size_t* value)
+{
+	uint64_t result = 0;
+	for (unsigned shift = 0; shift < 35; shift += 7)
+	{
+		if (*cur == end)
+		{
+			return CFLIST_TRUNCATED;
+		}
+
+		uint8_t byte = *(*cur)++;
+		result |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			if (result > MAX_DELTA_LEN)
+			{
+				return CFLIST_BAD_VALUE;
+			}
+			*value = (size_t)result;
+			return CFLIST_OK;
+		}
+	}
+	return CFLIST_BAD_VALUE;
+}
+
+// Reads a length then that many bytes
+static CFListStatus readBytes(const uint8_t** cur, const uint8_t* end, const char** data, size_t* len)
+{
+	CFListStatus status = readVarint(cur, end, len);
+	if (status != CFLIST_OK)
+	{
+		return status;
+	}
+	if ((size_t)(end - *cur) < *len)
+	{
+		return CFLIST_TRUNCATED;
+	}
+	*data = (const char*)*cur;
+	*cur += *len;
+	return CFLIST_OK;
+}
+
+static CFListStatus readEntry(const uint8_t** cur, const uint8_t* end, DeltaEntry* entry)
+{
+	CFListStatus status;
+	if (*cur == end)
+	{
+		return CFLIST_TRUNCATED;
+	}
+
+	entry->Op = *(*cur)++;
+	if (entry->Op == CFLIST_DELTA_END)
+	{
+		return CFLIST_END;
+	}
+	if (entry->Op != CFLIST_DELTA_SET && entry->Op != CFLIST_DELTA_REMOVE)
+	{
+		return CFLIST_MALFORMED;
+	}
+	if ((status = readBytes(cur, end, &entry->Token, &entry->TokenLen)) != CFLIST_OK || entry->Op == CFLIST_DELTA_REMOVE)
+	{
+		return status;
+	}
+	if ((status = readBytes(cur, end, &entry->Type, &entry->TypeLen)) != CFLIST_OK ||
+		(status = readBytes(cur, end, &entry->Value, &entry->ValueLen)) != CFLIST_OK)
+	{
+		return status;
+	}
+
+	// Anything that would break the document's layout can't be let through
+	if (memchr(entry->Token, '"', entry->TokenLen) || memchr(entry->Type, '"', entry->TypeLen) || memchr(entry->Value, '<', entry->ValueLen))
+	{
+		return CFLIST_MALFORMED;
+	}
+	return CFLIST_OK;
+}
+
+// Finds the first entry of the delta with the given token. The delta must already be checked.
+static bool findEntry(const uint8_t* entries, const uint8_t* end, const char* token, size_t tokenLen, DeltaEntry* entry)
+{
+	while (readEntry(&entries, end, entry) == CFLIST_OK)
+	{
+		if (entry->TokenLen == tokenLen && memcmp(entry->Token, token, tokenLen) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+CFListStatus cFListApplyDelta(const uint8_t* before, size_t beforeLen, const uint8_t* delta, size_t deltaLen,
+	uint8_t* out, size_t outSize, size_t* outLen)
+{
+	const uint8_t* end = delta + deltaLen;
+	if (deltaLen < LITERAL_LEN(CFLIST_DELTA_MAGIC) + 1)
+	{
+		return CFLIST_TRUNCATED;
+	}
+	if (memcmp(delta, CFLIST_DELTA_MAGIC, LITERAL_LEN(CFLIST_DELTA_MAGIC)) != 0)
+	{
+		return CFLIST_MALFORMED;
+	}
+	if (delta[LITERAL_LEN(CFLIST_DELTA_MAGIC)] != CFLIST_DELTA_VERSION)
+	{
+		return CFLIST_BAD_VALUE;
+	}
+	const uint8_t* entries = delta + LITERAL_LEN(CFLIST_DELTA_MAGIC) + 1;
+
+	// Check everything first
+	CFListStatus status = checkStructure(before, beforeLen);
+	const uint8_t* cur = entries;
+	DeltaEntry entry;
+	while (status == CFLIST_OK)
+	{
+		status = readEntry(&cur, end, &entry);
+	}
+	if (status != CFLIST_END)
+	{
+		return status;
+	}
+	if (cur != end)
+	{
+		return CFLIST_MALFORMED; // trailing data
+	}
+
+	DeltaBuffer buffer = { out, outSize, 0 };
+	CFListReader reader;
+	CFListField field;
+	put(&buffer, START_XML, LITERAL_LEN(START_XML));
+
+	// The fields of before, replaced or removed if the delta says so
+	cFListReaderInit(&reader, before, beforeLen);
+	while (cFListNextField(&reader, &field) == CFLIST_OK)
+	{
+		if (!findEntry(entries, end, field.Token, field.TokenLen, &entry))
+		{
+			putField(&buffer, field.TypeStr, field.TypeLen, field.Token, field.TokenLen, field.Value, field.ValueLen);
+		}
+		else if (entry.Op == CFLIST_DELTA_SET)
+		{
+			putField(&buffer, entry.Type, entry.TypeLen, field.Token, field.TokenLen, entry.Value, entry.ValueLen);
+		}
+	}
+
+	// Then the added fields
+	cur = entries;
+	while (readEntry(&cur, end, &entry) == CFLIST_OK)
+	{
+		if (entry.Op == CFLIST_DELTA_SET && findToken(before, beforeLen, entry.Token, entry.TokenLen, &field) == CFLIST_NOT_FOUND)
+		{
+			putField(&buffer, entry.Type, entry.TypeLen, entry.Token, entry.TokenLen, entry.Value, entry.ValueLen);
+		}
+	}
+	put(&buffer, END_XML, LITERAL_LEN(END_XML));
+
+	*outLen = buffer.Len;
+	if (!out)
+	{
+		return CFLIST_OK;
+	}
+	if (buffer.Len >= outSize)
+	{
+		return CFLIST_TOO_SMALL;
+	}
+	out[buffer.Len] = '\0';
+	return CFLIST_OK;
+}
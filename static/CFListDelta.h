@@ -0,0 +1,35 @@
+// CFListDelta.h - Deltas between cFList documents, so only changed fields need to be sent
+// MIT License - 2018 - Charles Machalow
+#pragma once
+
+#include "CFListReader.h"
+
+// Delta layout: CFLIST_DELTA_MAGIC, a CFLIST_DELTA_VERSION byte, then entries, each an op byte followed by
+//   CFLIST_DELTA_SET:    token length, token, type length, type, value length, value (still xml escaped / hex encoded)
+//   CFLIST_DELTA_REMOVE: token length, token
+// and CFLIST_DELTA_END. Lengths are LEB128 varints, so short tokens and values cost one byte each.
+#define CFLIST_DELTA_MAGIC   "CFLD"
+#define CFLIST_DELTA_VERSION 1
+#define CFLIST_DELTA_SET     0
+#define CFLIST_DELTA_REMOVE  1
+#define CFLIST_DELTA_END     0xFF
+
+/// <summary>
+/// Writes a delta that turns before into after. Fields are matched by token; if a token is in a document more than once,
+/// its first field is the one that counts. delta may be NULL to only size it. *deltaLen gets the needed size,
+/// even if CFLIST_TOO_SMALL is returned.
+/// No heap is used, so each field is looked up by scanning the other document: the cost is O(fields of after * bytes of before
+/// + fields of before * bytes of after). That is fine up to a few hundred fields (documents the size of the gpBuffer),
+/// but not for big documents like ones with multi megabyte HexBinaryData values; send those whole or split them into records.
+/// </summary>
+CFListStatus cFListMakeDelta(const uint8_t* before, size_t beforeLen, const uint8_t* after, size_t afterLen,
+	uint8_t* delta, size_t deltaSize, size_t* deltaLen);
+
+/// <summary>
+/// Writes before with the delta applied into out and null terminates it. out may be NULL to only size it.
+/// *outLen gets the length without the null char, even if CFLIST_TOO_SMALL is returned. Changed fields keep their place, added ones go on the end.
+/// Removing a token that isn't there is not an error. A delta of another CFLIST_DELTA_VERSION gives CFLIST_BAD_VALUE.
+/// out can't overlap before.
+/// </summary>
+CFListStatus cFListApplyDelta(const uint8_t* before, size_t beforeLen, const uint8_t* delta, size_t deltaLen,
+	uint8_t* out, size_t outSize, size_t* outLen);
@@ -0,0 +1,610 @@
+// CFListReader.c - Bounds checked reader for cFList documents (safe for untrusted input)
+// MIT License - 2018 - Charles Machalow
+
+#include <string.h>
+
+#include "CFListReader.h"
+
+// Pieces of a field, in the order XML_FIELD lays them out
+#define FIELD_START    "<field type=\""
+#define FIELD_TOKEN    "\" token=\""
+#define FIELD_VALUE    "\">"
+#define FIELD_END      "</field>"
+#define LITERAL_LEN(s) (sizeof(s) - 1)
+
+const char* cFListStatusToString(CFListStatus status)
+{
+	switch (status)
+	{
+	case CFLIST_OK:
+		return "ok";
+	case CFLIST_END:
+		return "end of document";
+	case CFLIST_NOT_FOUND:
+		return "token not found";
+	case CFLIST_TRUNCATED:
+		return "document is truncated";
+	case CFLIST_MALFORMED:
+		return "document is malformed";
+	case CFLIST_BAD_TYPE:
+		return "field has a different type";
+	case CFLIST_BAD_VALUE:
+		return "value can't be converted";
+	case CFLIST_TOO_SMALL:
+		return "output buffer is too small";
+	default:
+		return "unknown status";
+	}
+}
+
+/*
+*
+* Scanning
+*
+*/
+
+// Consumes literal at the current offset. Tells apart running out of document from a mismatch.
+static CFListStatus expectLiteral(CFListReader* reader, const char* literal, size_t len)
+{
+	size_t remaining = reader->DocLen - reader->Offset;
+	if (remaining < len)
+	{
+		if (memcmp(reader->Doc + reader->Offset, literal, remaining) == 0)
+		{
+			return CFLIST_TRUNCATED;
+		}
+		return CFLIST_MALFORMED;
+	}
+
+	if (memcmp(reader->Doc + reader->Offset, literal, len) != 0)
+	{
+		return CFLIST_MALFORMED;
+	}
+	reader->Offset += len;
+	return CFLIST_OK;
+}
+
+// Gives back the text from the current offset up to (not including) stop, and moves to stop
+static CFListStatus readUntil(CFListReader* reader, char stop, const char** start, size_t* len)
+{
+	const char* begin = reader->Doc + reader->Offset;
+	const char* found = (const char*)memchr(begin, stop, reader->DocLen - reader->Offset);
+	if (!found)
+	{
+		return CFLIST_TRUNCATED;
+	}
+
+	*start = begin;
+	*len = (size_t)(found - begin);
+	reader->Offset += *len;
+	return CFLIST_OK;
+}
+
+static CFListType getTypeFromString(const char* type, size_t len)
+{
+	if (len == LITERAL_LEN(INTEGER_S) && memcmp(type, INTEGER_S, len) == 0)
+	{
+		return CFLIST_TYPE_INTEGER;
+	}
+	if (len == LITERAL_LEN(BOOL_S) && memcmp(type, BOOL_S, len) == 0)
+	{
+		return CFLIST_TYPE_BOOLEAN;
+	}
+	if (len == LITERAL_LEN(STRING_S) && memcmp(type, STRING_S, len) == 0)
+	{
+		return CFLIST_TYPE_STRING;
+	}
+	if (len == LITERAL_LEN(HEXBINDATA_S) && memcmp(type, HEXBINDATA_S, len) == 0)
+	{
+		return CFLIST_TYPE_HEXBINDATA;
+	}
+	return CFLIST_TYPE_UNKNOWN;
+}
+
+CFListStatus cFListReaderInit(CFListReader* reader, const uint8_t* doc, size_t docLen)
+{
+	reader->Doc = (const char*)doc;
+	reader->DocLen = doc ? docLen : 0;
+	reader->Offset = 0;
+	return expectLiteral(reader, START_XML, LITERAL_LEN(START_XML));
+}
+
+CFListStatus cFListNextField(CFListReader* reader, CFListField* field)
+{
+	CFListStatus status;
+
+	// Either another field or the end of the list
+	if (reader->Offset + 1 < reader->DocLen && reader->Doc[reader->Offset + 1] == '/')
+	{
+		status = expectLiteral(reader, END_XML, LITERAL_LEN(END_XML));
+		return status == CFLIST_OK ? CFLIST_END : status;
+	}
+
+	if ((status = expectLiteral(reader, FIELD_START, LITERAL_LEN(FIELD_START))) != CFLIST_OK ||
+		(status = readUntil(reader, '"', &field->TypeStr, &field->TypeLen)) != CFLIST_OK ||
+		(status = expectLiteral(reader, FIELD_TOKEN, LITERAL_LEN(FIELD_TOKEN))) != CFLIST_OK ||
+		(status = readUntil(reader, '"', &field->Token, &field->TokenLen)) != CFLIST_OK ||
+		(status = expectLiteral(reader, FIELD_VALUE, LITERAL_LEN(FIELD_VALUE))) != CFLIST_OK ||
+		(status = readUntil(reader, '<', &field->Value, &field->ValueLen)) != CFLIST_OK ||
+		(status = expectLiteral(reader, FIELD_END, LITERAL_LEN(FIELD_END))) != CFLIST_OK)
+	{
+		return status;
+	}
+
+	field->Type = getTypeFromString(field->TypeStr, field->TypeLen);
+	return CFLIST_OK;
+}
+
+bool cFListFieldHasToken(const CFListField* field, const char* tokenId, size_t tokenIdLen)
+{
+	return field->TokenLen == tokenIdLen && memcmp(field->Token, tokenId, tokenIdLen) == 0;
+}
+
+CFListStatus cFListValidate(const uint8_t* doc, size_t docLen)
+{
+	CFListReader reader;
+	CFListField field;
+	CFListStatus status = cFListReaderInit(&reader, doc, docLen);
+
+	while (status == CFLIST_OK && (status = cFListNextField(&reader, &field)) == CFLIST_OK)
+	{
+		switch (field.Type)
+		{
+		case CFLIST_TYPE_INTEGER:
+		{
+			int64_t value;
+			status = cFListFieldToSigned(&field, &value);
+			if (status == CFLIST_BAD_VALUE)
+			{
+				// May just be too big to be signed
+				uint64_t uvalue;
+				status = cFListFieldToUnsigned(&field, &uvalue);
+			}
+			break;
+		}
+		case CFLIST_TYPE_BOOLEAN:
+		{
+			bool value;
+			status = cFListFieldToBoolean(&field, &value);
+			break;
+		}
+		case CFLIST_TYPE_STRING:
+			status = cFListFieldToString(&field, NULL, 0, NULL);
+			break;
+		case CFLIST_TYPE_HEXBINDATA:
+			status = cFListFieldToHexBinary(&field, NULL, 0, NULL);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return status == CFLIST_END ? CFLIST_OK : status;
+}
+
+CFListStatus cFListFindField(const uint8_t* doc, size_t docLen, const char* tokenId, CFListField* field)
+{
+	CFListReader reader;
+	CFListStatus status = cFListReaderInit(&reader, doc, docLen);
+	size_t tokenIdLen = strlen(tokenId);
+
+	while (status == CFLIST_OK && (status = cFListNextField(&reader, field)) == CFLIST_OK)
+	{
+		if (cFListFieldHasToken(field, tokenId, tokenIdLen))
+		{
+			return CFLIST_OK;
+		}
+	}
+
+	return status == CFLIST_END ? CFLIST_NOT_FOUND : status;
+}
+
+CFListStatus cFListProject(const uint8_t* doc, size_t docLen, CFListSlot* slots, size_t slotCount, size_t* foundCount)
+{
+	size_t i = 0;
+	for (; i < slotCount; i++)
+	{
+		slots[i].TokenIdLen = strlen(slots[i].TokenId);
+		slots[i].Found = false;
+	}
+
+	CFListReader reader;
+	CFListField field;
+	size_t found = 0;
+	CFListStatus status = cFListReaderInit(&reader, doc, docLen);
+
+	while (found < slotCount && status == CFLIST_OK && (status = cFListNextField(&reader, &field)) == CFLIST_OK)
+	{
+		for (i = 0; i < slotCount; i++)
+		{
+			if (!slots[i].Found && cFListFieldHasToken(&field, slots[i].TokenId, slots[i].TokenIdLen))
+			{
+				slots[i].Field = field;
+				slots[i].Found = true;
+				found++;
+			}
+		}
+	}
+
+	if (foundCount)
+	{
+		*foundCount = found;
+	}
+	if (status == CFLIST_OK)
+	{
+		return CFLIST_OK;
+	}
+	return status == CFLIST_END ? CFLIST_NOT_FOUND : status;
+}
+
+// Every known token is one character, so a table indexed by it gives the slot (plus one, zero for unknown)
+#define CFLIST_TOKEN_CHECK(name, member, tokenChar, type) typedef char cFListTokenIsOneChar_##name[(sizeof(TOKEN_##name) == 2) ? 1 : -1];
+CFLIST_TOKENS(CFLIST_TOKEN_CHECK)
+#undef CFLIST_TOKEN_CHECK
+
+typedef char cFListSlotsFitInPresent[(CFLIST_SLOT_COUNT <= 32) ? 1 : -1];
+
+static const uint8_t tokenSlots[256] = {
+#define CFLIST_TOKEN_ENTRY(name, member, tokenChar, type) [(uint8_t)(tokenChar)] = CFLIST_SLOT_##name + 1,
+	CFLIST_TOKENS(CFLIST_TOKEN_ENTRY)
+#undef CFLIST_TOKEN_ENTRY
+};
+
+bool cFListCheckTokenTable(void)
+{
+	bool matches = true;
+#define CFLIST_TOKEN_MATCH(name, member, tokenChar, type) matches = matches && TOKEN_##name[0] == (tokenChar);
+	CFLIST_TOKENS(CFLIST_TOKEN_MATCH)
+#undef CFLIST_TOKEN_MATCH
+	return matches;
+}
+
+// How each field type converts into its CFListRecord member
+#define CFLIST_DECODE_INTEGER(field, record, member)    cFListFieldToSigned(field, &(record)->member)
+#define CFLIST_DECODE_BOOLEAN(field, record, member)    cFListFieldToBoolean(field, &(record)->member)
+#define CFLIST_DECODE_STRING(field, record, member)     cFListFieldToString(field, (record)->member, sizeof((record)->member), NULL)
+#define CFLIST_DECODE_HEXBINDATA(field, record, member) cFListFieldToHexBinary(field, (record)->member, sizeof((record)->member), &(record)->member##Len)
+
+CFListStatus cFListDecodeRecord(const uint8_t* doc, size_t docLen, CFListRecord* record)
+{
+	const uint32_t allPresent = (uint32_t)((1ULL << CFLIST_SLOT_COUNT) - 1);
+	CFListReader reader;
+	CFListField field;
+	CFListStatus status = cFListReaderInit(&reader, doc, docLen);
+	record->Present = 0;
+
+	while (record->Present != allPresent && status == CFLIST_OK && (status = cFListNextField(&reader, &field)) == CFLIST_OK)
+	{
+		unsigned slot = field.TokenLen == 1 ? tokenSlots[(uint8_t)field.Token[0]] : 0;
+		if (slot == 0 || (record->Present & (1u << (slot - 1))))
+		{
+			continue;
+		}
+
+		switch (slot - 1)
+		{
+#define CFLIST_DECODE_CASE(name, member, tokenChar, type) \
+		case CFLIST_SLOT_##name: \
+			status = CFLIST_DECODE_##type(&field, record, member); \
+			break;
+		CFLIST_TOKENS(CFLIST_DECODE_CASE)
+#undef CFLIST_DECODE_CASE
+		default:
+			break;
+		}
+		record->Present |= 1u << (slot - 1);
+	}
+
+	if (status == CFLIST_OK)
+	{
+		return CFLIST_OK;
+	}
+	return status == CFLIST_END ? CFLIST_NOT_FOUND : status;
+}
+
+/*
+*
+* Conversions
+*
+*/
+
+CFListStatus cFListFieldToUnsigned(const CFListField* field, uint64_t* value)
+{
+	if (field->Type != CFLIST_TYPE_INTEGER)
+	{
+		return CFLIST_BAD_TYPE;
+	}
+	if (field->ValueLen == 0)
+	{
+		return CFLIST_BAD_VALUE;
+	}
+
+	uint64_t result = 0;
+	size_t i = 0;
+	for (; i < field->ValueLen; i++)
+	{
+		unsigned digit = (unsigned)(field->Value[i] - '0');
+		if (digit > 9 || result > (UINT64_MAX - digit) / 10)
+		{
+			return CFLIST_BAD_VALUE;
+		}
+		result = (result * 10) + digit;
+	}
+
+	*value = result;
+	return CFLIST_OK;
+}
+
+CFListStatus cFListFieldToSigned(const CFListField* field, int64_t* value)
+{
+	if (field->Type != CFLIST_TYPE_INTEGER)
+	{
+		return CFLIST_BAD_TYPE;
+	}
+
+	bool negative = field->ValueLen > 0 && field->Value[0] == '-';
+	CFListField digits = *field;
+	if (negative)
+	{
+		digits.Value++;
+		digits.ValueLen--;
+	}
+
+	uint64_t magnitude = 0;
+	CFListStatus status = cFListFieldToUnsigned(&digits, &magnitude);
+	if (status != CFLIST_OK)
+	{
+		return status;
+	}
+
+	if (negative)
+	{
+		if (magnitude > (uint64_t)INT64_MAX + 1)
+		{
+			return CFLIST_BAD_VALUE;
+		}
+		*value = (magnitude == (uint64_t)INT64_MAX + 1) ? INT64_MIN : -(int64_t)magnitude;
+	}
+	else
+	{
+		if (magnitude > (uint64_t)INT64_MAX)
+		{
+			return CFLIST_BAD_VALUE;
+		}
+		*value = (int64_t)magnitude;
+	}
+	return CFLIST_OK;
+}
+
+CFListStatus cFListFieldToBoolean(const CFListField* field, bool* value)
+{
+	if (field->Type != CFLIST_TYPE_BOOLEAN)
+	{
+		return CFLIST_BAD_TYPE;
+	}
+
+	if (field->ValueLen == 4 && (memcmp(field->Value, "True", 4) == 0 || memcmp(field->Value, "true", 4) == 0))
+	{
+		*value = true;
+		return CFLIST_OK;
+	}
+	if (field->ValueLen == 5 && (memcmp(field->Value, "False", 5) == 0 || memcmp(field->Value, "false", 5) == 0))
+	{
+		*value = false;
+		return CFLIST_OK;
+	}
+	return CFLIST_BAD_VALUE;
+}
+
+// Returns the character an escape at the start of s stands for (and its length), or 0 if it isn't one
+static char getEscapedChar(const char* s, size_t len, size_t* escapeLen)
+{
+	static const struct { const char* Escape; size_t Len; char Normal; } escapes[] = {
+		{ XML_LESS_THAN, LITERAL_LEN(XML_LESS_THAN), NORMAL_LESS_THAN },
+		{ XML_GREATER_THAN, LITERAL_LEN(XML_GREATER_THAN), NORMAL_GREATER_THAN },
+		{ XML_AMPERSAND, LITERAL_LEN(XML_AMPERSAND), NORMAL_AMPERSAND },
+		{ XML_DOUBLE_QUOTE, LITERAL_LEN(XML_DOUBLE_QUOTE), NORMAL_DOUBLE_QUOTE },
+		{ XML_SINGLE_QUOTE, LITERAL_LEN(XML_SINGLE_QUOTE), NORMAL_SINGLE_QUOTE },
+	};
+
+	size_t i = 0;
+	for (; i < sizeof(escapes) / sizeof(escapes[0]); i++)
+	{
+		if (len >= escapes[i].Len && memcmp(s, escapes[i].Escape, escapes[i].Len) == 0)
+		{
+			*escapeLen = escapes[i].Len;
+			return escapes[i].Normal;
+		}
+	}
+	return 0;
+}
+
+CFListStatus cFListFieldToString(const CFListField* field, char* out, size_t outSize, size_t* outLen)
+{
+	if (field->Type != CFLIST_TYPE_STRING)
+	{
+		return CFLIST_BAD_TYPE;
+	}
+
+	size_t readOffset = 0;
+	size_t writeOffset = 0;
+	while (readOffset < field->ValueLen)
+	{
+		// Copy everything up to the next escape in one go
+		const char* start = field->Value + readOffset;
+		size_t remaining = field->ValueLen - readOffset;
+		const char* amp = (const char*)memchr(start, NORMAL_AMPERSAND, remaining);
+		size_t runLen = amp ? (size_t)(amp - start) : remaining;
+
+		if (out)
+		{
+			if (outSize - writeOffset <= runLen)
+			{
+				return CFLIST_TOO_SMALL;
+			}
+			memcpy(out + writeOffset, start, runLen);
+		}
+		writeOffset += runLen;
+		readOffset += runLen;
+
+		if (amp)
+		{
+			size_t escapeLen = 0;
+			char normal = getEscapedChar(amp, remaining - runLen, &escapeLen);
+			if (!normal)
+			{
+				return CFLIST_BAD_VALUE;
+			}
+			if (out)
+			{
+				if (outSize - writeOffset <= 1)
+				{
+					return CFLIST_TOO_SMALL;
+				}
+				out[writeOffset] = normal;
+			}
+			writeOffset++;
+			readOffset += escapeLen;
+		}
+	}
+
+	if (out)
+	{
+		if (outSize == 0)
+		{
+			return CFLIST_TOO_SMALL;
+		}
+		out[writeOffset] = 0;
+	}
+	if (outLen)
+	{
+		*outLen = writeOffset;
+	}
+	return CFLIST_OK;
+}
+
+bool cFListFieldEqualsString(const CFListField* field, const char* str, size_t len)
+{
+	if (field->Type != CFLIST_TYPE_STRING)
+	{
+		return false;
+	}
+
+	// Walk both, expanding escapes in the field as they come
+	size_t readOffset = 0;
+	size_t strOffset = 0;
+	while (readOffset < field->ValueLen)
+	{
+		char c = field->Value[readOffset];
+		size_t consumed = 1;
+		if (c == NORMAL_AMPERSAND && !(c = getEscapedChar(field->Value + readOffset, field->ValueLen - readOffset, &consumed)))
+		{
+			return false;
+		}
+		if (strOffset == len || str[strOffset] != c)
+		{
+			return false;
+		}
+		readOffset += consumed;
+		strOffset++;
+	}
+	return strOffset == len;
+}
+
+// Returns the value of a hex digit, or -1
+static int getHexNibble(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if (c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	return -1;
+}
+
+CFListStatus cFListFieldToHexBinary(const CFListField* field, uint8_t* out, size_t outSize, size_t* outLen)
+{
+	if (field->Type != CFLIST_TYPE_HEXBINDATA)
+	{
+		return CFLIST_BAD_TYPE;
+	}
+	if (field->ValueLen % 2 != 0)
+	{
+		return CFLIST_BAD_VALUE;
+	}
+
+	size_t byteCount = field->ValueLen / 2;
+	if (out && byteCount > outSize)
+	{
+		return CFLIST_TOO_SMALL;
+	}
+
+	size_t i = 0;
+	for (; i < byteCount; i++)
+	{
+		int high = getHexNibble(field->Value[i * 2]);
+		int low = getHexNibble(field->Value[(i * 2) + 1]);
+		if ((high | low) < 0)
+		{
+			return CFLIST_BAD_VALUE;
+		}
+		if (out)
+		{
+			out[i] = (uint8_t)((high << 4) | low);
+		}
+	}
+
+	if (outLen)
+	{
+		*outLen = byteCount;
+	}
+	return CFLIST_OK;
+}
+
+/*
+*
+* Find and convert
+*
+*/
+
+CFListStatus cFListGetUnsigned(const uint8_t* doc, size_t docLen, const char* tokenId, uint64_t* value)
+{
+	CFListField field;
+	CFListStatus status = cFListFindField(doc, docLen, tokenId, &field);
+	return status == CFLIST_OK ? cFListFieldToUnsigned(&field, value) : status;
+}
+
+CFListStatus cFListGetSigned(const uint8_t* doc, size_t docLen, const char* tokenId, int64_t* value)
+{
+	CFListField field;
+	CFListStatus status = cFListFindField(doc, docLen, tokenId, &field);
+	return status == CFLIST_OK ? cFListFieldToSigned(&field, value) : status;
+}
+
+CFListStatus cFListGetBoolean(const uint8_t* doc, size_t docLen, const char* tokenId, bool* value)
+{
+	CFListField field;
+	CFListStatus status = cFListFindField(doc, docLen, tokenId, &field);
+	return status == CFLIST_OK ? cFListFieldToBoolean(&field, value) : status;
+}
+
+CFListStatus cFListGetString(const uint8_t* doc, size_t docLen, const char* tokenId, char* out, size_t outSize, size_t* outLen)
+{
+	CFListField field;
+	CFListStatus status = cFListFindField(doc, docLen, tokenId, &field);
+	return status == CFLIST_OK ? cFListFieldToString(&field, out, outSize, outLen) : status;
+}
+
+CFListStatus cFListGetHexBinary(const uint8_t* doc, size_t docLen, const char* tokenId, uint8_t* out, size_t outSize, size_t* outLen)
+{
+	CFListField field;
+	CFListStatus status = cFListFindField(doc, docLen, tokenId, &field);
+	return status == CFLIST_OK ? cFListFieldToHexBinary(&field, out, outSize, outLen) : status;
+}
@@ -0,0 +1,205 @@
+// CFListReader.h - Bounds checked reader for cFList documents (safe for untrusted input)
+// MIT License - 2018 - Charles Machalow
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "StaticSDDS.h"
+
+/// <summary>
+/// Result of a reader call. Nothing in the reader asserts; every problem comes back as one of these.
+/// </summary>
+typedef enum CFListStatus {
+	CFLIST_OK = 0,
+	CFLIST_END,        // No more fields (</cFList> was reached)
+	CFLIST_NOT_FOUND,  // No field has the requested token
+	CFLIST_TRUNCATED,  // The document ended in the middle of something
+	CFLIST_MALFORMED,  // The document doesn't follow the cFList layout
+	CFLIST_BAD_TYPE,   // The field isn't of the requested type
+	CFLIST_BAD_VALUE,  // The value can't be converted (bad number, escape, boolean or hex)
+	CFLIST_TOO_SMALL   // The output buffer is too small for the value
+} CFListStatus;
+
+/// <summary>
+/// Known field types
+/// </summary>
+typedef enum CFListType {
+	CFLIST_TYPE_UNKNOWN = 0,
+	CFLIST_TYPE_INTEGER,
+	CFLIST_TYPE_BOOLEAN,
+	CFLIST_TYPE_STRING,
+	CFLIST_TYPE_HEXBINDATA
+} CFListType;
+
+/// <summary>
+/// A field as it appears in the document. All pointers point into the document (nothing is copied).
+/// Value is the raw text (still xml escaped or hex encoded).
+/// </summary>
+typedef struct CFListField {
+	CFListType Type;
+	const char* TypeStr;
+	size_t TypeLen;
+	const char* Token;
+	size_t TokenLen;
+	const char* Value;
+	size_t ValueLen;
+} CFListField;
+
+/// <summary>
+/// One token wanted by cFListProject() and the field found for it
+/// </summary>
+typedef struct CFListSlot {
+	const char* TokenId; // Set by the caller
+	size_t TokenIdLen;   // Filled in by cFListProject()
+	bool Found;
+	CFListField Field;   // Valid when Found
+} CFListSlot;
+
+// Room for String and HexBinaryData values in a CFListRecord
+#define CFLIST_RECORD_STRING_SIZE 64
+#define CFLIST_RECORD_HEX_SIZE    64
+
+/// <summary>
+/// Index of each CFLIST_TOKENS entry
+/// </summary>
+typedef enum CFListTokenSlot {
+#define CFLIST_TOKEN_SLOT(name, member, tokenChar, type) CFLIST_SLOT_##name,
+	CFLIST_TOKENS(CFLIST_TOKEN_SLOT)
+#undef CFLIST_TOKEN_SLOT
+	CFLIST_SLOT_COUNT
+} CFListTokenSlot;
+
+// CFListRecord member for each field type
+#define CFLIST_RECORD_MEMBER_INTEGER(member)    int64_t member;
+#define CFLIST_RECORD_MEMBER_BOOLEAN(member)    bool member;
+#define CFLIST_RECORD_MEMBER_STRING(member)     char member[CFLIST_RECORD_STRING_SIZE];
+#define CFLIST_RECORD_MEMBER_HEXBINDATA(member) uint8_t member[CFLIST_RECORD_HEX_SIZE]; size_t member##Len;
+
+/// <summary>
+/// Every known token (CFLIST_TOKENS) decoded into a typed member. Strings are unescaped and null terminated.
+/// </summary>
+typedef struct CFListRecord {
+	uint32_t Present; // Bit (1 << CFLIST_SLOT_*) set for each member found in the document
+#define CFLIST_RECORD_MEMBER(name, member, tokenChar, type) CFLIST_RECORD_MEMBER_##type(member)
+	CFLIST_TOKENS(CFLIST_RECORD_MEMBER)
+#undef CFLIST_RECORD_MEMBER
+} CFListRecord;
+
+/// <summary>
+/// Walks the fields of a document in a single pass
+/// </summary>
+typedef struct CFListReader {
+	const char* Doc;
+	size_t DocLen;
+	size_t Offset;
+} CFListReader;
+
+/// <summary>
+/// Returns a short description of the status
+/// </summary>
+const char* cFListStatusToString(CFListStatus status);
+
+/// <summary>
+/// Starts reading a document of docLen bytes. Checks for the opening tag.
+/// </summary>
+CFListStatus cFListReaderInit(CFListReader* reader, const uint8_t* doc, size_t docLen);
+
+/// <summary>
+/// Reads the next field. Returns CFLIST_END once the closing tag is reached.
+/// </summary>
+CFListStatus cFListNextField(CFListReader* reader, CFListField* field);
+
+/// <summary>
+/// Returns true if the field's token is the given token
+/// </summary>
+bool cFListFieldHasToken(const CFListField* field, const char* tokenId, size_t tokenIdLen);
+
+/// <summary>
+/// Checks the whole document, including that every Integer, Boolean, String and HexBinaryData value converts.
+/// </summary>
+CFListStatus cFListValidate(const uint8_t* doc, size_t docLen);
+
+/// <summary>
+/// Finds the first field with the given token
+/// </summary>
+CFListStatus cFListFindField(const uint8_t* doc, size_t docLen, const char* tokenId, CFListField* field);
+
+/// <summary>
+/// Finds the fields for several tokens in one pass over the document, stopping as soon as every slot is filled.
+/// Each slot gets the first field with its token. Returns CFLIST_NOT_FOUND if the document ended with some slots
+/// still empty (the others are filled in). foundCount (optional) gets the number of filled slots.
+/// </summary>
+CFListStatus cFListProject(const uint8_t* doc, size_t docLen, CFListSlot* slots, size_t slotCount, size_t* foundCount);
+
+/// <summary>
+/// Decodes the known tokens into record in one pass, finding each field's member with a table lookup on its token
+/// instead of string compares. Unknown tokens are skipped and the first field wins for repeated ones. Stops as soon
+/// as every member is filled. Returns CFLIST_NOT_FOUND if the document ended with members missing (see Present),
+/// or the conversion error of a field that doesn't fit its member (like CFLIST_BAD_TYPE or CFLIST_TOO_SMALL).
+/// </summary>
+CFListStatus cFListDecodeRecord(const uint8_t* doc, size_t docLen, CFListRecord* record);
+
+/// <summary>
+/// Returns true if every CFLIST_TOKENS entry's token char is the one in its TOKEN_NAME literal. C can't index a string
+/// literal in a constant expression, so this runs once at startup (the demos and fuzz harness call it).
+/// </summary>
+bool cFListCheckTokenTable(void);
+
+/// <summary>
+/// Converts an Integer field to a uint64_t
+/// </summary>
+CFListStatus cFListFieldToUnsigned(const CFListField* field, uint64_t* value);
+
+/// <summary>
+/// Converts an Integer field to an int64_t
+/// </summary>
+CFListStatus cFListFieldToSigned(const CFListField* field, int64_t* value);
+
+/// <summary>
+/// Converts a Boolean field (True/False/true/false) to a bool
+/// </summary>
+CFListStatus cFListFieldToBoolean(const CFListField* field, bool* value);
+
+/// <summary>
+/// Unescapes a String field into out and null terminates it. out may be NULL to only validate.
+/// outLen (optional) gets the length without the null char.
+/// </summary>
+CFListStatus cFListFieldToString(const CFListField* field, char* out, size_t outSize, size_t* outLen);
+
+/// <summary>
+/// Returns true if a String field unescapes to exactly the len characters of str (without copying it anywhere)
+/// </summary>
+bool cFListFieldEqualsString(const CFListField* field, const char* str, size_t len);
+
+/// <summary>
+/// Decodes a HexBinaryData field into out. out may be NULL to only validate.
+/// outLen (optional) gets the number of bytes.
+/// </summary>
+CFListStatus cFListFieldToHexBinary(const CFListField* field, uint8_t* out, size_t outSize, size_t* outLen);
+
+/// <summary>
+/// Finds the field with the given token and converts it to a uint64_t
+/// </summary>
+CFListStatus cFListGetUnsigned(const uint8_t* doc, size_t docLen, const char* tokenId, uint64_t* value);
+
+/// <summary>
+/// Finds the field with the given token and converts it to an int64_t
+/// </summary>
+CFListStatus cFListGetSigned(const uint8_t* doc, size_t docLen, const char* tokenId, int64_t* value);
+
+/// <summary>
+/// Finds the field with the given token and converts it to a bool
+/// </summary>
+CFListStatus cFListGetBoolean(const uint8_t* doc, size_t docLen, const char* tokenId, bool* value);
+
+/// <summary>
+/// Finds the field with the given token and unescapes it into out
+/// </summary>
+CFListStatus cFListGetString(const uint8_t* doc, size_t docLen, const char* tokenId, char* out, size_t outSize, size_t* outLen);
+
+/// <summary>
+/// Finds the field with the given token and decodes it into out
+/// </summary>
+CFListStatus cFListGetHexBinary(const uint8_t* doc, size_t docLen, const char* tokenId, uint8_t* out, size_t outSize, size_t* outLen);
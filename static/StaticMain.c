@@ -0,0 +1,183 @@
+// StaticMain.c - Example usage of the static Self-Describing-Data-Stream
+// MIT License - 2018 - Charles Machalow
+
+#define _CRT_SECURE_NO_WARNINGS 1
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "CFListDelta.h"
+#include "CFListReader.h"
+#include "StaticSDDS.h"
+
+int main()
+{
+	uint8_t tbuf[4096] = { 0 };
+
+	char* testStr = "Test";
+
+	START_CFLIST(tbuf, sizeof(tbuf));
+	ADD_CFLIST_STRING_FIELD(TOKEN_SERIAL, testStr);
+	ADD_CFLIST_SIGNED_FIELD(TOKEN_SIZE, -12345);
+	ADD_CFLIST_BOOL_FIELD(TOKEN_SUPPORTS_POWER, true);
+	END_CFLIST();
+
+	printf("%s\n", (char*)tbuf);
+
+	//getFieldByTokenAndPutInGpBuf(tbuf, sizeof(tbuf), "B");
+	getFieldStringValueAndPutInGpBuf(tbuf, sizeof(tbuf), "C");
+	getFieldTypePutInGpBuf(tbuf, sizeof(tbuf), "C");
+	getFieldStringValueAndPutInGpBuf(tbuf, sizeof(tbuf), "A");
+	getFieldTypePutInGpBuf(tbuf, sizeof(tbuf), "A");
+
+	int64_t i = getIntegerValueFromId(tbuf, sizeof(tbuf), "A");
+	bool b = getBooleanValueFromId(tbuf, sizeof(tbuf), "C");
+	printf("A: %" PRIi64 ", C: %s\n", i, b ? "true" : "false");
+
+	// The same values through the bounds checked reader
+	size_t docLen = strlen((char*)tbuf);
+	char serial[16];
+	int64_t size = 0;
+	bool supportsPower = false;
+	CFListStatus status = cFListValidate(tbuf, docLen);
+	assert(status == CFLIST_OK);
+	status = cFListGetSigned(tbuf, docLen, TOKEN_SIZE, &size);
+	assert(status == CFLIST_OK && size == i);
+	status = cFListGetBoolean(tbuf, docLen, TOKEN_SUPPORTS_POWER, &supportsPower);
+	assert(status == CFLIST_OK && supportsPower == b);
+	status = cFListGetString(tbuf, docLen, TOKEN_SERIAL, serial, sizeof(serial), NULL);
+	assert(status == CFLIST_OK && strcmp(serial, testStr) == 0);
+	printf("Truncated document: %s\n", cFListStatusToString(cFListValidate(tbuf, docLen - 1)));
+
+	// Or all of them in one pass
+	CFListSlot slots[] = { { TOKEN_SUPPORTS_POWER }, { TOKEN_SIZE }, { TOKEN_SERIAL } };
+	size_t found = 0;
+	status = cFListProject(tbuf, docLen, slots, sizeof(slots) / sizeof(slots[0]), &found);
+	assert(status == CFLIST_OK && found == 3);
+	status = cFListFieldToSigned(&slots[1].Field, &size);
+	assert(status == CFLIST_OK && size == i);
+	slots[0].TokenId = "D";
+	status = cFListProject(tbuf, docLen, slots, sizeof(slots) / sizeof(slots[0]), &found);
+	assert(status == CFLIST_NOT_FOUND && found == 2 && !slots[0].Found && slots[2].Found);
+	(void)found;
+
+	// Or straight into a struct, dispatching on the token (the table has to agree with the TOKEN_* literals)
+	assert(cFListCheckTokenTable());
+	CFListRecord record;
+	status = cFListDecodeRecord(tbuf, docLen, &record);
+	assert(status == CFLIST_OK && record.Present == (1u << CFLIST_SLOT_COUNT) - 1);
+	assert(record.Size == i && record.SupportsPower == b && strcmp(record.Serial, testStr) == 0);
+	(void)status;
+
+	// Only the changed field goes into the delta
+	uint8_t nextBuf[4096] = { 0 };
+	size_t nextLen = 0;
+	START_CFLIST(nextBuf, sizeof(nextBuf));
+	ADD_CFLIST_STRING_FIELD(TOKEN_SERIAL, testStr);
+	ADD_CFLIST_SIGNED_FIELD(TOKEN_SIZE, -12346);
+	ADD_CFLIST_BOOL_FIELD(TOKEN_SUPPORTS_POWER, true);
+	END_CFLIST_GET_SIZE(&nextLen);
+
+	uint8_t delta[256];
+	size_t deltaLen = 0;
+	uint8_t patched[4096];
+	size_t patchedLen = 0;
+	status = cFListMakeDelta(tbuf, docLen, nextBuf, nextLen, delta, sizeof(delta), &deltaLen);
+	assert(status == CFLIST_OK);
+	status = cFListApplyDelta(tbuf, docLen, delta, deltaLen, patched, sizeof(patched), &patchedLen);
+	assert(status == CFLIST_OK && patchedLen == nextLen && memcmp(patched, nextBuf, nextLen) == 0);
+	printf("Delta: %zu bytes for a %zu byte document\n", deltaLen, nextLen);
+
+	// A prebuilt template gives the same bytes as the ADD_CFLIST_* macros (which use cached templates themselves)
+	CFListFieldTemplate sizeTemplate;
+	bool built = cFListBuildFieldTemplate(&sizeTemplate, INTEGER_S, TOKEN_SIZE);
+	assert(built);
+	(void)built;
+	uint8_t templated[64];
+	size_t templatedLen = 0;
+	addTemplatedFieldToBuffer(templated, sizeof(templated), &sizeTemplate, "-12346", strlen("-12346"), &templatedLen);
+	assert(templatedLen == strlen("<field type=\"Integer\" token=\"A\">-12346</field>"));
+	assert(memcmp(templated, "<field type=\"Integer\" token=\"A\">-12346</field>", templatedLen) == 0);
+
+	// A 1 MB firmware image is 2 MB of hex, far more than the gpBuf. It is encoded straight into the document, here 4 KB at a time.
+	size_t imageSize = 1024 * 1024;
+	size_t largeSize = (imageSize * 2) + 256;
+	uint8_t* image = (uint8_t*)malloc(imageSize);
+	uint8_t* decoded = (uint8_t*)malloc(imageSize);
+	uint8_t* large = (uint8_t*)malloc(largeSize);
+	uint8_t* scratch = (uint8_t*)malloc(largeSize);
+	if (!image || !decoded || !large || !scratch)
+	{
+		return EXIT_FAILURE;
+	}
+	for (size_t j = 0; j < imageSize; j++)
+	{
+		image[j] = (uint8_t)(j * 31);
+	}
+
+	size_t largeLen = 0;
+	START_CFLIST(large, largeSize);
+	START_CFLIST_FIELD(HEXBINDATA_S, TOKEN_SERIAL);
+	for (size_t piece = 0; piece < imageSize; piece += 4096)
+	{
+		ADD_CFLIST_HEXBINDATA_PIECE(image + piece, 4096);
+	}
+	END_CFLIST_FIELD();
+	ADD_CFLIST_BOOL_FIELD(TOKEN_SUPPORTS_POWER, true);
+	END_CFLIST_GET_SIZE(&largeLen);
+
+	size_t decodedLen = 0;
+	status = cFListGetHexBinary(large, largeLen, TOKEN_SERIAL, decoded, imageSize, &decodedLen);
+	assert(status == CFLIST_OK && decodedLen == imageSize && memcmp(decoded, image, imageSize) == 0);
+
+	// The gpBuf functions work on it too once they are given enough scratch
+	setGpBuffer(scratch, largeSize);
+	bool largeFound = getFieldHexBinValueAndPutInGpBuf(large, largeLen, TOKEN_SERIAL);
+	assert(largeFound && memcmp(scratch, image, imageSize) == 0);
+	largeFound = getBooleanValueFromId(large, largeLen, TOKEN_SUPPORTS_POWER);
+	assert(largeFound);
+	(void)largeFound;
+	setGpBuffer(NULL, 0);
+
+	// Long strings are escaped straight into the document as well
+	for (size_t j = 0; j < imageSize - 1; j++)
+	{
+		image[j] = (j % 100 == 0) ? '<' : 'x';
+	}
+	image[imageSize - 1] = 0;
+	START_CFLIST(large, largeSize);
+	ADD_CFLIST_STRING_FIELD(TOKEN_SERIAL, (char*)image);
+	END_CFLIST_GET_SIZE(&largeLen);
+	status = cFListGetString(large, largeLen, TOKEN_SERIAL, (char*)decoded, imageSize, &decodedLen);
+	assert(status == CFLIST_OK && decodedLen == imageSize - 1 && strcmp((char*)decoded, (char*)image) == 0);
+	printf("Large documents: %zu byte image and %zu byte string round tripped\n", imageSize, decodedLen);
+
+	// A document that doesn't fit stops at the end of its buffer and comes back with a size of 0
+	size_t smallSize = largeLen / 2;
+	bool fits = true;
+	memset(large + smallSize, 0xA5, largeSize - smallSize);
+	START_CFLIST(large, smallSize);
+	fits = ADD_CFLIST_STRING_FIELD(TOKEN_SERIAL, (char*)image);
+	assert(!fits && CFLIST_OVERFLOWED());
+	fits = ADD_CFLIST_BOOL_FIELD(TOKEN_SUPPORTS_POWER, true) || fits;
+	END_CFLIST_GET_SIZE(&largeLen);
+	assert(!fits && largeLen == 0);
+	(void)fits;
+	for (size_t j = smallSize; j < largeSize; j++)
+	{
+		assert(large[j] == 0xA5);
+	}
+
+	free(scratch);
+	free(large);
+	free(decoded);
+	free(image);
+
+	CFListCounters counters = getCFListCounters();
+	printf("gpBuffer acquisitions (need CSDDS_INSTRUMENTATION): %" PRIu64 ", field templates: %" PRIu64 " built, %" PRIu64 " reused\n",
+		counters.GpBufferAcquisitions, counters.TemplateBuilds, counters.TemplateHits);
+
+	return EXIT_SUCCESS;
+}
\ No newline at end of file
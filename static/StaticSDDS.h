@@ -2,19 +2,82 @@
 // MIT License - 2018 - Charles Machalow
 #pragma once
 
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+
+#define GP_BUFFER_SIZE 8192
+
+// Same as THREAD_LOCAL in the dynamic SDDS's Memory.h, which this doesn't depend on
+#ifndef THREAD_LOCAL
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+#endif // THREAD_LOCAL
 
 /// <summary>
-/// Make a general purpose buffer
+/// The general purpose buffer (defined in StaticSSDS.c). Starts as GP_BUFFER_SIZE built in bytes; see setGpBuffer().
 /// </summary>
-uint8_t ___gpBuffer[8192] = { 0 };
-bool ___gpBufferInUse = false;
+extern uint8_t* ___gpBuffer;
+extern size_t ___gpBufferSize;
+extern bool ___gpBufferInUse;
+
+// Counts of hot path events (on the calling thread). Always zero unless built with CSDDS_INSTRUMENTATION.
+typedef struct CFListCounters {
+	uint64_t GpBufferAcquisitions; // Calls to __getGpBuffer
+	uint64_t TemplateHits;         // Fields encoded with a cached header template
+	uint64_t TemplateBuilds;       // Header templates built (cache misses)
+} CFListCounters;
+
+#ifdef CSDDS_INSTRUMENTATION
+extern THREAD_LOCAL CFListCounters ___cFListCounters;
+#define COUNT_CFLIST_EVENT(counter) (___cFListCounters.counter++)
+#else
+#define COUNT_CFLIST_EVENT(counter) ((void)0)
+#endif // CSDDS_INSTRUMENTATION
+
+/// <summary>
+/// Returns the CFListCounters for the calling thread. Encoding on other threads isn't counted here.
+/// </summary>
+CFListCounters getCFListCounters(void);
+
+/// <summary>
+/// Zeros the CFListCounters for the calling thread
+/// </summary>
+void resetCFListCounters(void);
 
 // XML Pieces
 #define START_XML "<cFList>"
 #define XML_FIELD "<field type=\"%s\" token=\"%s\">%s</field>"
 #define END_XML "</cFList>"
 
+// XML_FIELD split around the type, token and value
+#define XML_FIELD_START "<field type=\""
+#define XML_FIELD_TOKEN "\" token=\""
+#define XML_FIELD_DATA  "\">"
+#define XML_FIELD_END   "</field>"
+#define XML_PIECE_LEN(piece) (sizeof(piece) - 1)
+
+// XML Safe Conversions
+#define XML_DOUBLE_QUOTE "&quot;"
+#define XML_SINGLE_QUOTE "&apos;"
+#define XML_LESS_THAN    "&lt;"
+#define XML_GREATER_THAN "&gt;"
+#define XML_AMPERSAND    "&amp;"
+
+// Normal Things That Need XML Conversions
+#define NORMAL_DOUBLE_QUOTE '"'
+#define NORMAL_SINGLE_QUOTE '\''
+#define NORMAL_LESS_THAN    '<'
+#define NORMAL_GREATER_THAN '>'
+#define NORMAL_AMPERSAND    '&'
+
 // Field Types
 #define INTEGER_S "Integer"
 #define BOOL_S "Boolean"
@@ -28,6 +91,7 @@ bool ___gpBufferInUse = false;
 static inline uint8_t* __getGpBuffer()
 {
 	assert(!___gpBufferInUse);
+	COUNT_CFLIST_EVENT(GpBufferAcquisitions);
 	___gpBufferInUse = true;
 	return ___gpBuffer;
 }/// <summary>
@@ -46,7 +110,7 @@ static inline void __putGpBuffer()
 /// <returns>size of the gpbuf</returns>
 static inline size_t getGpBufferSize()
 {
-	return sizeof(___gpBuffer);
+	return ___gpBufferSize;
 }
 
 /// <summary>
@@ -57,94 +121,164 @@ static inline bool isGpBuf(uint8_t* buf)
 	return buf == ___gpBuffer;
 }
 
+/// <summary>
+/// Uses size bytes of caller memory as the gpBuf, so the gpBuf functions can decode documents bigger than
+/// GP_BUFFER_SIZE. NULL goes back to the built in buffer. The gpBuf must not be in use.
+/// </summary>
+void setGpBuffer(uint8_t* buf, size_t size);
+
 // General Purpose Buffer Macros
 #define GET_GP_BUF() __getGpBuffer(); {
 #define PUT_GP_BUF() __putGpBuffer(); }
 
+// Header templates
+#define CFLIST_TEMPLATE_MAX_PREFIX 64 // Longest prebuilt "<field type=\"X\" token=\"Y\">" (longer tokens are encoded piece by piece)
+#define CFLIST_TEMPLATE_CACHE_SIZE 64 // Slots in each thread's template cache used by the add*FieldToBuffer functions (a power of two)
+
+/// <summary>
+/// The exact "<field type=\"X\" token=\"Y\">" bytes for one (type, token) pair, so a field is a memcpy of the prefix,
+/// the value and XML_FIELD_END. The add*FieldToBuffer functions keep a cache of these keyed by the type and token pointers
+/// (token literals like TOKEN_SIZE hit every time). The cache is THREAD_LOCAL, so each encoding thread builds its own
+/// and never waits on or races with another. Build one directly to skip even the cache lookup.
+/// </summary>
+typedef struct CFListFieldTemplate {
+	const char* Type;    // What the template was built for
+	const char* TokenId;
+	uint8_t TokenOffset; // Where the token is in Prefix
+	uint8_t TokenLen;
+	uint8_t PrefixLen;
+	char Prefix[CFLIST_TEMPLATE_MAX_PREFIX];
+} CFListFieldTemplate;
+
+// The add*ToBuffer functions never write past bufSize (and always leave a byte for a null char). When something doesn't fit
+// they return false and set *offset to CFLIST_OVERFLOW, after which every add with that offset does nothing and returns false,
+// so a whole document can be written and checked once at the end.
+#define CFLIST_OVERFLOW SIZE_MAX
+
+/// <summary>
+/// Builds the template for a type (like INTEGER_S) and token. Returns false if they are too long for a template.
+/// </summary>
+bool cFListBuildFieldTemplate(CFListFieldTemplate* fieldTemplate, const char* type, const char* tokenId);
+
+/// <summary>
+/// Adds a field from a template and an already xml safe value of valueLen characters
+/// </summary>
+bool addTemplatedFieldToBuffer(uint8_t* buf, size_t bufSize, const CFListFieldTemplate* fieldTemplate, const char* value, size_t valueLen, size_t* offset);
+
 /// <summary>
 /// convert a given string into an xml-safe string and place it in gpBuffer
 /// </summary>
-static void stringToXmlSafeInGpBuffer(char* data);
+void stringToXmlSafeInGpBuffer(char* data);
 
 /// <summary>
 /// Convert a given xml safe string to a normal string and place it in gpBuffer
 /// </summary>
-static void xmlSafeToStringInGpBuffer(char* data, size_t len);
+void xmlSafeToStringInGpBuffer(char* data, size_t len);
 
 /// <summary>
 /// Add a string field to an xml buffer
 /// </summary>
-static void addStringFieldToBuffer(uint8_t* buf, size_t bufSize, char* data, char* tokenId, size_t* offset);
+bool addStringFieldToBuffer(uint8_t* buf, size_t bufSize, char* data, char* tokenId, size_t* offset);
 
 /// <summary>
 /// Add an unsigned numeric field to an xml buffer
 /// </summary>
-static void addUnsignedFieldToBuffer(uint8_t* buf, size_t bufSize, uint64_t data, char* tokenId, size_t* offset);
+bool addUnsignedFieldToBuffer(uint8_t* buf, size_t bufSize, uint64_t data, char* tokenId, size_t* offset);
+
+/// <summary>
+/// Add a signed numeric field to an xml buffer
+/// </summary>
+bool addSignedFieldToBuffer(uint8_t* buf, size_t bufSize, int64_t data, char* tokenId, size_t* offset);
 
 /// <summary>
 /// Add a bool field to an xml buffer
 /// </summary>
-static void addBoolFieldToBuffer(uint8_t* buf, size_t bufSize, bool data, char* tokenId, size_t* offset);
+bool addBoolFieldToBuffer(uint8_t* buf, size_t bufSize, bool data, char* tokenId, size_t* offset);
 
 /// <summary>
 /// Adds hex binary data field to an xml buffer
 /// </summary>
-static void addHexBinaryDataFieldToBuffer(uint8_t* buf, size_t bufSize, uint8_t* data, size_t dataSize, char* tokenId, size_t* offset);
+bool addHexBinaryDataFieldToBuffer(uint8_t* buf, size_t bufSize, uint8_t* data, size_t dataSize, char* tokenId, size_t* offset);
 
 /// <summary>
 /// Adds a string to a given buffer via memcpy
 /// </summary>
-static void addStringToBuffer(uint8_t* buf, size_t bufSize, size_t* offset, char* str, size_t len);
+bool addStringToBuffer(uint8_t* buf, size_t bufSize, size_t* offset, char* str, size_t len);
+
+/// <summary>
+/// Adds "<field type=\"X\" token=\"Y\">" to an xml buffer. Follow it with the value (in as many pieces as needed)
+/// and addFieldEndToBuffer(). This is how values too big to have in memory at once are added.
+/// </summary>
+bool addFieldStartToBuffer(uint8_t* buf, size_t bufSize, const char* type, char* tokenId, size_t* offset);
+
+/// <summary>
+/// Adds len characters of a string to an xml buffer, escaping them on the way
+/// </summary>
+bool addXmlSafeStringToBuffer(uint8_t* buf, size_t bufSize, const char* str, size_t len, size_t* offset);
+
+/// <summary>
+/// Adds dataSize bytes to an xml buffer as hex
+/// </summary>
+bool addHexBinaryDataToBuffer(uint8_t* buf, size_t bufSize, const uint8_t* data, size_t dataSize, size_t* offset);
+
+/// <summary>
+/// Adds the "</field>" that closes addFieldStartToBuffer()
+/// </summary>
+bool addFieldEndToBuffer(uint8_t* buf, size_t bufSize, size_t* offset);
 
 /// <summary>
 /// Gets a string field by token id from the given xml
 /// </summary>
-static bool getFieldByTokenAndPutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId);
+bool getFieldByTokenAndPutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId);
 
 /// <summary>
 /// Gets the field value and puts it in GpBuf
 /// </summary>
-static bool getFieldStringValueAndPutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId);
+bool getFieldStringValueAndPutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId);
 
 /// <summary>
 /// Gets the hex bin data field value and puts it in GpBuf
 /// </summary>
-static bool getFieldHexBinValueAndPutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId);
+bool getFieldHexBinValueAndPutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId);
 
 /// <summary>
 /// Counts the number of times a char appears in a string
 /// </summary>
-static size_t countACharInString(char* str, size_t len, char c);
+size_t countACharInString(char* str, size_t len, char c);
 
 /// <summary>
 /// Looks for a string in a string and returns the location in the string if found. Returns -1 if not found.
 /// Returns the location just after strToFind
 /// </summary>
-static size_t findAfterInStr(char* strToSearchIn, size_t strToSearchInLen, char* strToFind);
+size_t findAfterInStr(char* strToSearchIn, size_t strToSearchInLen, char* strToFind);
 
 /// <summary>
 /// Find the text between left and right in strToSearch. Place the result in gpBuf. Returns true on success.
 /// </summary>
-static bool findTextBetweenStrsInGpBufAndPutInGpBuf(char* left, char* right);
+bool findTextBetweenStrsInGpBufAndPutInGpBuf(char* left, char* right);
 
 /// <summary>
 /// Gets the field type and puts it in gpBug. Returns true on success
 /// </summary>
-static bool getFieldTypePutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId);
+bool getFieldTypePutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId);
 
 /// <summary>
 /// Returns a uint64_t value from the given id.
 /// </summary>
-static uint64_t getIntegerValueFromId(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId);
+uint64_t getIntegerValueFromId(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId);
 
 /// <summary>
 /// Returns a boolean value from the given id.
 /// </summary>
-static bool getBooleanValueFromId(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId);
+bool getBooleanValueFromId(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId);
 
-// Macros for creating a CFList
+// Macros for creating a CFList. __offset is CFLIST_OVERFLOW once the document doesn't fit in bufSize; CFLIST_OVERFLOWED()
+// checks for that along the way and END_CFLIST_GET_SIZE() gives a size of 0 for it. Each ADD_ and _PIECE macro gives false
+// if what it adds doesn't fit.
 #define START_CFLIST(buf, bufSize) { uint8_t* __buf = buf; size_t __bufSize = bufSize; size_t __offset = 0; addStringToBuffer(buf, bufSize, &__offset, START_XML, strlen(START_XML));
+#define CFLIST_OVERFLOWED() (__offset == CFLIST_OVERFLOW)
 #define END_CFLIST() addStringToBuffer(__buf, __bufSize, &__offset, END_XML, strlen(END_XML)); }
+#define END_CFLIST_GET_SIZE(pSize) addStringToBuffer(__buf, __bufSize, &__offset, END_XML, strlen(END_XML)); *(pSize) = CFLIST_OVERFLOWED() ? 0 : __offset; }
 
 // Macros for adding fields to a CFList
 #define ADD_CFLIST_UNSIGNED_FIELD(tokenId, data) addUnsignedFieldToBuffer(__buf, __bufSize, data, tokenId, &__offset)
@@ -153,7 +287,22 @@ static bool getBooleanValueFromId(uint8_t* xmlBuf, size_t xmlBufSize, char* toke
 #define ADD_CFLIST_STRING_FIELD(tokenId, data) addStringFieldToBuffer(__buf, __bufSize, data, tokenId, &__offset)
 #define ADD_CFLIST_HEXBINDATA_FIELD(tokenId, data, dataSize) addHexBinaryDataFieldToBuffer(__buf, __bufSize, data, dataSize, tokenId, &__offset)
 
+// Macros for adding a field a piece at a time (like a firmware image read in chunks)
+#define START_CFLIST_FIELD(type, tokenId) addFieldStartToBuffer(__buf, __bufSize, type, tokenId, &__offset)
+#define ADD_CFLIST_STRING_PIECE(data, len) addXmlSafeStringToBuffer(__buf, __bufSize, data, len, &__offset)
+#define ADD_CFLIST_HEXBINDATA_PIECE(data, dataSize) addHexBinaryDataToBuffer(__buf, __bufSize, data, dataSize, &__offset)
+#define END_CFLIST_FIELD() addFieldEndToBuffer(__buf, __bufSize, &__offset)
+
 // Current Tokens
 #define TOKEN_SIZE				  "A" // Size
 #define TOKEN_SERIAL			  "B" // Serial
 #define TOKEN_SUPPORTS_POWER	  "C" // Supports Power
+
+// The tokens above as a table for cFListDecodeRecord(): X(NAME, Member, token char, field type). The name ties an entry to
+// its TOKEN_NAME (which has to be one character, checked at compile time, and match the token char, checked by
+// cFListCheckTokenTable()) and the type is one of INTEGER, BOOLEAN, STRING or HEXBINDATA. Add a line here with each
+// new token.
+#define CFLIST_TOKENS(X) \
+	X(SIZE,           Size,          'A', INTEGER) \
+	X(SERIAL,         Serial,        'B', STRING) \
+	X(SUPPORTS_POWER, SupportsPower, 'C', BOOLEAN)
@@ -13,60 +13,81 @@
 
 #include "StaticSDDS.h"
 
-// XML Safe Conversions
-#define XML_DOUBLE_QUOTE "&quot;"
-#define XML_SINGLE_QUOTE "&apos;"
-#define XML_LESS_THAN    "&lt;"
-#define XML_GREATER_THAN "&gt;"
-#define XML_AMPERSAND    "&amp;"
-
-// Normal Things That Need XML Conversions
-#define NORMAL_DOUBLE_QUOTE '"'
-#define NORMAL_SINGLE_QUOTE '\''
-#define NORMAL_LESS_THAN    '<'
-#define NORMAL_GREATER_THAN '>'
-#define NORMAL_AMPERSAND    '&'
-
-
-static void stringToXmlSafeInGpBuffer(char* data)
+// The general purpose buffer
+static uint8_t ___builtInGpBuffer[GP_BUFFER_SIZE] = { 0 };
+uint8_t* ___gpBuffer = ___builtInGpBuffer;
+size_t ___gpBufferSize = GP_BUFFER_SIZE;
+bool ___gpBufferInUse = false;
+
+// Header templates used by the add*FieldToBuffer functions (direct mapped, a miss just rebuilds the slot).
+// One cache per thread, so threads can encode at the same time.
+static THREAD_LOCAL CFListFieldTemplate ___fieldTemplates[CFLIST_TEMPLATE_CACHE_SIZE];
+
+#ifdef CSDDS_INSTRUMENTATION
+THREAD_LOCAL CFListCounters ___cFListCounters = { 0 };
+#endif // CSDDS_INSTRUMENTATION
+
+CFListCounters getCFListCounters(void)
 {
-	size_t i = 0;
-	size_t gpBufOffset = 0;
-	uint8_t* gpBuf = GET_GP_BUF();
+#ifdef CSDDS_INSTRUMENTATION
+	return ___cFListCounters;
+#else
+	CFListCounters counters = { 0 };
+	return counters;
+#endif // CSDDS_INSTRUMENTATION
+}
+
+void resetCFListCounters(void)
+{
+#ifdef CSDDS_INSTRUMENTATION
+	memset(&___cFListCounters, 0, sizeof(___cFListCounters));
+#endif // CSDDS_INSTRUMENTATION
+}
 
-	for (; i < strlen(data); i++)
+void setGpBuffer(uint8_t* buf, size_t size)
+{
+	assert(!___gpBufferInUse);
+	if (buf)
 	{
-		char* sToAdd;
-		size_t len = 0;
-		switch (data[i])
-		{
-		case NORMAL_DOUBLE_QUOTE:
-			sToAdd = XML_DOUBLE_QUOTE;
-			break;
-		case NORMAL_SINGLE_QUOTE:
-			sToAdd = XML_SINGLE_QUOTE;
-			break;
-		case NORMAL_LESS_THAN:
-			sToAdd = XML_LESS_THAN;
-			break;
-		case NORMAL_GREATER_THAN:
-			sToAdd = XML_GREATER_THAN;
-			break;
-		case NORMAL_AMPERSAND:
-			sToAdd = XML_AMPERSAND;
-			break;
-		default:
-			sToAdd = &data[i];
-			len = 1;
-			break;
-		}
+		___gpBuffer = buf;
+		___gpBufferSize = size;
+	}
+	else
+	{
+		___gpBuffer = ___builtInGpBuffer;
+		___gpBufferSize = sizeof(___builtInGpBuffer);
+	}
+}
 
-		if (len == 0)
-		{
-			len = strlen(sToAdd);
-		}
+// Returns the xml escape for c, or NULL if it doesn't need one
+static inline const char* getXmlEscape(char c)
+{
+	switch (c)
+	{
+	case NORMAL_DOUBLE_QUOTE:
+		return XML_DOUBLE_QUOTE;
+	case NORMAL_SINGLE_QUOTE:
+		return XML_SINGLE_QUOTE;
+	case NORMAL_LESS_THAN:
+		return XML_LESS_THAN;
+	case NORMAL_GREATER_THAN:
+		return XML_GREATER_THAN;
+	case NORMAL_AMPERSAND:
+		return XML_AMPERSAND;
+	default:
+		return NULL;
+	}
+}
+
+void stringToXmlSafeInGpBuffer(char* data)
+{
+	size_t gpBufOffset = 0;
+	uint8_t* gpBuf = GET_GP_BUF();
 
-		addStringToBuffer(gpBuf, getGpBufferSize(), &gpBufOffset, sToAdd, len);
+	// A string too long for the gpBuf comes back empty
+	if (!addXmlSafeStringToBuffer(gpBuf, getGpBufferSize(), data, strlen(data), &gpBufOffset))
+	{
+		gpBufOffset = 0;
 	}
 	gpBuf[gpBufOffset] = 0;
 
@@ -147,12 +168,32 @@ void xmlSafeToStringInGpBuffer(char* data, size_t len)
 			addStringToBuffer(gpBuf, getGpBufferSize(), &gpBufOffset, data + idx, 1);
 		}
 	}
+
+	// A string too long for the gpBuf comes back empty
+	if (gpBufOffset == CFLIST_OVERFLOW)
+	{
+		gpBufOffset = 0;
+	}
 	gpBuf[gpBufOffset] = 0;
 
 	PUT_GP_BUF();
 }
 
-static void addStringToBuffer(uint8_t* buf, size_t bufSize, size_t* offset, char* str, size_t len)
+// Takes len bytes at *offset, leaving room for a null char like snprintf would. Returns where they go,
+// or NULL (with *offset set to CFLIST_OVERFLOW, so everything after is skipped too) if they don't fit.
+static uint8_t* reserveInBuffer(uint8_t* buf, size_t bufSize, size_t* offset, size_t len)
+{
+	if (*offset >= bufSize || len >= bufSize - *offset)
+	{
+		*offset = CFLIST_OVERFLOW;
+		return NULL;
+	}
+	uint8_t* cur = buf + *offset;
+	*offset += len;
+	return cur;
+}
+
+bool addStringToBuffer(uint8_t* buf, size_t bufSize, size_t* offset, char* str, size_t len)
 {
 	size_t ofs = 0;
 	if (offset == NULL)
@@ -160,41 +201,51 @@ static void addStringToBuffer(uint8_t* buf, size_t bufSize, size_t* offset, char
 		offset = &ofs;
 	}
 
-	assert(bufSize > *offset + len);
-	memcpy(buf + *offset, str, len);
-	*offset += len;
+	uint8_t* cur = reserveInBuffer(buf, bufSize, offset, len);
+	if (!cur)
+	{
+		return false;
+	}
+	memcpy(cur, str, len);
+	return true;
 }
 
-static bool getFieldByTokenAndPutInGpBuf(uint8_t *xmlBuf, size_t xmlBufSize, char * tokenId)
+bool getFieldByTokenAndPutInGpBuf(uint8_t *xmlBuf, size_t xmlBufSize, char * tokenId)
 {
 	bool retVal = false;
+
+	// The xml (and a null char for strtok) has to fit in the gpBuf
+	if (xmlBufSize >= getGpBufferSize())
+	{
+		return false;
+	}
+
 	uint8_t* gpBuf = GET_GP_BUF();
 
 	memcpy(gpBuf, xmlBuf, xmlBufSize);
+	gpBuf[xmlBufSize] = 0;
 
 	char* lessThan = "<";
 	size_t countOfLessThan = countACharInString(gpBuf, xmlBufSize, lessThan[0]);
 
 	char* token = strtok(gpBuf, lessThan);
 	size_t i = 0;
-	for (; i < (countOfLessThan - 1); i++)
+	for (; token && i + 1 < countOfLessThan; i++)
 	{
 		if (i % 2 != 0)
 		{
 			size_t tokenIdLoc = findAfterInStr(token, 0, "token=\"");
-			assert(tokenIdLoc != -1);
-			size_t endTokenIdQuoteLoc = findAfterInStr(token + tokenIdLoc, 0, "\"");
-			assert(endTokenIdQuoteLoc != -1);
-			endTokenIdQuoteLoc += tokenIdLoc - 1; // get before quote
-
-			if (endTokenIdQuoteLoc - tokenIdLoc == strlen(tokenId))
+			size_t endTokenIdQuoteLoc = (tokenIdLoc == -1) ? -1 : findAfterInStr(token + tokenIdLoc, 0, "\"");
+			if (endTokenIdQuoteLoc != -1)
 			{
-				if (memcmp(token + tokenIdLoc, tokenId, strlen(tokenId)) == 0)
-				{
+				endTokenIdQuoteLoc += tokenIdLoc - 1; // get before quote
 
-					size_t offset = 0;
-					addStringToBuffer(gpBuf, getGpBufferSize(), &offset, token, strlen(token));
-					gpBuf[strlen(token)] = 0;
+				if (endTokenIdQuoteLoc - tokenIdLoc == strlen(tokenId) && memcmp(token + tokenIdLoc, tokenId, strlen(tokenId)) == 0)
+				{
+					// token lives in gpBuf, so this copy overlaps
+					size_t tokenLen = strlen(token);
+					memmove(gpBuf, token, tokenLen);
+					gpBuf[tokenLen] = 0;
 					retVal = true;
 					break;
 				}
@@ -208,7 +259,7 @@ static bool getFieldByTokenAndPutInGpBuf(uint8_t *xmlBuf, size_t xmlBufSize, cha
 	return retVal;
 }
 
-static bool getFieldStringValueAndPutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId)
+bool getFieldStringValueAndPutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId)
 {
 	if (!getFieldByTokenAndPutInGpBuf(xmlBuf, xmlBufSize, tokenId))
 	{
@@ -235,11 +286,9 @@ bool getFieldHexBinValueAndPutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char*
 	uint8_t* gpBuf = GET_GP_BUF();
 	size_t readOffset = 0;
 	size_t writeOffset = 0;
-	char buf[2] = { 0 };
-	while (gpBuf[readOffset] != 0)
+	char buf[3] = { 0 }; // 2 hex chars and a null char for strtol
+	while (gpBuf[readOffset] != 0 && gpBuf[readOffset + 1] != 0) // an odd trailing char is dropped
 	{
-		assert(readOffset < getGpBufferSize());
-
 		// copy 2 bytes to buf
 		memcpy(buf, gpBuf + readOffset, 2);
 		gpBuf[writeOffset] = (uint8_t)strtol(buf, NULL, 16);
@@ -253,7 +302,7 @@ bool getFieldHexBinValueAndPutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char*
 	return true;
 }
 
-static bool getFieldTypePutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId)
+bool getFieldTypePutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId)
 {
 	if (!getFieldByTokenAndPutInGpBuf(xmlBuf, xmlBufSize, tokenId))
 	{
@@ -268,7 +317,7 @@ static bool getFieldTypePutInGpBuf(uint8_t* xmlBuf, size_t xmlBufSize, char* tok
 	return true;
 }
 
-static size_t countACharInString(char* str, size_t len, char c)
+size_t countACharInString(char* str, size_t len, char c)
 {
 	size_t count = 0;
 	if (len == 0)
@@ -288,7 +337,7 @@ static size_t countACharInString(char* str, size_t len, char c)
 	return count;
 }
 
-static size_t findAfterInStr(char* strToSearchIn, size_t strToSearchInLen, char *strToFind)
+size_t findAfterInStr(char* strToSearchIn, size_t strToSearchInLen, char *strToFind)
 {
 	if (strToSearchIn == NULL)
 	{
@@ -304,7 +353,7 @@ static size_t findAfterInStr(char* strToSearchIn, size_t strToSearchInLen, char
 	for (; i < strToSearchInLen; i++)
 	{
 		size_t remainingLen = strToSearchInLen - i;
-		if (remainingLen > strlen(strToFind))
+		if (remainingLen >= strlen(strToFind))
 		{
 			if (memcmp(strToSearchIn + i, strToFind, strlen(strToFind)) == 0)
 			{
@@ -316,125 +365,260 @@ static size_t findAfterInStr(char* strToSearchIn, size_t strToSearchInLen, char
 	return -1;
 }
 
-static bool findTextBetweenStrsInGpBufAndPutInGpBuf(char* left, char* right)
+bool findTextBetweenStrsInGpBufAndPutInGpBuf(char* left, char* right)
 {
+	bool retVal = false;
 	uint8_t* gpBuf = GET_GP_BUF();
 
 	size_t leftLoc = 0;
 	if (left)
 	{
-		leftLoc = findAfterInStr(gpBuf, getGpBufferSize(), left);
-		if (leftLoc == -1)
-		{
-			return false;
-		}
+		leftLoc = findAfterInStr(gpBuf, 0, left);
 	}
 
-	size_t rightLoc = 0;
-	if (right == NULL)
+	size_t rightLoc = -1;
+	if (leftLoc == -1)
+	{
+		// left not found
+	}
+	else if (right == NULL)
 	{
 		rightLoc = leftLoc + strlen(gpBuf + leftLoc);
 	}
 	else
 	{
-		rightLoc = leftLoc + findAfterInStr(gpBuf + leftLoc, getGpBufferSize(), right);
-		if (rightLoc == -1)
+		rightLoc = findAfterInStr(gpBuf + leftLoc, 0, right);
+		if (rightLoc != -1)
 		{
-			return false;
+			rightLoc += leftLoc - strlen(right); // get before right
 		}
-		rightLoc -= strlen(right); // get before right
 	}
 
+	if (rightLoc != -1 && rightLoc >= leftLoc)
+	{
+		size_t copySize = (rightLoc - leftLoc);
+		memmove(gpBuf, gpBuf + leftLoc, copySize);
+		gpBuf[copySize] = 0; // null terminator
+		retVal = true;
+	}
 
-	assert(rightLoc > leftLoc);
+	PUT_GP_BUF();
 
-	size_t copySize = (rightLoc - leftLoc);
-	memmove(gpBuf, gpBuf + leftLoc, copySize);
-	gpBuf[copySize] = 0; // null terminator
+	return retVal;
+}
 
-	PUT_GP_BUF();
+bool cFListBuildFieldTemplate(CFListFieldTemplate* fieldTemplate, const char* type, const char* tokenId)
+{
+	size_t typeLen = strlen(type);
+	size_t tokenLen = strlen(tokenId);
+	size_t prefixLen = XML_PIECE_LEN(XML_FIELD_START) + typeLen + XML_PIECE_LEN(XML_FIELD_TOKEN) + tokenLen + XML_PIECE_LEN(XML_FIELD_DATA);
+	if (prefixLen > sizeof(fieldTemplate->Prefix))
+	{
+		return false;
+	}
 
+	size_t offset = 0;
+	char* prefix = fieldTemplate->Prefix;
+	memcpy(prefix + offset, XML_FIELD_START, XML_PIECE_LEN(XML_FIELD_START));
+	offset += XML_PIECE_LEN(XML_FIELD_START);
+	memcpy(prefix + offset, type, typeLen);
+	offset += typeLen;
+	memcpy(prefix + offset, XML_FIELD_TOKEN, XML_PIECE_LEN(XML_FIELD_TOKEN));
+	offset += XML_PIECE_LEN(XML_FIELD_TOKEN);
+	fieldTemplate->TokenOffset = (uint8_t)offset;
+	memcpy(prefix + offset, tokenId, tokenLen);
+	offset += tokenLen;
+	memcpy(prefix + offset, XML_FIELD_DATA, XML_PIECE_LEN(XML_FIELD_DATA));
+
+	fieldTemplate->Type = type;
+	fieldTemplate->TokenId = tokenId;
+	fieldTemplate->TokenLen = (uint8_t)tokenLen;
+	fieldTemplate->PrefixLen = (uint8_t)prefixLen;
+	COUNT_CFLIST_EVENT(TemplateBuilds);
 	return true;
 }
 
-static void addStringFieldToBuffer(uint8_t* buf, size_t bufSize, char* data, char* tokenId, size_t* offset)
+bool addTemplatedFieldToBuffer(uint8_t* buf, size_t bufSize, const CFListFieldTemplate* fieldTemplate, const char* value, size_t valueLen, size_t* offset)
 {
-	stringToXmlSafeInGpBuffer(data);
-	uint8_t* gpBuf = GET_GP_BUF();
-	int numChars = snprintf(buf + *offset, bufSize - *offset, XML_FIELD, STRING_S, tokenId, gpBuf);
-	assert(numChars > 0);
-	*offset += numChars;
-	PUT_GP_BUF();
+	// One check for the whole field
+	size_t fieldLen = fieldTemplate->PrefixLen + XML_PIECE_LEN(XML_FIELD_END);
+	uint8_t* cur = valueLen < SIZE_MAX - fieldLen ? reserveInBuffer(buf, bufSize, offset, fieldLen + valueLen) : NULL;
+	if (!cur)
+	{
+		*offset = CFLIST_OVERFLOW;
+		return false;
+	}
+	memcpy(cur, fieldTemplate->Prefix, fieldTemplate->PrefixLen);
+	cur += fieldTemplate->PrefixLen;
+	memcpy(cur, value, valueLen);
+	cur += valueLen;
+	memcpy(cur, XML_FIELD_END, XML_PIECE_LEN(XML_FIELD_END));
+	return true;
 }
 
-static void addUnsignedFieldToBuffer(uint8_t* buf, size_t bufSize, uint64_t data, char* tokenId, size_t* offset)
+// Returns the cached template for the type and token, building it on a miss. NULL if they don't fit in a template.
+static const CFListFieldTemplate* getFieldTemplate(const char* type, const char* tokenId)
 {
-	uint8_t* gpBuf = GET_GP_BUF();
+	// Tokens are usually literals sitting next to each other, so mix the pointer bits well (Fibonacci hashing)
+	uint64_t key = (uint64_t)(uintptr_t)tokenId ^ ((uint64_t)(uintptr_t)type << 1);
+	size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (CFLIST_TEMPLATE_CACHE_SIZE - 1);
+	CFListFieldTemplate* fieldTemplate = &___fieldTemplates[slot];
+
+	// The pointers have to match and so does the token (in case the caller reused its memory for another one)
+	if (fieldTemplate->TokenId == tokenId && fieldTemplate->Type == type && \
+		memcmp(fieldTemplate->Prefix + fieldTemplate->TokenOffset, tokenId, fieldTemplate->TokenLen) == 0 && tokenId[fieldTemplate->TokenLen] == 0)
+	{
+		COUNT_CFLIST_EVENT(TemplateHits);
+		return fieldTemplate;
+	}
+
+	if (!cFListBuildFieldTemplate(fieldTemplate, type, tokenId))
+	{
+		fieldTemplate->TokenId = NULL;
+		return NULL;
+	}
+	return fieldTemplate;
+}
 
-	int numChars = snprintf(gpBuf, getGpBufferSize(), "%"PRIu64, data);
-	assert(numChars > 0);
-	numChars = snprintf(buf + *offset, bufSize - *offset, XML_FIELD, INTEGER_S, tokenId, gpBuf);
-	assert(numChars > 0);
-	*offset += numChars;
+bool addFieldStartToBuffer(uint8_t* buf, size_t bufSize, const char* type, char* tokenId, size_t* offset)
+{
+	const CFListFieldTemplate* fieldTemplate = getFieldTemplate(type, tokenId);
+	if (fieldTemplate)
+	{
+		return addStringToBuffer(buf, bufSize, offset, (char*)fieldTemplate->Prefix, fieldTemplate->PrefixLen);
+	}
 
-	PUT_GP_BUF();
+	// Too long for a template, so put it together piece by piece
+	return addStringToBuffer(buf, bufSize, offset, XML_FIELD_START, XML_PIECE_LEN(XML_FIELD_START)) && \
+		addStringToBuffer(buf, bufSize, offset, (char*)type, strlen(type)) && \
+		addStringToBuffer(buf, bufSize, offset, XML_FIELD_TOKEN, XML_PIECE_LEN(XML_FIELD_TOKEN)) && \
+		addStringToBuffer(buf, bufSize, offset, tokenId, strlen(tokenId)) && \
+		addStringToBuffer(buf, bufSize, offset, XML_FIELD_DATA, XML_PIECE_LEN(XML_FIELD_DATA));
 }
 
-static void addSignedFieldToBuffer(uint8_t* buf, size_t bufSize, int64_t data, char* tokenId, size_t* offset)
+bool addXmlSafeStringToBuffer(uint8_t* buf, size_t bufSize, const char* str, size_t len, size_t* offset)
 {
-	uint8_t* gpBuf = GET_GP_BUF();
+	// Copy the runs between characters that need escaping in one go
+	size_t runStart = 0;
+	size_t i = 0;
+	for (; i < len; i++)
+	{
+		const char* escape = getXmlEscape(str[i]);
+		if (escape)
+		{
+			if (!addStringToBuffer(buf, bufSize, offset, (char*)str + runStart, i - runStart) || \
+				!addStringToBuffer(buf, bufSize, offset, (char*)escape, strlen(escape)))
+			{
+				return false;
+			}
+			runStart = i + 1;
+		}
+	}
+	return addStringToBuffer(buf, bufSize, offset, (char*)str + runStart, len - runStart);
+}
 
-	int numChars = snprintf(gpBuf, getGpBufferSize(), "%"PRIi64, data);
-	assert(numChars > 0);
+bool addHexBinaryDataToBuffer(uint8_t* buf, size_t bufSize, const uint8_t* data, size_t dataSize, size_t* offset)
+{
+	static const char hexChars[] = "0123456789ABCDEF";
 
-	numChars = snprintf(buf + *offset, bufSize - *offset, XML_FIELD, INTEGER_S, tokenId, gpBuf);
-	assert(numChars > 0);
-	*offset += numChars;
+	// Written straight into buf, so the size of data is only limited by buf
+	uint8_t* cur = dataSize <= SIZE_MAX / 2 ? reserveInBuffer(buf, bufSize, offset, dataSize * 2) : NULL;
+	if (!cur)
+	{
+		*offset = CFLIST_OVERFLOW;
+		return false;
+	}
+	size_t i = 0;
+	for (; i < dataSize; i++)
+	{
+		cur[i * 2] = hexChars[data[i] >> 4];
+		cur[(i * 2) + 1] = hexChars[data[i] & 0xF];
+	}
+	return true;
+}
 
-	PUT_GP_BUF();
+bool addFieldEndToBuffer(uint8_t* buf, size_t bufSize, size_t* offset)
+{
+	return addStringToBuffer(buf, bufSize, offset, XML_FIELD_END, XML_PIECE_LEN(XML_FIELD_END));
 }
 
-static void addBoolFieldToBuffer(uint8_t* buf, size_t bufSize, bool data, char* tokenId, size_t* offset)
+// Adds a field with an already xml safe value
+static bool addFieldToBuffer(uint8_t* buf, size_t bufSize, const char* type, char* tokenId, const char* value, size_t valueLen, size_t* offset)
 {
-	char* s = NULL;
-	if (data)
+	const CFListFieldTemplate* fieldTemplate = getFieldTemplate(type, tokenId);
+	if (fieldTemplate)
 	{
-		s = "True";
+		return addTemplatedFieldToBuffer(buf, bufSize, fieldTemplate, value, valueLen, offset);
 	}
-	else
+
+	return addFieldStartToBuffer(buf, bufSize, type, tokenId, offset) && \
+		addStringToBuffer(buf, bufSize, offset, (char*)value, valueLen) && \
+		addFieldEndToBuffer(buf, bufSize, offset);
+}
+
+// Writes value in decimal to the end of a 20 character buffer. Returns where the digits start.
+static char* writeUnsignedDecimal(char* bufEnd, uint64_t value)
+{
+	char* cur = bufEnd;
+	do
 	{
-		s = "False";
-	}
+		*--cur = (char)('0' + (value % 10));
+		value /= 10;
+	} while (value);
+	return cur;
+}
 
-	int numChars = snprintf(buf + *offset, bufSize - *offset, XML_FIELD, BOOL_S, tokenId, s);
-	assert(numChars > 0);
-	*offset += numChars;
+bool addStringFieldToBuffer(uint8_t* buf, size_t bufSize, char* data, char* tokenId, size_t* offset)
+{
+	// Escaped straight into buf rather than staged in the gpBuf, so long strings are fine
+	return addFieldStartToBuffer(buf, bufSize, STRING_S, tokenId, offset) && \
+		addXmlSafeStringToBuffer(buf, bufSize, data, strlen(data), offset) && \
+		addFieldEndToBuffer(buf, bufSize, offset);
 }
 
-void addHexBinaryDataFieldToBuffer(uint8_t* buf, size_t bufSize, uint8_t* data, size_t dataSize, char* tokenId, size_t *offset)
+bool addUnsignedFieldToBuffer(uint8_t* buf, size_t bufSize, uint64_t data, char* tokenId, size_t* offset)
 {
-	uint8_t* gpBuf = GET_GP_BUF();
-	int numChars;
+	char digits[20];
+	char* start = writeUnsignedDecimal(digits + sizeof(digits), data);
+	return addFieldToBuffer(buf, bufSize, INTEGER_S, tokenId, start, (size_t)(digits + sizeof(digits) - start), offset);
+}
 
-	// build hex bin string in gpbuf
-	size_t i = 0;
-	for (; i < dataSize; i++)
+bool addSignedFieldToBuffer(uint8_t* buf, size_t bufSize, int64_t data, char* tokenId, size_t* offset)
+{
+	// Negate as unsigned so INT64_MIN works
+	char digits[21];
+	char* start = writeUnsignedDecimal(digits + sizeof(digits), data < 0 ? (0 - (uint64_t)data) : (uint64_t)data);
+	if (data < 0)
 	{
-		assert(i < getGpBufferSize());
-		numChars = snprintf(gpBuf + (i * 2), getGpBufferSize() - (i * 2), "%02X", data[i]);
-		assert(numChars > 0);
+		*--start = '-';
 	}
+	return addFieldToBuffer(buf, bufSize, INTEGER_S, tokenId, start, (size_t)(digits + sizeof(digits) - start), offset);
+}
 
-	numChars = snprintf(buf + *offset, bufSize - *offset, XML_FIELD, HEXBINDATA_S, tokenId, gpBuf);
-	assert(numChars > 0);
-	*offset += numChars;
+bool addBoolFieldToBuffer(uint8_t* buf, size_t bufSize, bool data, char* tokenId, size_t* offset)
+{
+	if (data)
+	{
+		return addFieldToBuffer(buf, bufSize, BOOL_S, tokenId, "True", XML_PIECE_LEN("True"), offset);
+	}
+	return addFieldToBuffer(buf, bufSize, BOOL_S, tokenId, "False", XML_PIECE_LEN("False"), offset);
+}
 
-	PUT_GP_BUF();
+bool addHexBinaryDataFieldToBuffer(uint8_t* buf, size_t bufSize, uint8_t* data, size_t dataSize, char* tokenId, size_t *offset)
+{
+	return addFieldStartToBuffer(buf, bufSize, HEXBINDATA_S, tokenId, offset) && \
+		addHexBinaryDataToBuffer(buf, bufSize, data, dataSize, offset) && \
+		addFieldEndToBuffer(buf, bufSize, offset);
 }
 
-static uint64_t getIntegerValueFromId(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId)
+uint64_t getIntegerValueFromId(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId)
 {
-	assert(getFieldStringValueAndPutInGpBuf(xmlBuf, xmlBufSize, tokenId));
+	bool found = getFieldStringValueAndPutInGpBuf(xmlBuf, xmlBufSize, tokenId);
+	assert(found);
+	if (!found)
+	{
+		return 0;
+	}
 
 	uint64_t retVal = 0;
 	uint8_t* gpBuf = GET_GP_BUF();
@@ -445,9 +629,14 @@ static uint64_t getIntegerValueFromId(uint8_t* xmlBuf, size_t xmlBufSize, char*
 	return retVal;
 }
 
-static bool getBooleanValueFromId(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId)
+bool getBooleanValueFromId(uint8_t* xmlBuf, size_t xmlBufSize, char* tokenId)
 {
-	assert(getFieldStringValueAndPutInGpBuf(xmlBuf, xmlBufSize, tokenId));
+	bool found = getFieldStringValueAndPutInGpBuf(xmlBuf, xmlBufSize, tokenId);
+	assert(found);
+	if (!found)
+	{
+		return false;
+	}
 
 	bool retVal = false;
 	uint8_t* gpBuf = GET_GP_BUF();
@@ -458,29 +647,3 @@ static bool getBooleanValueFromId(uint8_t* xmlBuf, size_t xmlBufSize, char* toke
 	PUT_GP_BUF();
 	return retVal;
 }
-
-int main()
-{
-	uint8_t tbuf[4096] = { 0 };
-
-	char* testStr = "Test";
-
-	START_CFLIST(tbuf, sizeof(tbuf));
-	ADD_CFLIST_STRING_FIELD(TOKEN_SERIAL, testStr);
-	ADD_CFLIST_SIGNED_FIELD(TOKEN_SIZE, -12345);
-	ADD_CFLIST_BOOL_FIELD(TOKEN_SUPPORTS_POWER, true);
-	END_CFLIST();
-
-	printf("%s\n", (char*)tbuf);
-
-	//getFieldByTokenAndPutInGpBuf(tbuf, sizeof(tbuf), "B");
-	getFieldStringValueAndPutInGpBuf(tbuf, sizeof(tbuf), "C");
-	getFieldTypePutInGpBuf(tbuf, sizeof(tbuf), "C");
-	getFieldStringValueAndPutInGpBuf(tbuf, sizeof(tbuf), "A");
-	getFieldTypePutInGpBuf(tbuf, sizeof(tbuf), "A");
-
-	int64_t i = getIntegerValueFromId(tbuf, sizeof(tbuf), "A");
-	bool b = getBooleanValueFromId(tbuf, sizeof(tbuf), "C");
-
-	return EXIT_SUCCESS;
-}
\ No newline at end of file
@@ -0,0 +1,482 @@
+// BatchWriter.c - Gathers encoded records into large buffers and writes them in the background
+// (C) - Charles Machalow via the MIT License
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE 1 // pwritev
+#endif
+
+#include <assert.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#ifdef CSDDS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif // CSDDS_IO_URING
+
+#include "Atomics.h"
+#include "BatchWriter.h"
+#include "Memory.h"
+
+// A piece of a synchronous write
+typedef struct WriteSpan {
+	const uint8_t* Data;
+	size_t Len;
+} WriteSpan;
+
+/*
+*
+* io_uring (raw system calls, so there is no liburing dependency)
+*
+*/
+
+#ifdef CSDDS_IO_URING
+typedef struct IoUring {
+	int Fd;
+	volatile uint32_t* SqTail;
+	uint32_t SqMask;
+	uint32_t* SqArray;
+	struct io_uring_sqe* Sqes;
+	volatile uint32_t* CqHead;
+	volatile uint32_t* CqTail;
+	uint32_t CqMask;
+	struct io_uring_cqe* Cqes;
+	void* SqRing;
+	size_t SqRingSize;
+	void* CqRing;
+	size_t CqRingSize;
+	size_t SqesSize;
+	struct iovec Iovecs[BATCH_WRITER_BUFFER_COUNT]; // Have to stay put until the write completes
+} IoUring;
+
+static void ioUringClose(IoUring* ring)
+{
+	if (ring->Sqes && ring->Sqes != MAP_FAILED)
+	{
+		munmap(ring->Sqes, ring->SqesSize);
+	}
+	if (ring->CqRing && ring->CqRing != MAP_FAILED)
+	{
+		munmap(ring->CqRing, ring->CqRingSize);
+	}
+	if (ring->SqRing && ring->SqRing != MAP_FAILED)
+	{
+		munmap(ring->SqRing, ring->SqRingSize);
+	}
+	close(ring->Fd);
+	memFree(ring);
+}
+
+// Returns NULL if the kernel doesn't have io_uring (or won't let us use it)
+static IoUring* ioUringOpen(void)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = (int)syscall(__NR_io_uring_setup, BATCH_WRITER_BUFFER_COUNT, &params);
+	if (fd < 0)
+	{
+		return NULL;
+	}
+
+	IoUring* ring = (IoUring*)memCalloc(1, sizeof(IoUring));
+	if (!ring)
+	{
+		close(fd);
+		return NULL;
+	}
+	ring->Fd = fd;
+	ring->SqRingSize = params.sq_off.array + (params.sq_entries * sizeof(uint32_t));
+	ring->CqRingSize = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+	ring->SqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->SqRing = mmap(NULL, ring->SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	ring->CqRing = mmap(NULL, ring->CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	ring->Sqes = (struct io_uring_sqe*)mmap(NULL, ring->SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (ring->SqRing == MAP_FAILED || ring->CqRing == MAP_FAILED || ring->Sqes == MAP_FAILED)
+	{
+		ioUringClose(ring);
+		return NULL;
+	}
+
+	uint8_t* sq = (uint8_t*)ring->SqRing;
+	uint8_t* cq = (uint8_t*)ring->CqRing;
+	ring->SqTail = (volatile uint32_t*)(sq + params.sq_off.tail);
+	ring->SqMask = *(uint32_t*)(sq + params.sq_off.ring_mask);
+	ring->SqArray = (uint32_t*)(sq + params.sq_off.array);
+	ring->CqHead = (volatile uint32_t*)(cq + params.cq_off.head);
+	ring->CqTail = (volatile uint32_t*)(cq + params.cq_off.tail);
+	ring->CqMask = *(uint32_t*)(cq + params.cq_off.ring_mask);
+	ring->Cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+	return ring;
+}
+
+// Queues a write of the buffer and submits it. There are as many entries as buffers, so there is always room.
+static bool ioUringSubmitWrite(IoUring* ring, int fd, uint32_t bufferIndex, BatchBuffer* buffer)
+{
+	uint32_t tail = *ring->SqTail;
+	uint32_t index = tail & ring->SqMask;
+	struct io_uring_sqe* sqe = &ring->Sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+
+	ring->Iovecs[bufferIndex].iov_base = buffer->Data;
+	ring->Iovecs[bufferIndex].iov_len = buffer->Used;
+	sqe->opcode = IORING_OP_WRITEV;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)&ring->Iovecs[bufferIndex];
+	sqe->len = 1;
+	sqe->off = buffer->Offset;
+	sqe->user_data = bufferIndex;
+	ring->SqArray[index] = index;
+	atomicStoreRelease32(ring->SqTail, tail + 1);
+
+	long submitted;
+	do
+	{
+		submitted = syscall(__NR_io_uring_enter, ring->Fd, 1, 0, 0, NULL, 0);
+	} while (submitted < 0 && errno == EINTR);
+	return submitted == 1;
+}
+
+// Waits for the next completion and gives back which buffer it was for and the write's result.
+// Interrupts and the kernel being briefly out of resources (EAGAIN, EBUSY) are retried; false means waiting can't work.
+static bool ioUringWaitCompletion(IoUring* ring, uint32_t* bufferIndex, int32_t* result)
+{
+	uint32_t head = *ring->CqHead;
+	while (head == atomicLoadAcquire32(ring->CqTail))
+	{
+		if (syscall(__NR_io_uring_enter, ring->Fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && \
+			errno != EINTR && errno != EAGAIN && errno != EBUSY)
+		{
+			return false;
+		}
+	}
+
+	struct io_uring_cqe* cqe = &ring->Cqes[head & ring->CqMask];
+	*bufferIndex = (uint32_t)cqe->user_data;
+	*result = cqe->res;
+	atomicStoreRelease32(ring->CqHead, head + 1);
+	return true;
+}
+#endif // CSDDS_IO_URING
+
+/*
+*
+* Synchronous writes
+*
+*/
+
+// Writes the spans one after another at offset, retrying short writes
+static bool writeSpans(BatchWriter* writer, WriteSpan* spans, int spanCount, uint64_t offset)
+{
+#ifdef _WIN32
+	if (_lseeki64(writer->Fd, (__int64)offset, SEEK_SET) < 0)
+	{
+		return false;
+	}
+	for (int i = 0; i < spanCount; i++)
+	{
+		const uint8_t* cur = spans[i].Data;
+		size_t remaining = spans[i].Len;
+		while (remaining)
+		{
+			unsigned int chunk = remaining > INT32_MAX ? INT32_MAX : (unsigned int)remaining;
+			int written = _write(writer->Fd, cur, chunk);
+			writer->WriteCalls++;
+			if (written <= 0)
+			{
+				return false;
+			}
+			cur += written;
+			remaining -= (size_t)written;
+		}
+	}
+	return true;
+#else
+	struct iovec iov[BATCH_WRITER_BUFFER_COUNT];
+	int iovCount = 0;
+	for (int i = 0; i < spanCount; i++)
+	{
+		if (spans[i].Len)
+		{
+			iov[iovCount].iov_base = (void*)spans[i].Data;
+			iov[iovCount].iov_len = spans[i].Len;
+			iovCount++;
+		}
+	}
+
+	struct iovec* cur = iov;
+	while (iovCount)
+	{
+		ssize_t written = pwritev(writer->Fd, cur, iovCount, (off_t)offset);
+		writer->WriteCalls++;
+		if (written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (written <= 0)
+		{
+			return false;
+		}
+
+		// Skip what was written
+		offset += (uint64_t)written;
+		while (iovCount && (size_t)written >= cur->iov_len)
+		{
+			written -= (ssize_t)cur->iov_len;
+			cur++;
+			iovCount--;
+		}
+		if (iovCount)
+		{
+			cur->iov_base = (uint8_t*)cur->iov_base + written;
+			cur->iov_len -= (size_t)written;
+		}
+	}
+	return true;
+#endif // _WIN32
+}
+
+/*
+*
+* Buffers
+*
+*/
+
+// Remembers the first error
+static BatchWriterStatus fail(BatchWriter* writer, BatchWriterStatus status)
+{
+	if (writer->Status == BATCH_WRITER_OK)
+	{
+		writer->Status = status;
+	}
+	return writer->Status;
+}
+
+// Waits until the buffer at bufferIndex is free to be filled again. If waiting fails for good the buffer stays InFlight,
+// since the kernel may still be writing from it.
+static BatchWriterStatus waitForBuffer(BatchWriter* writer, uint32_t bufferIndex)
+{
+#ifdef CSDDS_IO_URING
+	while (writer->Buffers[bufferIndex].InFlight && writer->Status != BATCH_WRITER_WAIT_FAILED)
+	{
+		uint32_t completedIndex = 0;
+		int32_t result = 0;
+		if (!ioUringWaitCompletion((IoUring*)writer->Ring, &completedIndex, &result) || completedIndex >= BATCH_WRITER_BUFFER_COUNT)
+		{
+			writer->Status = BATCH_WRITER_WAIT_FAILED;
+			return writer->Status;
+		}
+
+		BatchBuffer* completed = &writer->Buffers[completedIndex];
+		completed->InFlight = false;
+		if (result < 0)
+		{
+			fail(writer, BATCH_WRITER_IO_ERROR);
+		}
+		else if ((size_t)result < completed->Used)
+		{
+			// Finish a short write here rather than queueing the rest
+			WriteSpan rest = { completed->Data + result, completed->Used - (size_t)result };
+			if (!writeSpans(writer, &rest, 1, completed->Offset + (uint64_t)result))
+			{
+				fail(writer, BATCH_WRITER_IO_ERROR);
+			}
+		}
+		completed->Used = 0;
+	}
+#else
+	(void)bufferIndex;
+#endif // CSDDS_IO_URING
+	return writer->Status;
+}
+
+static BatchWriterStatus waitForAllBuffers(BatchWriter* writer)
+{
+	for (uint32_t i = 0; i < BATCH_WRITER_BUFFER_COUNT; i++)
+	{
+		waitForBuffer(writer, i);
+	}
+	return writer->Status;
+}
+
+// Hands off the current buffer and moves on to the next one (waiting for it if it is still being written)
+static BatchWriterStatus submitCurrent(BatchWriter* writer)
+{
+	BatchBuffer* buffer = &writer->Buffers[writer->Current];
+	if (!buffer->Used || writer->Status != BATCH_WRITER_OK)
+	{
+		return writer->Status;
+	}
+	buffer->Offset = writer->Offset;
+	writer->Offset += buffer->Used;
+
+#ifdef CSDDS_IO_URING
+	if (writer->Backend == BATCH_WRITER_IO_URING)
+	{
+		if (!ioUringSubmitWrite((IoUring*)writer->Ring, writer->Fd, writer->Current, buffer))
+		{
+			return fail(writer, BATCH_WRITER_IO_ERROR);
+		}
+		writer->WriteCalls++;
+		buffer->InFlight = true;
+	}
+	else
+#endif // CSDDS_IO_URING
+	{
+		WriteSpan span = { buffer->Data, buffer->Used };
+		if (!writeSpans(writer, &span, 1, buffer->Offset))
+		{
+			return fail(writer, BATCH_WRITER_IO_ERROR);
+		}
+		buffer->Used = 0;
+	}
+
+	writer->Current = (writer->Current + 1) % BATCH_WRITER_BUFFER_COUNT;
+	return waitForBuffer(writer, writer->Current);
+}
+
+BatchWriterStatus batchWriterOpen(BatchWriter* writer, int fd, size_t bufferSize, bool useIoUring)
+{
+	memset(writer, 0, sizeof(*writer));
+	writer->Fd = fd;
+	writer->BufferSize = bufferSize ? bufferSize : BATCH_WRITER_DEFAULT_BUFFER_SIZE;
+	writer->BufferSize = (writer->BufferSize + BATCH_WRITER_ALIGNMENT - 1) & ~(size_t)(BATCH_WRITER_ALIGNMENT - 1);
+
+#ifdef _WIN32
+	writer->Backend = BATCH_WRITER_WRITE;
+	__int64 offset = _lseeki64(fd, 0, SEEK_CUR);
+#else
+	writer->Backend = BATCH_WRITER_PWRITEV;
+	off_t offset = lseek(fd, 0, SEEK_CUR);
+#endif // _WIN32
+	writer->Offset = offset < 0 ? 0 : (uint64_t)offset; // Pipes and the like can't seek, pwritev will say so
+
+	for (uint32_t i = 0; i < BATCH_WRITER_BUFFER_COUNT; i++)
+	{
+		// Allocated through memAlloc (so a custom allocator sees it) and aligned by hand
+		BatchBuffer* buffer = &writer->Buffers[i];
+		buffer->Allocation = memAlloc(writer->BufferSize + BATCH_WRITER_ALIGNMENT - 1);
+		if (!buffer->Allocation)
+		{
+			batchWriterClose(writer);
+			return BATCH_WRITER_NO_MEMORY;
+		}
+		uintptr_t aligned = ((uintptr_t)buffer->Allocation + BATCH_WRITER_ALIGNMENT - 1) & ~(uintptr_t)(BATCH_WRITER_ALIGNMENT - 1);
+		buffer->Data = (uint8_t*)aligned;
+	}
+
+#ifdef CSDDS_IO_URING
+	if (useIoUring && (writer->Ring = ioUringOpen()) != NULL)
+	{
+		writer->Backend = BATCH_WRITER_IO_URING;
+	}
+#else
+	(void)useIoUring;
+#endif // CSDDS_IO_URING
+	return BATCH_WRITER_OK;
+}
+
+uint8_t* batchWriterReserve(BatchWriter* writer, size_t maxLength)
+{
+	if (maxLength > writer->BufferSize || writer->Status != BATCH_WRITER_OK)
+	{
+		return NULL;
+	}
+
+	BatchBuffer* buffer = &writer->Buffers[writer->Current];
+	if (buffer->Used + maxLength > writer->BufferSize && submitCurrent(writer) != BATCH_WRITER_OK)
+	{
+		return NULL;
+	}
+	buffer = &writer->Buffers[writer->Current];
+	return buffer->Data + buffer->Used;
+}
+
+BatchWriterStatus batchWriterCommit(BatchWriter* writer, size_t length)
+{
+	BatchBuffer* buffer = &writer->Buffers[writer->Current];
+	assert(buffer->Used + length <= writer->BufferSize);
+	buffer->Used += length;
+	return writer->Status;
+}
+
+BatchWriterStatus batchWriterWrite(BatchWriter* writer, const void* record, size_t recordLen)
+{
+	if (recordLen <= writer->BufferSize)
+	{
+		uint8_t* dest = batchWriterReserve(writer, recordLen);
+		if (!dest)
+		{
+			return writer->Status;
+		}
+		memcpy(dest, record, recordLen);
+		return batchWriterCommit(writer, recordLen);
+	}
+
+	// Too big to buffer: write what is buffered and the record together, once earlier writes are done
+	if (waitForAllBuffers(writer) != BATCH_WRITER_OK)
+	{
+		return writer->Status;
+	}
+	BatchBuffer* buffer = &writer->Buffers[writer->Current];
+	WriteSpan spans[2] = { { buffer->Data, buffer->Used }, { (const uint8_t*)record, recordLen } };
+	if (!writeSpans(writer, spans, 2, writer->Offset))
+	{
+		return fail(writer, BATCH_WRITER_IO_ERROR);
+	}
+	writer->Offset += buffer->Used + recordLen;
+	buffer->Used = 0;
+	return BATCH_WRITER_OK;
+}
+
+BatchWriterStatus batchWriterFlush(BatchWriter* writer)
+{
+	if (submitCurrent(writer) != BATCH_WRITER_OK || waitForAllBuffers(writer) != BATCH_WRITER_OK)
+	{
+		return writer->Status;
+	}
+
+#ifndef _WIN32
+	// Positioned writes don't move the file offset, so leave it after the records like fwrite would
+	lseek(writer->Fd, (off_t)writer->Offset, SEEK_SET);
+#endif // _WIN32
+	return writer->Status;
+}
+
+BatchWriterStatus batchWriterClose(BatchWriter* writer)
+{
+	if (writer->Buffers[0].Allocation)
+	{
+		batchWriterFlush(writer);
+	}
+
+	// A buffer still in flight after this is one the kernel may be writing from, so it (and the ring holding its iovec)
+	// is leaked rather than freed under the write
+	waitForAllBuffers(writer);
+#ifdef CSDDS_IO_URING
+	if (writer->Ring && writer->Status != BATCH_WRITER_WAIT_FAILED)
+	{
+		ioUringClose((IoUring*)writer->Ring);
+	}
+	writer->Ring = NULL;
+#endif // CSDDS_IO_URING
+	for (uint32_t i = 0; i < BATCH_WRITER_BUFFER_COUNT; i++)
+	{
+		if (!writer->Buffers[i].InFlight)
+		{
+			memFree(writer->Buffers[i].Allocation);
+		}
+		writer->Buffers[i].InFlight = false;
+		writer->Buffers[i].Allocation = NULL;
+		writer->Buffers[i].Data = NULL;
+		writer->Buffers[i].Used = 0;
+	}
+	return writer->Status;
+}
@@ -0,0 +1,96 @@
+// BatchWriter.h - Gathers encoded records into large buffers and writes them in the background
+// (C) - Charles Machalow via the MIT License
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Two buffers: one being filled while the other is being written
+#define BATCH_WRITER_BUFFER_COUNT        2
+
+// Buffers are page aligned, so they also work for files opened with O_DIRECT
+#define BATCH_WRITER_ALIGNMENT           4096
+#define BATCH_WRITER_DEFAULT_BUFFER_SIZE (1024 * 1024)
+
+/// <summary>
+/// Result of a writer call. The first error sticks; every call after it returns the same status. The one exception is
+/// BATCH_WRITER_WAIT_FAILED, which replaces any earlier error since it means memory was left allocated.
+/// </summary>
+typedef enum BatchWriterStatus {
+	BATCH_WRITER_OK = 0,
+	BATCH_WRITER_IO_ERROR,   // A write failed
+	BATCH_WRITER_NO_MEMORY,  // An allocation failed
+	BATCH_WRITER_WAIT_FAILED // A submitted write could never be waited for, so its buffer and the io_uring are leaked
+} BatchWriterStatus;
+
+/// <summary>
+/// How full buffers get to the file
+/// </summary>
+typedef enum BatchWriterBackend {
+	BATCH_WRITER_IO_URING = 0, // Submitted to an io_uring, so the caller keeps encoding while the kernel writes
+	BATCH_WRITER_PWRITEV,      // Written with pwritev() when a buffer fills
+	BATCH_WRITER_WRITE         // Written with _write() (Windows)
+} BatchWriterBackend;
+
+/// <summary>
+/// One of the writer's buffers
+/// </summary>
+typedef struct BatchBuffer {
+	uint8_t* Data;
+	size_t Used;
+	uint64_t Offset; // Where in the file it is being written (while InFlight)
+	bool InFlight;   // Handed to the kernel and not finished yet
+	void* Allocation;
+} BatchBuffer;
+
+/// <summary>
+/// Appends records to a file descriptor with as few system calls as possible. Records are copied (or encoded straight)
+/// into the current buffer. When it fills it is handed off and the other buffer is used. Not thread safe.
+/// </summary>
+typedef struct BatchWriter {
+	int Fd;
+	uint64_t Offset;      // File offset the next buffer is written at
+	size_t BufferSize;
+	BatchBuffer Buffers[BATCH_WRITER_BUFFER_COUNT];
+	uint32_t Current;     // Buffer being filled
+	BatchWriterBackend Backend;
+	BatchWriterStatus Status;
+	uint64_t WriteCalls;  // Write system calls made (or io_uring submissions)
+	void* Ring;           // io_uring state, with BATCH_WRITER_IO_URING
+} BatchWriter;
+
+/// <summary>
+/// Starts writing to fd at its current offset. bufferSize (0 for BATCH_WRITER_DEFAULT_BUFFER_SIZE) is rounded up to
+/// BATCH_WRITER_ALIGNMENT. useIoUring asks for io_uring. If it can't be set up (not built in, or refused by the kernel)
+/// the writer quietly falls back to pwritev(). The fd is not closed by the writer.
+/// </summary>
+BatchWriterStatus batchWriterOpen(BatchWriter* writer, int fd, size_t bufferSize, bool useIoUring);
+
+/// <summary>
+/// Returns space for a record of up to maxLength bytes in the current buffer, to be followed by batchWriterCommit().
+/// Returns NULL if maxLength is more than the buffer size (use batchWriterWrite() for those) or on an earlier error.
+/// </summary>
+uint8_t* batchWriterReserve(BatchWriter* writer, size_t maxLength);
+
+/// <summary>
+/// Keeps length bytes of the space given by batchWriterReserve()
+/// </summary>
+BatchWriterStatus batchWriterCommit(BatchWriter* writer, size_t length);
+
+/// <summary>
+/// Copies a record into the current buffer. Records bigger than a buffer are written straight from record
+/// (along with what is buffered, in one call).
+/// </summary>
+BatchWriterStatus batchWriterWrite(BatchWriter* writer, const void* record, size_t recordLen);
+
+/// <summary>
+/// Writes everything buffered and waits for all writes to finish
+/// </summary>
+BatchWriterStatus batchWriterFlush(BatchWriter* writer);
+
+/// <summary>
+/// Flushes and frees the writer. Returns the first error seen over the writer's life. With BATCH_WRITER_WAIT_FAILED
+/// the kernel may still be writing from a buffer, so that buffer and the io_uring are not freed.
+/// </summary>
+BatchWriterStatus batchWriterClose(BatchWriter* writer);
@@ -0,0 +1,472 @@
+// Compression.c - Small LZ4 style block codec for serialized SDDS and cFList documents
+// (C) - Charles Machalow via the MIT License
+//
+// Blocks follow the LZ4 block format: a run of sequences, each a token byte (literal length << 4 | match length - 4),
+// extra length bytes when a length is 15 or more, the literals, then a 2 byte little endian offset and extra match length bytes.
+// The last sequence is literals only. A dictionary acts as data that came right before the block.
+
+#include <string.h>
+
+#include "Compression.h"
+
+#define MIN_MATCH      4
+#define LAST_LITERALS  5  // The last 5 bytes are always literals
+#define MF_LIMIT       12 // A match can't start in the last 12 bytes
+#define MAX_OFFSET     65535
+#define HASH_LOG       12
+#define SKIP_TRIGGER   6  // After 2^6 misses in a row, start stepping further to get through data that won't compress
+
+/*
+*
+* Dictionaries
+*
+*/
+
+// Most used pieces go last so they are the closest to the data
+static const char sddsXmlVocabulary[] =
+	"<Fields>\n</Fields>\n"
+	"00000000000000000000000000000000FFFFFFFF"
+	"\" FieldSize=64 FieldModifier=0>"
+	"\" FieldSize=32 FieldModifier=0>"
+	"\" FieldSize=16 FieldModifier=0>"
+	"\" FieldSize=8 FieldModifier=0>"
+	"</Field>\n<Field FieldName=\"";
+
+static const char cFListVocabulary[] =
+	"<cFList></cFList>"
+	"<field type=\"HexBinaryData\" token=\""
+	"\">True</field>\">False</field>"
+	"</field><field type=\"Boolean\" token=\""
+	"</field><field type=\"String\" token=\""
+	"</field><field type=\"Integer\" token=\"";
+
+static const CompressionDictionary sddsXmlDictionary = { (const uint8_t*)sddsXmlVocabulary, sizeof(sddsXmlVocabulary) - 1 };
+static const CompressionDictionary cFListDictionary = { (const uint8_t*)cFListVocabulary, sizeof(cFListVocabulary) - 1 };
+
+const CompressionDictionary* getCompressionDictionary(uint8_t dictionaryId)
+{
+	switch (dictionaryId)
+	{
+	case COMPRESSION_DICT_SDDS_XML:
+		return &sddsXmlDictionary;
+	case COMPRESSION_DICT_CFLIST:
+		return &cFListDictionary;
+	default:
+		return NULL;
+	}
+}
+
+/*
+*
+* Blocks
+*
+*/
+
+static uint32_t read32(const uint8_t* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static uint32_t hash4(uint32_t sequence)
+{
+	return (sequence * 2654435761U) >> (32 - HASH_LOG);
+}
+
+// Counts matching bytes, stopping at either end
+static size_t countMatch(const uint8_t* a, const uint8_t* aEnd, const uint8_t* b, const uint8_t* bEnd)
+{
+	const uint8_t* start = b;
+	while (a < aEnd && b < bEnd && *a == *b)
+	{
+		a++;
+		b++;
+	}
+	return (size_t)(b - start);
+}
+
+// Writes the extra bytes for a length of 15 or more (len is what is left after the 15)
+static bool putLength(uint8_t** op, uint8_t* opEnd, size_t len)
+{
+	for (; len >= 255; len -= 255)
+	{
+		if (*op == opEnd)
+		{
+			return false;
+		}
+		*(*op)++ = 255;
+	}
+	if (*op == opEnd)
+	{
+		return false;
+	}
+	*(*op)++ = (uint8_t)len;
+	return true;
+}
+
+// Writes a sequence. An offset of 0 makes it the last (literals only) sequence.
+static bool putSequence(uint8_t** op, uint8_t* opEnd, const uint8_t* literals, size_t literalLen, size_t offset, size_t matchLen)
+{
+	if (*op == opEnd)
+	{
+		return false;
+	}
+
+	size_t extraMatchLen = offset ? matchLen - MIN_MATCH : 0;
+	uint8_t* token = (*op)++;
+	*token = (uint8_t)(((literalLen >= 15 ? 15 : literalLen) << 4) | (extraMatchLen >= 15 ? 15 : extraMatchLen));
+	if (literalLen >= 15 && !putLength(op, opEnd, literalLen - 15))
+	{
+		return false;
+	}
+	if ((size_t)(opEnd - *op) < literalLen)
+	{
+		return false;
+	}
+	memcpy(*op, literals, literalLen);
+	*op += literalLen;
+
+	if (offset)
+	{
+		if (opEnd - *op < 2)
+		{
+			return false;
+		}
+		*(*op)++ = (uint8_t)(offset & 0xFF);
+		*(*op)++ = (uint8_t)(offset >> 8);
+		if (extraMatchLen >= 15 && !putLength(op, opEnd, extraMatchLen - 15))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t compressBlock(const uint8_t* src, size_t srcLen, uint8_t* dst, size_t dstSize, const CompressionDictionary* dictionary)
+{
+	// Positions count from the start of the dictionary, with the data right after it. 0 in the table means empty.
+	uint32_t table[1 << HASH_LOG] = { 0 };
+	const uint8_t* dict = dictionary ? dictionary->Data : NULL;
+	size_t dictSize = dictionary ? dictionary->Size : 0;
+	if (dictSize > MAX_OFFSET)
+	{
+		// Anything further back can't be reached
+		dict += dictSize - MAX_OFFSET;
+		dictSize = MAX_OFFSET;
+	}
+	for (size_t i = 0; i + MIN_MATCH <= dictSize; i++)
+	{
+		table[hash4(read32(dict + i))] = (uint32_t)(i + 1);
+	}
+
+	uint8_t* op = dst;
+	uint8_t* opEnd = dst + dstSize;
+	const uint8_t* anchor = src;
+	if (srcLen > MF_LIMIT && srcLen < UINT32_MAX - MAX_OFFSET)
+	{
+		const uint8_t* ip = src;
+		const uint8_t* mfLimit = src + srcLen - MF_LIMIT;
+		const uint8_t* matchLimit = src + srcLen - LAST_LITERALS;
+		uint32_t misses = 0;
+		while (ip < mfLimit)
+		{
+			uint32_t sequence = read32(ip);
+			uint32_t hash = hash4(sequence);
+			size_t position = dictSize + (size_t)(ip - src);
+			size_t candidate = table[hash];
+			table[hash] = (uint32_t)(position + 1);
+
+			const uint8_t* match = NULL;
+			if (candidate && position - (candidate - 1) <= MAX_OFFSET)
+			{
+				candidate--;
+				match = candidate < dictSize ? dict + candidate : src + (candidate - dictSize);
+				if (read32(match) != sequence)
+				{
+					match = NULL;
+				}
+			}
+			if (!match)
+			{
+				ip += 1 + (misses++ >> SKIP_TRIGGER);
+				continue;
+			}
+			misses = 0;
+
+			// A match in the dictionary can run off its end and on into the data
+			size_t matchLen;
+			if (candidate < dictSize)
+			{
+				matchLen = countMatch(match, dict + dictSize, ip, matchLimit);
+				if (candidate + matchLen == dictSize)
+				{
+					matchLen += countMatch(src, matchLimit, ip + matchLen, matchLimit);
+				}
+			}
+			else
+			{
+				matchLen = countMatch(match, matchLimit, ip, matchLimit);
+			}
+
+			if (!putSequence(&op, opEnd, anchor, (size_t)(ip - anchor), position - candidate, matchLen))
+			{
+				return 0;
+			}
+			ip += matchLen;
+			anchor = ip;
+
+			// Keep the table fresh for the next search
+			if (ip < mfLimit)
+			{
+				table[hash4(read32(ip - 2))] = (uint32_t)(dictSize + (size_t)(ip - 2 - src) + 1);
+			}
+		}
+	}
+
+	if (!putSequence(&op, opEnd, anchor, (size_t)(src + srcLen - anchor), 0, 0))
+	{
+		return 0;
+	}
+	return (size_t)(op - dst);
+}
+
+// Reads the extra bytes of a length that was 15
+static CompressionStatus readLength(const uint8_t** ip, const uint8_t* end, size_t* len)
+{
+	uint8_t byte;
+	do
+	{
+		if (*ip == end)
+		{
+			return COMPRESSION_TRUNCATED;
+		}
+		byte = *(*ip)++;
+		if (*len > SIZE_MAX / 2)
+		{
+			return COMPRESSION_MALFORMED;
+		}
+		*len += byte;
+	} while (byte == 255);
+	return COMPRESSION_OK;
+}
+
+CompressionStatus decompressBlock(const uint8_t* src, size_t srcLen, uint8_t* dst, size_t dstSize, size_t* dstLen,
+	const CompressionDictionary* dictionary)
+{
+	const uint8_t* dict = dictionary ? dictionary->Data : NULL;
+	size_t dictSize = dictionary ? dictionary->Size : 0;
+	if (dictSize > MAX_OFFSET)
+	{
+		dict += dictSize - MAX_OFFSET;
+		dictSize = MAX_OFFSET;
+	}
+
+	const uint8_t* ip = src;
+	const uint8_t* end = src + srcLen;
+	uint8_t* op = dst;
+	uint8_t* opEnd = dst + dstSize;
+	CompressionStatus status;
+	for (;;)
+	{
+		if (ip == end)
+		{
+			return COMPRESSION_TRUNCATED;
+		}
+		uint8_t token = *ip++;
+
+		size_t literalLen = token >> 4;
+		if (literalLen == 15 && (status = readLength(&ip, end, &literalLen)) != COMPRESSION_OK)
+		{
+			return status;
+		}
+		if ((size_t)(end - ip) < literalLen)
+		{
+			return COMPRESSION_TRUNCATED;
+		}
+		if ((size_t)(opEnd - op) < literalLen)
+		{
+			return COMPRESSION_TOO_SMALL;
+		}
+		memcpy(op, ip, literalLen);
+		ip += literalLen;
+		op += literalLen;
+
+		// The last sequence has no match
+		if (ip == end)
+		{
+			break;
+		}
+
+		if (end - ip < 2)
+		{
+			return COMPRESSION_TRUNCATED;
+		}
+		size_t offset = ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		size_t matchLen = token & 0xF;
+		if (matchLen == 15 && (status = readLength(&ip, end, &matchLen)) != COMPRESSION_OK)
+		{
+			return status;
+		}
+		matchLen += MIN_MATCH;
+
+		size_t written = (size_t)(op - dst);
+		if (offset == 0 || offset > written + dictSize)
+		{
+			return COMPRESSION_MALFORMED;
+		}
+		if ((size_t)(opEnd - op) < matchLen)
+		{
+			return COMPRESSION_TOO_SMALL;
+		}
+
+		// Copy whatever part of the match is in the dictionary, then the rest from the output
+		const uint8_t* match = op - offset;
+		if (offset > written)
+		{
+			size_t fromDict = offset - written;
+			size_t len = fromDict < matchLen ? fromDict : matchLen;
+			memcpy(op, dict + dictSize - fromDict, len);
+			op += len;
+			matchLen -= len;
+			match = dst;
+		}
+		if ((size_t)(op - match) >= matchLen)
+		{
+			memcpy(op, match, matchLen);
+			op += matchLen;
+		}
+		else
+		{
+			// Overlapping match (a repeating pattern), so it has to go a byte at a time
+			while (matchLen--)
+			{
+				*op++ = *match++;
+			}
+		}
+	}
+
+	*dstLen = (size_t)(op - dst);
+	return COMPRESSION_OK;
+}
+
+/*
+*
+* Frames
+*
+*/
+
+static void write32le(uint8_t* p, uint32_t value)
+{
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+	p[2] = (uint8_t)(value >> 16);
+	p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t read32le(const uint8_t* p)
+{
+	return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void writeFrameHeader(uint8_t* dst, uint8_t method, uint8_t dictionaryId, uint32_t rawLen, uint32_t blockLen)
+{
+	memcpy(dst, COMPRESSION_FRAME_MAGIC, 2);
+	dst[2] = method;
+	dst[3] = dictionaryId;
+	write32le(dst + 4, rawLen);
+	write32le(dst + 8, blockLen);
+}
+
+size_t compressFrame(const uint8_t* src, size_t srcLen, uint8_t dictionaryId, uint8_t* dst, size_t dstSize)
+{
+	if (dstSize < COMPRESSION_FRAME_BOUND(srcLen) || srcLen > UINT32_MAX ||
+		(dictionaryId != COMPRESSION_DICT_NONE && !getCompressionDictionary(dictionaryId)))
+	{
+		return 0;
+	}
+
+	// Only keep the compressed block if it is smaller
+	uint8_t method = COMPRESSION_METHOD_LZ;
+	size_t blockLen = compressBlock(src, srcLen, dst + COMPRESSION_FRAME_HEADER_SIZE, srcLen, getCompressionDictionary(dictionaryId));
+	if (blockLen == 0)
+	{
+		method = COMPRESSION_METHOD_STORED;
+		memcpy(dst + COMPRESSION_FRAME_HEADER_SIZE, src, srcLen);
+		blockLen = srcLen;
+	}
+
+	writeFrameHeader(dst, method, dictionaryId, (uint32_t)srcLen, (uint32_t)blockLen);
+	return COMPRESSION_FRAME_HEADER_SIZE + blockLen;
+}
+
+CompressionStatus getFrameInfo(const uint8_t* src, size_t srcLen, size_t* rawLen, size_t* frameLen)
+{
+	if (srcLen < COMPRESSION_FRAME_HEADER_SIZE)
+	{
+		return COMPRESSION_TRUNCATED;
+	}
+	if (memcmp(src, COMPRESSION_FRAME_MAGIC, 2) != 0 || src[2] > COMPRESSION_METHOD_LZ)
+	{
+		return COMPRESSION_MALFORMED;
+	}
+	if (src[3] != COMPRESSION_DICT_NONE && !getCompressionDictionary(src[3]))
+	{
+		return COMPRESSION_BAD_DICTIONARY;
+	}
+
+	// A 32 bit size_t can't hold every block length with the header added
+	uint32_t blockLen = read32le(src + 8);
+	if (blockLen > SIZE_MAX - COMPRESSION_FRAME_HEADER_SIZE)
+	{
+		return COMPRESSION_MALFORMED;
+	}
+	*rawLen = read32le(src + 4);
+	*frameLen = COMPRESSION_FRAME_HEADER_SIZE + (size_t)blockLen;
+	if (src[2] == COMPRESSION_METHOD_STORED && *frameLen - COMPRESSION_FRAME_HEADER_SIZE != *rawLen)
+	{
+		return COMPRESSION_MALFORMED;
+	}
+	if (src[2] == COMPRESSION_METHOD_LZ && *rawLen > DECOMPRESS_BLOCK_BOUND(*frameLen - COMPRESSION_FRAME_HEADER_SIZE))
+	{
+		return COMPRESSION_MALFORMED;
+	}
+	return COMPRESSION_OK;
+}
+
+CompressionStatus decompressFrame(const uint8_t* src, size_t srcLen, uint8_t* dst, size_t dstSize, size_t* dstLen)
+{
+	size_t rawLen = 0;
+	size_t frameLen = 0;
+	CompressionStatus status = getFrameInfo(src, srcLen, &rawLen, &frameLen);
+	if (status != COMPRESSION_OK)
+	{
+		return status;
+	}
+	if (srcLen < frameLen)
+	{
+		return COMPRESSION_TRUNCATED;
+	}
+	if (dstSize < rawLen)
+	{
+		return COMPRESSION_TOO_SMALL;
+	}
+
+	const uint8_t* block = src + COMPRESSION_FRAME_HEADER_SIZE;
+	size_t blockLen = frameLen - COMPRESSION_FRAME_HEADER_SIZE;
+	if (src[2] == COMPRESSION_METHOD_STORED)
+	{
+		memcpy(dst, block, rawLen);
+		*dstLen = rawLen;
+		return COMPRESSION_OK;
+	}
+
+	// The header says how long it is, so a block that decodes to anything else is bad
+	status = decompressBlock(block, blockLen, dst, rawLen, dstLen, getCompressionDictionary(src[3]));
+	if (status == COMPRESSION_TOO_SMALL || (status == COMPRESSION_OK && *dstLen != rawLen))
+	{
+		return COMPRESSION_MALFORMED;
+	}
+	return status;
+}
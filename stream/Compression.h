@@ -0,0 +1,87 @@
+// Compression.h - Small LZ4 style block codec for serialized SDDS and cFList documents
+// (C) - Charles Machalow via the MIT License
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// <summary>
+/// Result of decompressing. Nothing here asserts; every problem comes back as one of these.
+/// </summary>
+typedef enum CompressionStatus {
+	COMPRESSION_OK = 0,
+	COMPRESSION_TRUNCATED,   // The input ended in the middle of something
+	COMPRESSION_MALFORMED,   // The input isn't a valid block or frame
+	COMPRESSION_TOO_SMALL,   // The output buffer is too small
+	COMPRESSION_BAD_DICTIONARY // The frame names a dictionary this build doesn't know
+} CompressionStatus;
+
+/// <summary>
+/// Text that is treated as if it came right before the data, so even small records find matches.
+/// The same dictionary has to be used to compress and decompress.
+/// </summary>
+typedef struct CompressionDictionary {
+	const uint8_t* Data;
+	size_t Size;
+} CompressionDictionary;
+
+// Dictionary ids as stored in a frame. Dictionaries can't change once data is written with them; add a new id instead.
+#define COMPRESSION_DICT_NONE     0
+#define COMPRESSION_DICT_SDDS_XML 1 // Tags and attributes of toXml() output
+#define COMPRESSION_DICT_CFLIST   2 // Tags, types and booleans of cFList documents
+
+// Worst case size of compressBlock() output
+#define COMPRESS_BLOCK_BOUND(srcLen) ((srcLen) + ((srcLen) / 255) + 16)
+
+// Most a block of blockLen bytes can decompress to (each length byte adds at most 255)
+#define DECOMPRESS_BLOCK_BOUND(blockLen) (((uint64_t)(blockLen) * 255) + 16)
+
+// Frame layout: COMPRESSION_FRAME_MAGIC, method (1), dictionary id (1), raw length (4), block length (4), block.
+// Lengths are little endian. Data that doesn't compress is stored as is, so a frame is never bigger than COMPRESSION_FRAME_BOUND().
+#define COMPRESSION_FRAME_MAGIC       "CZ"
+#define COMPRESSION_METHOD_STORED     0
+#define COMPRESSION_METHOD_LZ         1
+#define COMPRESSION_FRAME_HEADER_SIZE 12
+#define COMPRESSION_FRAME_BOUND(srcLen) (COMPRESSION_FRAME_HEADER_SIZE + (srcLen))
+
+/// <summary>
+/// Returns the built in dictionary with the given id, or NULL (also for COMPRESSION_DICT_NONE)
+/// </summary>
+const CompressionDictionary* getCompressionDictionary(uint8_t dictionaryId);
+
+/// <summary>
+/// Compresses srcLen bytes into dst (LZ4 block format). dictionary may be NULL.
+/// Returns the compressed length, or 0 if it doesn't fit in dstSize (COMPRESS_BLOCK_BOUND() always fits).
+/// </summary>
+size_t compressBlock(const uint8_t* src, size_t srcLen, uint8_t* dst, size_t dstSize, const CompressionDictionary* dictionary);
+
+/// <summary>
+/// Decompresses a block made by compressBlock() with the same dictionary. *dstLen gets the decompressed length.
+/// Safe for untrusted input.
+/// </summary>
+CompressionStatus decompressBlock(const uint8_t* src, size_t srcLen, uint8_t* dst, size_t dstSize, size_t* dstLen,
+	const CompressionDictionary* dictionary);
+
+/// <summary>
+/// Writes srcLen bytes as a frame, compressed with the given dictionary if that makes it smaller.
+/// Returns the frame length, or 0 if dstSize is less than COMPRESSION_FRAME_BOUND(srcLen) or the dictionary id is unknown.
+/// </summary>
+size_t compressFrame(const uint8_t* src, size_t srcLen, uint8_t dictionaryId, uint8_t* dst, size_t dstSize);
+
+/// <summary>
+/// Writes a frame header to the first COMPRESSION_FRAME_HEADER_SIZE bytes of dst.
+/// With COMPRESSION_METHOD_STORED the data can then be written after it as is, without a copy.
+/// </summary>
+void writeFrameHeader(uint8_t* dst, uint8_t method, uint8_t dictionaryId, uint32_t rawLen, uint32_t blockLen);
+
+/// <summary>
+/// Reads a frame header. *rawLen gets the decompressed length and *frameLen the length of the whole frame.
+/// A raw length the block can't decompress to gives COMPRESSION_MALFORMED, so a bad header can't make callers allocate for it.
+/// </summary>
+CompressionStatus getFrameInfo(const uint8_t* src, size_t srcLen, size_t* rawLen, size_t* frameLen);
+
+/// <summary>
+/// Decompresses a frame made by compressFrame(). *dstLen gets the decompressed length. Safe for untrusted input.
+/// </summary>
+CompressionStatus decompressFrame(const uint8_t* src, size_t srcLen, uint8_t* dst, size_t dstSize, size_t* dstLen);
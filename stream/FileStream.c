@@ -0,0 +1,254 @@
+// FileStream.c - Reading and writing records (optionally compressed) to files
+// (C) - Charles Machalow via the MIT License
+
+#include "FileStream.h"
+
+bool writeRecord(FILE* file, const uint8_t* record, size_t recordLen, uint8_t dictionaryId, bool compress)
+{
+	if (recordLen > UINT32_MAX)
+	{
+		return false;
+	}
+
+	if (!compress)
+	{
+		// Stored records go straight from the caller's buffer
+		uint8_t header[COMPRESSION_FRAME_HEADER_SIZE];
+		writeFrameHeader(header, COMPRESSION_METHOD_STORED, COMPRESSION_DICT_NONE, (uint32_t)recordLen, (uint32_t)recordLen);
+		return fwrite(header, 1, sizeof(header), file) == sizeof(header) && fwrite(record, 1, recordLen, file) == recordLen;
+	}
+
+	size_t frameSize = COMPRESSION_FRAME_BOUND(recordLen);
+	uint8_t* frame = (uint8_t*)memAlloc(frameSize);
+	if (!frame)
+	{
+		return false;
+	}
+
+	size_t frameLen = compressFrame(record, recordLen, dictionaryId, frame, frameSize);
+	bool written = frameLen && fwrite(frame, 1, frameLen, file) == frameLen;
+	memFree(frame);
+	return written;
+}
+
+// A frame's payload is read in pieces that start this big and double, so a corrupt length in the header can't make
+// readRecord() allocate much more than the file really holds
+#define READ_RECORD_FIRST_PIECE (64 * 1024)
+
+// Reads len bytes after prefixLen bytes of room into a new buffer (of at least a byte) that must be freed with memFree
+static FileStreamStatus readPayload(FILE* file, size_t prefixLen, size_t len, uint8_t** out)
+{
+	size_t capacity = prefixLen + (len < READ_RECORD_FIRST_PIECE ? len : READ_RECORD_FIRST_PIECE);
+	uint8_t* buffer = (uint8_t*)memAlloc(capacity ? capacity : 1);
+	size_t used = prefixLen;
+	while (buffer)
+	{
+		size_t want = capacity - used;
+		if (fread(buffer + used, 1, want, file) != want)
+		{
+			memFree(buffer);
+			return ferror(file) ? FILE_STREAM_IO_ERROR : FILE_STREAM_BAD_FRAME;
+		}
+		used = capacity;
+		if (used - prefixLen == len)
+		{
+			*out = buffer;
+			return FILE_STREAM_OK;
+		}
+
+		size_t left = len - (used - prefixLen);
+		size_t grow = (used - prefixLen) < left ? (used - prefixLen) : left;
+		uint8_t* bigger = (uint8_t*)memRealloc(buffer, capacity + grow);
+		if (!bigger)
+		{
+			memFree(buffer);
+			return FILE_STREAM_NO_MEMORY;
+		}
+		buffer = bigger;
+		capacity += grow;
+	}
+	return FILE_STREAM_NO_MEMORY;
+}
+
+FileStreamStatus readRecord(FILE* file, uint8_t** record, size_t* recordLen)
+{
+	uint8_t header[COMPRESSION_FRAME_HEADER_SIZE];
+	size_t headerLen = fread(header, 1, sizeof(header), file);
+	if (headerLen != sizeof(header))
+	{
+		if (ferror(file))
+		{
+			return FILE_STREAM_IO_ERROR;
+		}
+		return headerLen == 0 ? FILE_STREAM_END : FILE_STREAM_BAD_FRAME;
+	}
+
+	size_t rawLen = 0;
+	size_t frameLen = 0;
+	if (getFrameInfo(header, sizeof(header), &rawLen, &frameLen) != COMPRESSION_OK)
+	{
+		return FILE_STREAM_BAD_FRAME;
+	}
+
+	// Stored records are read straight into the record
+	uint8_t* raw = NULL;
+	if (header[2] == COMPRESSION_METHOD_STORED)
+	{
+		FileStreamStatus status = readPayload(file, 0, rawLen, &raw);
+		if (status != FILE_STREAM_OK)
+		{
+			return status;
+		}
+		*record = raw;
+		*recordLen = rawLen;
+		return FILE_STREAM_OK;
+	}
+
+	// The block has been read by the time the record is allocated, and getFrameInfo() bounds rawLen by its length
+	uint8_t* frame = NULL;
+	FileStreamStatus status = readPayload(file, sizeof(header), frameLen - COMPRESSION_FRAME_HEADER_SIZE, &frame);
+	if (status != FILE_STREAM_OK)
+	{
+		return status;
+	}
+	memcpy(frame, header, sizeof(header));
+
+	// Always have at least a byte so a zero length record still gives back a buffer
+	size_t decompressedLen = 0;
+	if (!(raw = (uint8_t*)memAlloc(rawLen ? rawLen : 1)))
+	{
+		status = FILE_STREAM_NO_MEMORY;
+	}
+	else if (decompressFrame(frame, frameLen, raw, rawLen, &decompressedLen) != COMPRESSION_OK)
+	{
+		status = FILE_STREAM_BAD_FRAME;
+	}
+
+	memFree(frame);
+	if (status != FILE_STREAM_OK)
+	{
+		memFree(raw);
+		return status;
+	}
+	*record = raw;
+	*recordLen = rawLen;
+	return FILE_STREAM_OK;
+}
+
+bool writeSDDSRecord(FILE* file, SDDS* sdds, SDDSRecordFormat format, bool compress)
+{
+	uint8_t* record = NULL;
+	size_t recordLen = 0;
+	uint8_t dictionaryId = COMPRESSION_DICT_NONE;
+	if (format == SDDS_RECORD_XML)
+	{
+		record = (uint8_t*)toXml(sdds);
+		recordLen = (size_t)getXmlSize(sdds);
+		dictionaryId = COMPRESSION_DICT_SDDS_XML;
+	}
+	else
+	{
+		record = toBinary(sdds);
+		recordLen = (size_t)getBinarySize(sdds);
+	}
+	if (!record)
+	{
+		return false;
+	}
+
+	bool written = writeRecord(file, record, recordLen, dictionaryId, compress);
+	memFree(record);
+	return written;
+}
+
+BatchWriterStatus batchWriteSDDSRecord(BatchWriter* writer, SDDS* sdds, SDDSRecordFormat format, bool compress)
+{
+	size_t recordLen = (size_t)((format == SDDS_RECORD_XML) ? getXmlSize(sdds) : getBinarySize(sdds));
+	if (recordLen > UINT32_MAX)
+	{
+		return BATCH_WRITER_IO_ERROR;
+	}
+
+	// The frame goes into the writer's buffer; writeXml() needs one more byte for its null char
+	size_t frameSize = COMPRESSION_FRAME_BOUND(recordLen) + 1;
+	uint8_t* frame = compress ? NULL : batchWriterReserve(writer, frameSize);
+	if (frame)
+	{
+		writeFrameHeader(frame, COMPRESSION_METHOD_STORED, COMPRESSION_DICT_NONE, (uint32_t)recordLen, (uint32_t)recordLen);
+		uint8_t* record = frame + COMPRESSION_FRAME_HEADER_SIZE;
+		if (format == SDDS_RECORD_XML)
+		{
+			writeXml(sdds, (char*)record, recordLen + 1);
+		}
+		else
+		{
+			writeBinary(sdds, record, recordLen);
+		}
+		return batchWriterCommit(writer, COMPRESSION_FRAME_HEADER_SIZE + recordLen);
+	}
+	if (writer->Status != BATCH_WRITER_OK)
+	{
+		return writer->Status;
+	}
+
+	// Compressed (or too big for a buffer): serialize, then frame it into the buffer if it fits
+	uint8_t* record = (format == SDDS_RECORD_XML) ? (uint8_t*)toXml(sdds) : toBinary(sdds);
+	if (!record)
+	{
+		return BATCH_WRITER_NO_MEMORY;
+	}
+	uint8_t dictionaryId = (format == SDDS_RECORD_XML) ? COMPRESSION_DICT_SDDS_XML : COMPRESSION_DICT_NONE;
+	BatchWriterStatus status = BATCH_WRITER_NO_MEMORY;
+	frameSize = COMPRESSION_FRAME_BOUND(recordLen);
+	if (compress && (frame = batchWriterReserve(writer, frameSize)) != NULL)
+	{
+		status = batchWriterCommit(writer, compressFrame(record, recordLen, dictionaryId, frame, frameSize));
+	}
+	else if (writer->Status != BATCH_WRITER_OK)
+	{
+		status = writer->Status;
+	}
+	else if ((frame = (uint8_t*)memAlloc(frameSize)) != NULL)
+	{
+		size_t frameLen = compress ? compressFrame(record, recordLen, dictionaryId, frame, frameSize) : 0;
+		if (!frameLen)
+		{
+			writeFrameHeader(frame, COMPRESSION_METHOD_STORED, COMPRESSION_DICT_NONE, (uint32_t)recordLen, (uint32_t)recordLen);
+			memcpy(frame + COMPRESSION_FRAME_HEADER_SIZE, record, recordLen);
+			frameLen = frameSize;
+		}
+		status = batchWriterWrite(writer, frame, frameLen);
+		memFree(frame);
+	}
+	memFree(record);
+	return status;
+}
+
+FileStreamStatus readSDDSRecord(FILE* file, SDDS* sdds)
+{
+	uint8_t* record = NULL;
+	size_t recordLen = 0;
+	FileStreamStatus status = readRecord(file, &record, &recordLen);
+	if (status != FILE_STREAM_OK)
+	{
+		return status;
+	}
+
+	// Binary records start with their magic, anything else is taken as xml
+	SDDSParseStatus parseStatus;
+	if (recordLen >= CONST_STR_LEN(SDDS_BINARY_MAGIC) && memcmp(record, SDDS_BINARY_MAGIC, CONST_STR_LEN(SDDS_BINARY_MAGIC)) == 0)
+	{
+		parseStatus = fromBinary(sdds, record, recordLen);
+	}
+	else
+	{
+		parseStatus = fromXml(sdds, (const char*)record, recordLen);
+	}
+	memFree(record);
+
+	if (parseStatus == SDDS_PARSE_NO_MEMORY)
+	{
+		return FILE_STREAM_NO_MEMORY;
+	}
+	return parseStatus == SDDS_PARSE_OK ? FILE_STREAM_OK : FILE_STREAM_BAD_RECORD;
+}
@@ -0,0 +1,60 @@
+// FileStream.h - Reading and writing records (optionally compressed) to files
+// (C) - Charles Machalow via the MIT License
+#pragma once
+
+#include <stdio.h>
+
+#include "BatchWriter.h"
+#include "Compression.h"
+#include "SDDS.h"
+
+// A file is a run of records, each a compression frame (see Compression.h)
+
+/// <summary>
+/// Result of reading a record
+/// </summary>
+typedef enum FileStreamStatus {
+	FILE_STREAM_OK = 0,
+	FILE_STREAM_END,        // No more records
+	FILE_STREAM_IO_ERROR,   // Reading failed
+	FILE_STREAM_NO_MEMORY,  // An allocation failed
+	FILE_STREAM_BAD_FRAME,  // The frame is truncated or doesn't decompress
+	FILE_STREAM_BAD_RECORD  // The record doesn't parse
+} FileStreamStatus;
+
+/// <summary>
+/// How an SDDS is serialized into a record
+/// </summary>
+typedef enum SDDSRecordFormat {
+	SDDS_RECORD_XML = 0,
+	SDDS_RECORD_BINARY
+} SDDSRecordFormat;
+
+/// <summary>
+/// Writes a record. With compress it is compressed using the given dictionary (if that makes it smaller),
+/// otherwise it is written as is. Returns true on success.
+/// </summary>
+bool writeRecord(FILE* file, const uint8_t* record, size_t recordLen, uint8_t dictionaryId, bool compress);
+
+/// <summary>
+/// Reads the next record into a new buffer that must be freed (with memFree). Returns FILE_STREAM_END after the last one.
+/// The payload is read in growing pieces, so a corrupt or truncated header gives FILE_STREAM_BAD_FRAME after allocating
+/// about what the file holds rather than the length it claims.
+/// </summary>
+FileStreamStatus readRecord(FILE* file, uint8_t** record, size_t* recordLen);
+
+/// <summary>
+/// Serializes the SDDS and writes it as a record. Xml records are compressed with the SDDS xml dictionary.
+/// </summary>
+bool writeSDDSRecord(FILE* file, SDDS* sdds, SDDSRecordFormat format, bool compress);
+
+/// <summary>
+/// writeSDDSRecord() into a BatchWriter, so records cost a copy into its buffer rather than a write call each.
+/// Uncompressed records are serialized straight into the buffer.
+/// </summary>
+BatchWriterStatus batchWriteSDDSRecord(BatchWriter* writer, SDDS* sdds, SDDSRecordFormat format, bool compress);
+
+/// <summary>
+/// Reads the next record into an empty SDDS. Xml and binary records are both understood.
+/// </summary>
+FileStreamStatus readSDDSRecord(FILE* file, SDDS* sdds);
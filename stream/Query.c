@@ -0,0 +1,651 @@
+// Query.c - Finds the records of a stream that match a filter, without decoding the ones that don't
+// (C) - Charles Machalow via the MIT License
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE 1 // sysconf(_SC_NPROCESSORS_ONLN)
+#endif
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#include "CFListReader.h"
+#include "Compression.h"
+#include "Query.h"
+#include "SDDS.h"
+
+// Conditions already passed by a record are tracked in a bit mask
+#define QUERY_MAX_CONDITIONS 64
+
+/*
+*
+* Conditions
+*
+*/
+
+static QueryCondition makeCondition(const char* name, QueryOp op, QueryValueType type)
+{
+	QueryCondition condition;
+	memset(&condition, 0, sizeof(condition));
+	condition.Name = name;
+	condition.NameLen = strlen(name);
+	condition.Op = op;
+	condition.Type = type;
+	return condition;
+}
+
+QueryCondition querySignedCondition(const char* name, QueryOp op, int64_t value)
+{
+	QueryCondition condition = makeCondition(name, op, QUERY_VALUE_INTEGER);
+	condition.Negative = value < 0;
+	condition.Magnitude = value < 0 ? (0 - (uint64_t)value) : (uint64_t)value;
+	return condition;
+}
+
+QueryCondition queryUnsignedCondition(const char* name, QueryOp op, uint64_t value)
+{
+	QueryCondition condition = makeCondition(name, op, QUERY_VALUE_INTEGER);
+	condition.Magnitude = value;
+	return condition;
+}
+
+QueryCondition queryBooleanCondition(const char* name, bool value)
+{
+	QueryCondition condition = makeCondition(name, QUERY_EQ, QUERY_VALUE_BOOLEAN);
+	condition.Boolean = value;
+	return condition;
+}
+
+QueryCondition queryStringCondition(const char* name, QueryOp op, const char* value)
+{
+	QueryCondition condition = makeCondition(name, op, QUERY_VALUE_STRING);
+	condition.String = value;
+	condition.StringLen = strlen(value);
+	return condition;
+}
+
+QueryCondition queryExistsCondition(const char* name)
+{
+	return makeCondition(name, QUERY_EXISTS, QUERY_VALUE_NONE);
+}
+
+// Applies op to the result of comparing the field's value with the condition's (-1, 0 or 1)
+static bool applyOp(QueryOp op, int comparison)
+{
+	switch (op)
+	{
+	case QUERY_EQ:
+		return comparison == 0;
+	case QUERY_NE:
+		return comparison != 0;
+	case QUERY_LT:
+		return comparison < 0;
+	case QUERY_LE:
+		return comparison <= 0;
+	case QUERY_GT:
+		return comparison > 0;
+	case QUERY_GE:
+		return comparison >= 0;
+	default:
+		return true;
+	}
+}
+
+static bool testInteger(const QueryCondition* condition, bool negative, uint64_t magnitude)
+{
+	// -0 can't come out of a parse, so sign and magnitude order the same way as the numbers
+	int comparison;
+	if (negative != condition->Negative)
+	{
+		comparison = negative ? -1 : 1;
+	}
+	else
+	{
+		comparison = (magnitude > condition->Magnitude) - (magnitude < condition->Magnitude);
+		if (negative)
+		{
+			comparison = -comparison;
+		}
+	}
+	return applyOp(condition->Op, comparison);
+}
+
+static bool testBoolean(const QueryCondition* condition, bool value)
+{
+	return applyOp(condition->Op, value == condition->Boolean ? 0 : 1);
+}
+
+static bool testStringEquality(const QueryCondition* condition, bool equal)
+{
+	if (condition->Op != QUERY_EQ && condition->Op != QUERY_NE)
+	{
+		return false;
+	}
+	return (condition->Op == QUERY_EQ) == equal;
+}
+
+/*
+*
+* Matching a record
+*
+*/
+
+static bool testCFListField(const QueryCondition* condition, const CFListField* field)
+{
+	switch (condition->Type)
+	{
+	case QUERY_VALUE_INTEGER:
+	{
+		bool negative = field->ValueLen > 0 && field->Value[0] == '-';
+		uint64_t magnitude = 0;
+		if (negative)
+		{
+			int64_t value = 0;
+			if (cFListFieldToSigned(field, &value) != CFLIST_OK)
+			{
+				return false;
+			}
+			magnitude = 0 - (uint64_t)value;
+			negative = value < 0;
+		}
+		else if (cFListFieldToUnsigned(field, &magnitude) != CFLIST_OK)
+		{
+			return false;
+		}
+		return testInteger(condition, negative, magnitude);
+	}
+	case QUERY_VALUE_BOOLEAN:
+	{
+		bool value = false;
+		return cFListFieldToBoolean(field, &value) == CFLIST_OK && testBoolean(condition, value);
+	}
+	case QUERY_VALUE_STRING:
+		return field->Type == CFLIST_TYPE_STRING && testStringEquality(condition, cFListFieldEqualsString(field, condition->String, condition->StringLen));
+	default:
+		return true;
+	}
+}
+
+static bool testBinaryField(const QueryCondition* condition, const BYTE* data, uint32_t fieldSize, BYTE fieldType)
+{
+	uint32_t byteSize = (fieldSize + 7) / 8;
+	switch (condition->Type)
+	{
+	case QUERY_VALUE_INTEGER:
+	{
+		if ((fieldType != SDDS_TYPE_RAW && fieldType != SDDS_TYPE_U64 && fieldType != SDDS_TYPE_I64) || fieldSize == 0 || fieldSize > 64)
+		{
+			return false;
+		}
+		uint64_t value = 0;
+		uint32_t i = 0;
+		for (; i < byteSize; i++)
+		{
+			value |= (uint64_t)data[i] << (i * 8);
+		}
+		if (fieldSize < 64)
+		{
+			value &= (1ULL << fieldSize) - 1;
+		}
+		bool negative = fieldType == SDDS_TYPE_I64 && (value >> 63);
+		return testInteger(condition, negative, negative ? (0 - value) : value);
+	}
+	case QUERY_VALUE_BOOLEAN:
+		return fieldType == SDDS_TYPE_BOOL && fieldSize > 0 && testBoolean(condition, (data[0] & 1) != 0);
+	case QUERY_VALUE_STRING:
+	{
+		// Strings carry their null char; raw fields have to be whole bytes
+		size_t len = byteSize;
+		if (fieldType == SDDS_TYPE_STRING && len > 0)
+		{
+			len--;
+		}
+		else if (fieldType != SDDS_TYPE_RAW || fieldSize % 8 != 0)
+		{
+			return false;
+		}
+		return testStringEquality(condition, len == condition->StringLen && memcmp(data, condition->String, len) == 0);
+	}
+	default:
+		return true;
+	}
+}
+
+// Tests the conditions named name that haven't passed yet. Returns false as soon as one fails.
+#define TEST_NAMED_CONDITIONS(nameStr, nameLen, testCall) \
+	for (c = 0; c < conditionCount; c++) \
+	{ \
+		const QueryCondition* condition = &conditions[c]; \
+		if (!(passed & (1ULL << c)) && condition->NameLen == (nameLen) && memcmp(condition->Name, (nameStr), (nameLen)) == 0) \
+		{ \
+			if (!(testCall)) \
+			{ \
+				return false; \
+			} \
+			passed |= 1ULL << c; \
+		} \
+	}
+
+static bool matchCFList(const QueryCondition* conditions, size_t conditionCount, const uint8_t* record, size_t recordLen)
+{
+	const uint64_t allPassed = conditionCount == 64 ? UINT64_MAX : ((1ULL << conditionCount) - 1);
+	uint64_t passed = 0;
+	size_t c = 0;
+	CFListReader reader;
+	CFListField field;
+	CFListStatus status = cFListReaderInit(&reader, record, recordLen);
+
+	while (passed != allPassed && status == CFLIST_OK && (status = cFListNextField(&reader, &field)) == CFLIST_OK)
+	{
+		TEST_NAMED_CONDITIONS(field.Token, field.TokenLen, testCFListField(condition, &field));
+	}
+	return passed == allPassed;
+}
+
+static uint32_t loadU32(const BYTE* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return LITTLE_ENDIAN_32(value);
+}
+
+static bool matchBinary(const QueryCondition* conditions, size_t conditionCount, const uint8_t* record, size_t recordLen)
+{
+	const uint64_t allPassed = conditionCount == 64 ? UINT64_MAX : ((1ULL << conditionCount) - 1);
+	uint64_t passed = 0;
+	size_t c = 0;
+	const BYTE* cur = record + SDDS_BINARY_HEADER_SIZE;
+	const BYTE* end = record + recordLen;
+	if (recordLen < SDDS_BINARY_HEADER_SIZE || record[CONST_STR_LEN(SDDS_BINARY_MAGIC)] != SDDS_BINARY_VERSION)
+	{
+		return false;
+	}
+
+	// Walk the field entries in place: name length, name, size in bits, type, data
+	while (passed != allPassed && (size_t)(end - cur) >= sizeof(uint32_t))
+	{
+		uint32_t nameLen = loadU32(cur);
+		cur += sizeof(uint32_t);
+		if (nameLen == SDDS_BINARY_END_MARKER || (size_t)(end - cur) < (size_t)nameLen + sizeof(uint32_t) + sizeof(BYTE))
+		{
+			break;
+		}
+		const char* name = (const char*)cur;
+		cur += nameLen;
+		uint32_t fieldSize = loadU32(cur);
+		BYTE fieldType = cur[sizeof(uint32_t)];
+		cur += sizeof(uint32_t) + sizeof(BYTE);
+		size_t byteSize = ((size_t)fieldSize + 7) / 8;
+		if ((size_t)(end - cur) < byteSize)
+		{
+			break;
+		}
+
+		TEST_NAMED_CONDITIONS(name, nameLen, testBinaryField(condition, cur, fieldSize, fieldType));
+		cur += byteSize;
+	}
+	return passed == allPassed;
+}
+
+bool queryMatchRecord(const QueryCondition* conditions, size_t conditionCount, const uint8_t* record, size_t recordLen)
+{
+	if (conditionCount > QUERY_MAX_CONDITIONS)
+	{
+		return false;
+	}
+	if (recordLen >= CONST_STR_LEN(SDDS_BINARY_MAGIC) && memcmp(record, SDDS_BINARY_MAGIC, CONST_STR_LEN(SDDS_BINARY_MAGIC)) == 0)
+	{
+		return matchBinary(conditions, conditionCount, record, recordLen);
+	}
+	if (recordLen >= CONST_STR_LEN(START_XML) && memcmp(record, START_XML, CONST_STR_LEN(START_XML)) == 0)
+	{
+		return matchCFList(conditions, conditionCount, record, recordLen);
+	}
+	return false;
+}
+
+/*
+*
+* Scanning streams
+*
+*/
+
+// One contiguous run of frames and what was found in it
+typedef struct QueryChunk {
+	const QueryCondition* Conditions;
+	size_t ConditionCount;
+	const uint8_t* Stream;
+	size_t Start; // Offsets into Stream
+	size_t End;
+	uint64_t Records;
+	uint64_t Matches;
+	uint64_t* MatchOffsets;
+	size_t MatchCapacity;
+	uint8_t* Scratch;
+	size_t ScratchSize;
+	QueryStatus Status;
+} QueryChunk;
+
+static bool addMatch(QueryChunk* chunk, uint64_t offset)
+{
+	if (chunk->Matches == chunk->MatchCapacity)
+	{
+		size_t capacity = chunk->MatchCapacity ? chunk->MatchCapacity * 2 : 64;
+		uint64_t* offsets = (uint64_t*)memRealloc(chunk->MatchOffsets, capacity * sizeof(uint64_t));
+		if (!offsets)
+		{
+			return false;
+		}
+		chunk->MatchOffsets = offsets;
+		chunk->MatchCapacity = capacity;
+	}
+	chunk->MatchOffsets[chunk->Matches++] = offset;
+	return true;
+}
+
+// Returns the length of the frame at offset, or 0 if there isn't a whole one there
+static size_t getFrameLength(const uint8_t* stream, size_t offset, size_t end, size_t* rawLen)
+{
+	size_t frameLen = 0;
+	if (getFrameInfo(stream + offset, end - offset, rawLen, &frameLen) != COMPRESSION_OK || frameLen > end - offset)
+	{
+		return 0;
+	}
+	return frameLen;
+}
+
+static void scanChunk(QueryChunk* chunk)
+{
+	size_t offset = chunk->Start;
+	while (offset < chunk->End && chunk->Status == QUERY_OK)
+	{
+		size_t rawLen = 0;
+		size_t frameLen = getFrameLength(chunk->Stream, offset, chunk->End, &rawLen);
+		if (!frameLen)
+		{
+			chunk->Status = QUERY_BAD_FRAME;
+			break;
+		}
+
+		// Stored records are read where they are
+		const uint8_t* frame = chunk->Stream + offset;
+		const uint8_t* record = frame + COMPRESSION_FRAME_HEADER_SIZE;
+		if (frame[2] != COMPRESSION_METHOD_STORED)
+		{
+			if (rawLen > chunk->ScratchSize)
+			{
+				uint8_t* scratch = (uint8_t*)memRealloc(chunk->Scratch, rawLen);
+				if (!scratch)
+				{
+					chunk->Status = QUERY_NO_MEMORY;
+					break;
+				}
+				chunk->Scratch = scratch;
+				chunk->ScratchSize = rawLen;
+			}
+			size_t decompressedLen = 0;
+			if (decompressFrame(frame, frameLen, chunk->Scratch, chunk->ScratchSize, &decompressedLen) != COMPRESSION_OK)
+			{
+				chunk->Status = QUERY_BAD_FRAME;
+				break;
+			}
+			record = chunk->Scratch;
+		}
+
+		chunk->Records++;
+		if (queryMatchRecord(chunk->Conditions, chunk->ConditionCount, record, rawLen) && !addMatch(chunk, offset))
+		{
+			chunk->Status = QUERY_NO_MEMORY;
+		}
+		offset += frameLen;
+	}
+
+	memFree(chunk->Scratch);
+	chunk->Scratch = NULL;
+	chunk->ScratchSize = 0;
+}
+
+// Moves the chunks' findings into result, in stream order. The first chunk with an error gives the status.
+static QueryStatus gatherChunks(QueryChunk* chunks, uint32_t chunkCount, QueryResult* result)
+{
+	uint64_t matches = 0;
+	uint32_t i = 0;
+	for (; i < chunkCount; i++)
+	{
+		matches += chunks[i].Matches;
+	}
+
+	uint64_t* offsets = matches ? (uint64_t*)memAlloc((size_t)matches * sizeof(uint64_t)) : NULL;
+	QueryStatus status = (matches && !offsets) ? QUERY_NO_MEMORY : QUERY_OK;
+	for (i = 0; i < chunkCount; i++)
+	{
+		if (offsets && chunks[i].Matches)
+		{
+			memcpy(offsets + result->Matches, chunks[i].MatchOffsets, (size_t)chunks[i].Matches * sizeof(uint64_t));
+			result->Matches += chunks[i].Matches;
+		}
+		result->Records += chunks[i].Records;
+		memFree(chunks[i].MatchOffsets);
+		if (status == QUERY_OK)
+		{
+			status = chunks[i].Status;
+		}
+	}
+
+	result->MatchOffsets = offsets;
+	result->Status = status;
+	return status;
+}
+
+QueryStatus queryBuffer(const QueryCondition* conditions, size_t conditionCount, const uint8_t* stream, size_t streamLen, QueryResult* result)
+{
+	QueryChunk chunk;
+	memset(&chunk, 0, sizeof(chunk));
+	memset(result, 0, sizeof(*result));
+	chunk.Conditions = conditions;
+	chunk.ConditionCount = conditionCount;
+	chunk.Stream = stream;
+	chunk.End = streamLen;
+	scanChunk(&chunk);
+	return gatherChunks(&chunk, 1, result);
+}
+
+/*
+*
+* Scanning files on several threads
+*
+*/
+
+#ifdef _WIN32
+static DWORD WINAPI queryThread(LPVOID chunk)
+{
+	scanChunk((QueryChunk*)chunk);
+	return 0;
+}
+#else
+static void* queryThread(void* chunk)
+{
+	scanChunk((QueryChunk*)chunk);
+	return NULL;
+}
+#endif // _WIN32
+
+static uint32_t getProcessorCount(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (uint32_t)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (uint32_t)count : 1;
+#endif // _WIN32
+}
+
+// Splits the stream into chunkCount runs of whole frames of about the same size. Only frame headers are read.
+// If the framing breaks, the chunks after the break are empty except the last, which starts there and reports it.
+static void splitStream(const uint8_t* stream, size_t streamLen, QueryChunk* chunks, uint32_t chunkCount)
+{
+	size_t offset = 0;
+	bool broken = false;
+	uint32_t i = 1;
+	chunks[0].Start = 0;
+	for (; i < chunkCount; i++)
+	{
+		size_t target = (size_t)(((uint64_t)streamLen * i) / chunkCount);
+		while (!broken && offset < target)
+		{
+			size_t rawLen = 0;
+			size_t frameLen = getFrameLength(stream, offset, streamLen, &rawLen);
+			if (!frameLen)
+			{
+				broken = true;
+				break;
+			}
+			offset += frameLen;
+		}
+		chunks[i].Start = offset;
+		chunks[i - 1].End = offset;
+	}
+	chunks[chunkCount - 1].End = streamLen;
+}
+
+static QueryStatus queryStream(const QueryCondition* conditions, size_t conditionCount, const uint8_t* stream, size_t streamLen,
+	uint32_t threadCount, QueryResult* result)
+{
+	if (threadCount == 0)
+	{
+		threadCount = getProcessorCount();
+	}
+	if (threadCount > QUERY_MAX_THREADS)
+	{
+		threadCount = QUERY_MAX_THREADS;
+	}
+
+	QueryChunk chunks[QUERY_MAX_THREADS];
+	memset(chunks, 0, sizeof(chunks));
+	uint32_t i = 0;
+	for (; i < threadCount; i++)
+	{
+		chunks[i].Conditions = conditions;
+		chunks[i].ConditionCount = conditionCount;
+		chunks[i].Stream = stream;
+	}
+	splitStream(stream, streamLen, chunks, threadCount);
+
+	// The calling thread takes the first chunk. A thread that can't be started has its chunk done here too.
+#ifdef _WIN32
+	HANDLE threads[QUERY_MAX_THREADS] = { 0 };
+	for (i = 1; i < threadCount; i++)
+	{
+		threads[i] = CreateThread(NULL, 0, queryThread, &chunks[i], 0, NULL);
+	}
+	scanChunk(&chunks[0]);
+	for (i = 1; i < threadCount; i++)
+	{
+		if (threads[i])
+		{
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+		}
+		else
+		{
+			scanChunk(&chunks[i]);
+		}
+	}
+#else
+	pthread_t threads[QUERY_MAX_THREADS];
+	bool started[QUERY_MAX_THREADS] = { false };
+	for (i = 1; i < threadCount; i++)
+	{
+		started[i] = pthread_create(&threads[i], NULL, queryThread, &chunks[i]) == 0;
+	}
+	scanChunk(&chunks[0]);
+	for (i = 1; i < threadCount; i++)
+	{
+		if (started[i])
+		{
+			pthread_join(threads[i], NULL);
+		}
+		else
+		{
+			scanChunk(&chunks[i]);
+		}
+	}
+#endif // _WIN32
+
+	return gatherChunks(chunks, threadCount, result);
+}
+
+QueryStatus queryFile(const QueryCondition* conditions, size_t conditionCount, const char* path, uint32_t threadCount, QueryResult* result)
+{
+	memset(result, 0, sizeof(*result));
+	QueryStatus status = QUERY_IO_ERROR;
+
+#ifdef _WIN32
+	// Read it all in
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		result->Status = status;
+		return status;
+	}
+	uint8_t* stream = NULL;
+	long fileSize = -1;
+	if (fseek(file, 0, SEEK_END) == 0 && (fileSize = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0)
+	{
+		stream = (uint8_t*)memAlloc(fileSize ? (size_t)fileSize : 1);
+		if (!stream)
+		{
+			status = QUERY_NO_MEMORY;
+		}
+		else if (fread(stream, 1, (size_t)fileSize, file) == (size_t)fileSize)
+		{
+			status = queryStream(conditions, conditionCount, stream, (size_t)fileSize, threadCount, result);
+		}
+	}
+	memFree(stream);
+	fclose(file);
+#else
+	// Map it, so the threads read straight from the page cache
+	int fd = open(path, O_RDONLY);
+	struct stat info;
+	if (fd < 0)
+	{
+		result->Status = status;
+		return status;
+	}
+	if (fstat(fd, &info) == 0)
+	{
+		size_t fileSize = (size_t)info.st_size;
+		void* stream = fileSize ? mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+		if (fileSize == 0)
+		{
+			status = QUERY_OK;
+		}
+		else if (stream != MAP_FAILED)
+		{
+			status = queryStream(conditions, conditionCount, (const uint8_t*)stream, fileSize, threadCount, result);
+			munmap(stream, fileSize);
+		}
+	}
+	close(fd);
+#endif // _WIN32
+
+	result->Status = status;
+	return status;
+}
+
+void queryResultFree(QueryResult* result)
+{
+	memFree(result->MatchOffsets);
+	memset(result, 0, sizeof(*result));
+}
@@ -0,0 +1,118 @@
+// Query.h - Finds the records of a stream that match a filter, without decoding the ones that don't
+// (C) - Charles Machalow via the MIT License
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Most threads queryFile() splits a file between
+#define QUERY_MAX_THREADS 64
+
+/// <summary>
+/// Result of a query. Nothing here asserts; every problem comes back as one of these.
+/// </summary>
+typedef enum QueryStatus {
+	QUERY_OK = 0,
+	QUERY_IO_ERROR,  // The file can't be opened or read
+	QUERY_NO_MEMORY, // An allocation (or starting a thread) failed
+	QUERY_BAD_FRAME  // The stream isn't a run of frames (records before it were still checked)
+} QueryStatus;
+
+/// <summary>
+/// How a condition compares the field's value with its own
+/// </summary>
+typedef enum QueryOp {
+	QUERY_EQ = 0,
+	QUERY_NE,
+	QUERY_LT,
+	QUERY_LE,
+	QUERY_GT,
+	QUERY_GE,
+	QUERY_EXISTS // Only that the field is there
+} QueryOp;
+
+/// <summary>
+/// What a condition's value is
+/// </summary>
+typedef enum QueryValueType {
+	QUERY_VALUE_NONE = 0, // QUERY_EXISTS
+	QUERY_VALUE_INTEGER,  // Matches Integer cFList fields and U64, I64 or raw (up to 64 bit, little endian) SDDS fields
+	QUERY_VALUE_BOOLEAN,  // Matches Boolean cFList fields and BOOL SDDS fields
+	QUERY_VALUE_STRING    // Matches String cFList fields and STRING or raw SDDS fields (only with QUERY_EQ and QUERY_NE)
+} QueryValueType;
+
+/// <summary>
+/// One test on one field: a cFList token or an SDDS field name. Make these with the query*Condition functions.
+/// A record matches a filter when it passes every condition. A field that is missing, or of a type the value
+/// doesn't apply to, fails its condition (whatever the op).
+/// </summary>
+typedef struct QueryCondition {
+	const char* Name;
+	size_t NameLen;
+	QueryOp Op;
+	QueryValueType Type;
+	bool Negative;      // Integers are kept as a sign and magnitude, so any int64_t or uint64_t can be compared
+	uint64_t Magnitude;
+	bool Boolean;
+	const char* String;
+	size_t StringLen;
+} QueryCondition;
+
+/// <summary>
+/// Where the matches of a query are. Free with queryResultFree().
+/// </summary>
+typedef struct QueryResult {
+	uint64_t Records;       // Records looked at
+	uint64_t Matches;
+	uint64_t* MatchOffsets; // Offset of each matching record's frame, in stream order
+	QueryStatus Status;
+} QueryResult;
+
+/// <summary>
+/// Compares a field with a signed value
+/// </summary>
+QueryCondition querySignedCondition(const char* name, QueryOp op, int64_t value);
+
+/// <summary>
+/// Compares a field with an unsigned value
+/// </summary>
+QueryCondition queryUnsignedCondition(const char* name, QueryOp op, uint64_t value);
+
+/// <summary>
+/// Checks a boolean field is the given value
+/// </summary>
+QueryCondition queryBooleanCondition(const char* name, bool value);
+
+/// <summary>
+/// Checks a string field is (QUERY_EQ) or isn't (QUERY_NE) the given null terminated value
+/// </summary>
+QueryCondition queryStringCondition(const char* name, QueryOp op, const char* value);
+
+/// <summary>
+/// Checks the field is there
+/// </summary>
+QueryCondition queryExistsCondition(const char* name);
+
+/// <summary>
+/// Returns true if a record (a cFList document or toBinary() output, as it is inside its frame) passes every condition.
+/// The record's fields are read in place and it stops at the first condition that fails. Other records never match.
+/// </summary>
+bool queryMatchRecord(const QueryCondition* conditions, size_t conditionCount, const uint8_t* record, size_t recordLen);
+
+/// <summary>
+/// Runs the filter over a stream of frames in memory (like the contents of a file written by writeRecord()).
+/// Stored frames are checked in place; compressed ones are decompressed into a scratch buffer first.
+/// </summary>
+QueryStatus queryBuffer(const QueryCondition* conditions, size_t conditionCount, const uint8_t* stream, size_t streamLen, QueryResult* result);
+
+/// <summary>
+/// queryBuffer() over a file, split between threadCount threads (0 for one per processor, at most QUERY_MAX_THREADS).
+/// The file is mapped rather than read where possible.
+/// </summary>
+QueryStatus queryFile(const QueryCondition* conditions, size_t conditionCount, const char* path, uint32_t threadCount, QueryResult* result);
+
+/// <summary>
+/// Frees what a query put in result
+/// </summary>
+void queryResultFree(QueryResult* result);
@@ -0,0 +1,190 @@
+// RingBuffer.c - Bounded lock free ring buffer of variable length records
+// (C) - Charles Machalow via the MIT License
+//
+// Each record is a header (size to the next record, then length + 1) followed by the data, padded to RING_BUFFER_ALIGNMENT.
+// A length word of 0 means the record isn't committed yet and RING_RECORD_PADDING means skip it.
+// With one producer, Head only moves on commit, so everything before it is complete.
+// With many producers, Head moves on reserve and each record's length word says when it is ready. The consumer zeroes what it
+// releases so a length word left over from the last trip around the ring is never mistaken for a committed record.
+
+#include <string.h>
+
+#include "Atomics.h"
+#include "RingBuffer.h"
+
+#define RING_RECORD_PADDING 0xFFFFFFFF
+
+static uint32_t alignRecord(uint32_t size)
+{
+	return (size + (RING_BUFFER_ALIGNMENT - 1)) & ~(uint32_t)(RING_BUFFER_ALIGNMENT - 1);
+}
+
+static uint32_t* recordSize(RingBuffer* ring, uint32_t position)
+{
+	return (uint32_t*)(ring->Buffer + (position & ring->Mask));
+}
+
+static volatile uint32_t* recordLength(RingBuffer* ring, uint32_t position)
+{
+	return (volatile uint32_t*)(ring->Buffer + (position & ring->Mask) + sizeof(uint32_t));
+}
+
+bool ringBufferInit(RingBuffer* ring, uint8_t* buffer, uint32_t capacity, bool multiProducer)
+{
+	if (capacity < 64 || (capacity & (capacity - 1)) || ((uintptr_t)buffer % RING_BUFFER_ALIGNMENT))
+	{
+		return false;
+	}
+
+	memset(ring, 0, sizeof(*ring));
+	memset(buffer, 0, capacity);
+	ring->Buffer = buffer;
+	ring->Capacity = capacity;
+	ring->Mask = capacity - 1;
+	ring->MultiProducer = multiProducer;
+	return true;
+}
+
+// Half the ring, so a record that has to skip the end of the buffer still fits in an empty ring
+uint32_t ringBufferMaxRecordSize(const RingBuffer* ring)
+{
+	return (ring->Capacity / 2) - RING_BUFFER_HEADER_SIZE;
+}
+
+bool ringBufferReserve(RingBuffer* ring, uint32_t maxLength, RingReservation* reservation)
+{
+	if (maxLength > ringBufferMaxRecordSize(ring))
+	{
+		return false;
+	}
+
+	uint32_t need = alignRecord(RING_BUFFER_HEADER_SIZE + maxLength);
+	uint32_t head;
+	uint32_t skip;
+	for (;;)
+	{
+		// Tail first, so head can't be behind it
+		uint32_t tail = atomicLoadAcquire32(&ring->Tail);
+		head = ring->MultiProducer ? atomicLoadAcquire32(&ring->Head) : ring->Head;
+
+		// A record never wraps, so skip what is left at the end if it doesn't fit there
+		uint32_t toEnd = ring->Capacity - (head & ring->Mask);
+		skip = need > toEnd ? toEnd : 0;
+		if ((head - tail) + skip + need > ring->Capacity)
+		{
+			return false;
+		}
+		if (!ring->MultiProducer || atomicCompareExchange32(&ring->Head, head, head + skip + need))
+		{
+			break;
+		}
+	}
+
+	if (ring->MultiProducer && skip)
+	{
+		// The skipped bytes are ours, so hand them to the consumer right away
+		*recordSize(ring, head) = skip;
+		atomicStoreRelease32(recordLength(ring, head), RING_RECORD_PADDING);
+		head += skip;
+		skip = 0;
+	}
+	if (ring->MultiProducer)
+	{
+		*recordSize(ring, head) = need;
+	}
+
+	reservation->Position = head;
+	reservation->Skipped = skip;
+	reservation->Data = ring->Buffer + ((head + skip) & ring->Mask) + RING_BUFFER_HEADER_SIZE;
+	reservation->Capacity = need - RING_BUFFER_HEADER_SIZE;
+	return true;
+}
+
+void ringBufferCommit(RingBuffer* ring, RingReservation* reservation, uint32_t length)
+{
+	if (ring->MultiProducer)
+	{
+		atomicStoreRelease32(recordLength(ring, reservation->Position), length + 1);
+		return;
+	}
+
+	// One producer: only take up as much as was used, then publish everything at once
+	uint32_t position = reservation->Position;
+	if (reservation->Skipped)
+	{
+		*recordSize(ring, position) = reservation->Skipped;
+		*recordLength(ring, position) = RING_RECORD_PADDING;
+		position += reservation->Skipped;
+	}
+	uint32_t size = alignRecord(RING_BUFFER_HEADER_SIZE + length);
+	*recordSize(ring, position) = size;
+	*recordLength(ring, position) = length + 1;
+	atomicStoreRelease32(&ring->Head, position + size);
+}
+
+void ringBufferAbandon(RingBuffer* ring, RingReservation* reservation)
+{
+	// With one producer nothing was published, so there is nothing to undo
+	if (ring->MultiProducer)
+	{
+		atomicStoreRelease32(recordLength(ring, reservation->Position), RING_RECORD_PADDING);
+	}
+}
+
+bool ringBufferWrite(RingBuffer* ring, const void* record, uint32_t length)
+{
+	RingReservation reservation;
+	if (!ringBufferReserve(ring, length, &reservation))
+	{
+		return false;
+	}
+	memcpy(reservation.Data, record, length);
+	ringBufferCommit(ring, &reservation, length);
+	return true;
+}
+
+// Moves the consumer past size bytes at tail
+static void releaseRecord(RingBuffer* ring, uint32_t tail, uint32_t size)
+{
+	if (ring->MultiProducer)
+	{
+		memset(ring->Buffer + (tail & ring->Mask), 0, size);
+	}
+	atomicStoreRelease32(&ring->Tail, tail + size);
+}
+
+bool ringBufferPeek(RingBuffer* ring, const uint8_t** data, uint32_t* length)
+{
+	for (;;)
+	{
+		uint32_t tail = ring->Tail;
+		if (!ring->MultiProducer && tail == atomicLoadAcquire32(&ring->Head))
+		{
+			return false;
+		}
+
+		uint32_t lengthWord = atomicLoadAcquire32(recordLength(ring, tail));
+		if (lengthWord == 0)
+		{
+			return false;
+		}
+
+		uint32_t size = *recordSize(ring, tail);
+		if (lengthWord == RING_RECORD_PADDING)
+		{
+			releaseRecord(ring, tail, size);
+			continue;
+		}
+
+		*data = ring->Buffer + (tail & ring->Mask) + RING_BUFFER_HEADER_SIZE;
+		*length = lengthWord - 1;
+		ring->PeekedSize = size;
+		return true;
+	}
+}
+
+void ringBufferRelease(RingBuffer* ring)
+{
+	releaseRecord(ring, ring->Tail, ring->PeekedSize);
+	ring->PeekedSize = 0;
+}
@@ -0,0 +1,88 @@
+// RingBuffer.h - Bounded lock free ring buffer of variable length records
+// (C) - Charles Machalow via the MIT License
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Records are aligned to this, and each has a header of this size in front of it
+#define RING_BUFFER_ALIGNMENT     8
+#define RING_BUFFER_HEADER_SIZE   8
+
+// Keeps the producer and consumer cursors on their own cache lines
+#define RING_BUFFER_CACHE_LINE    64
+
+/// <summary>
+/// A ring of variable length records in caller memory. Producers reserve a contiguous slot, encode straight into it
+/// (with START_CFLIST or writeBinary() for instance) and commit it. The consumer reads records in place and releases them.
+/// With MultiProducer any number of threads can produce at once; otherwise there must be only one producer thread.
+/// START_CFLIST and the add*FieldToBuffer functions keep no shared state (each thread has its own template cache),
+/// so every producer can encode into its own slot at the same time. The gpBuf functions share one buffer and can't.
+/// There is always only one consumer thread. Nothing here locks or allocates.
+/// </summary>
+typedef struct RingBuffer {
+	uint8_t* Buffer;
+	uint32_t Capacity;      // Power of two
+	uint32_t Mask;
+	bool MultiProducer;
+	uint8_t Padding0[RING_BUFFER_CACHE_LINE];
+	volatile uint32_t Head; // Producer cursor (with one producer, only committed records are before it)
+	uint8_t Padding1[RING_BUFFER_CACHE_LINE - sizeof(uint32_t)];
+	volatile uint32_t Tail; // Consumer cursor
+	uint32_t PeekedSize;    // Size of the record the consumer is looking at (consumer only)
+	uint8_t Padding2[RING_BUFFER_CACHE_LINE - (2 * sizeof(uint32_t))];
+} RingBuffer;
+
+/// <summary>
+/// A slot handed out by ringBufferReserve(). Write up to Capacity bytes to Data, then commit it.
+/// </summary>
+typedef struct RingReservation {
+	uint8_t* Data;
+	uint32_t Capacity;
+	uint32_t Position; // Where the slot's header is (cursor value)
+	uint32_t Skipped;  // Bytes at the end of the buffer skipped so the slot is contiguous (only used with one producer)
+} RingReservation;
+
+/// <summary>
+/// Sets up a ring over buffer. capacity must be a power of two of at least 64 and buffer must be 8 byte aligned.
+/// Returns false if they aren't.
+/// </summary>
+bool ringBufferInit(RingBuffer* ring, uint8_t* buffer, uint32_t capacity, bool multiProducer);
+
+/// <summary>
+/// Returns the largest record that can ever be reserved
+/// </summary>
+uint32_t ringBufferMaxRecordSize(const RingBuffer* ring);
+
+/// <summary>
+/// Reserves a contiguous slot for a record of up to maxLength bytes. Returns false if the ring is too full right now.
+/// With one producer, the slot must be committed before the next reserve.
+/// </summary>
+bool ringBufferReserve(RingBuffer* ring, uint32_t maxLength, RingReservation* reservation);
+
+/// <summary>
+/// Publishes a reserved slot holding length bytes (length can be less than what was reserved).
+/// </summary>
+void ringBufferCommit(RingBuffer* ring, RingReservation* reservation, uint32_t length);
+
+/// <summary>
+/// Gives a reserved slot back without publishing a record
+/// </summary>
+void ringBufferAbandon(RingBuffer* ring, RingReservation* reservation);
+
+/// <summary>
+/// Reserves, copies and commits a record. Returns false if the ring is too full right now.
+/// </summary>
+bool ringBufferWrite(RingBuffer* ring, const void* record, uint32_t length);
+
+/// <summary>
+/// Points data at the next record without copying it. Returns false if there isn't one yet.
+/// The record stays valid until ringBufferRelease(). Consumer thread only.
+/// </summary>
+bool ringBufferPeek(RingBuffer* ring, const uint8_t** data, uint32_t* length);
+
+/// <summary>
+/// Frees the record given by the last ringBufferPeek() so producers can reuse its space. Consumer thread only.
+/// </summary>
+void ringBufferRelease(RingBuffer* ring);
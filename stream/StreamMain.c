@@ -0,0 +1,404 @@
+// StreamMain.c - Example usage of the compressed file stream
+// (C) - Charles Machalow via the MIT License
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // fileno
+#endif
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif // _WIN32
+
+#include "CFListReader.h"
+#include "FileStream.h"
+#include "Query.h"
+#include "RingBuffer.h"
+#include "StaticSDDS.h"
+
+#define RECORD_COUNT 100
+#define RING_SIZE 4096
+#define ARCHIVE_RECORD_COUNT 3000
+#define ARCHIVE_PATH "stream_demo_archive.bin"
+#define PRODUCER_COUNT 4
+#define PRODUCER_RECORD_COUNT 20000
+
+/*
+*
+* Several threads encoding records into one ring
+*
+*/
+
+typedef struct Producer {
+	RingBuffer *Ring;
+	uint32_t Id;
+} Producer;
+
+typedef struct Consumer {
+	RingBuffer *Ring;
+	uint32_t Received;
+	uint32_t Bad; // Records that didn't decode or came out of order
+} Consumer;
+
+static void yieldThread(void)
+{
+#ifdef _WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif // _WIN32
+}
+
+// Encodes PRODUCER_RECORD_COUNT records straight into ring slots: Size counts up, Serial names the producer
+static void produceRecords(Producer *producer)
+{
+	char serial[16];
+	snprintf(serial, sizeof(serial), "SN%" PRIu32, producer->Id);
+	for (uint32_t i = 0; i < PRODUCER_RECORD_COUNT; i++)
+	{
+		RingReservation reservation;
+		while (!ringBufferReserve(producer->Ring, 256, &reservation))
+		{
+			yieldThread(); // Full until the consumer catches up
+		}
+
+		size_t recordLen = 0;
+		START_CFLIST(reservation.Data, reservation.Capacity);
+		ADD_CFLIST_UNSIGNED_FIELD(TOKEN_SIZE, i);
+		ADD_CFLIST_STRING_FIELD(TOKEN_SERIAL, serial);
+		ADD_CFLIST_BOOL_FIELD(TOKEN_SUPPORTS_POWER, (i % 2) == 0);
+		END_CFLIST_GET_SIZE(&recordLen);
+		ringBufferCommit(producer->Ring, &reservation, (uint32_t)recordLen);
+	}
+}
+
+// Decodes every record, checking that each producer's records are whole and arrive in the order they were made
+static void consumeRecords(Consumer *consumer)
+{
+	uint64_t expected[PRODUCER_COUNT] = { 0 };
+	while (consumer->Received < PRODUCER_COUNT * PRODUCER_RECORD_COUNT)
+	{
+		const uint8_t *record = NULL;
+		uint32_t length = 0;
+		if (!ringBufferPeek(consumer->Ring, &record, &length))
+		{
+			yieldThread();
+			continue;
+		}
+
+		CFListRecord decoded;
+		uint32_t id = PRODUCER_COUNT;
+		if (cFListDecodeRecord(record, length, &decoded) == CFLIST_OK && decoded.Present == (1 << CFLIST_SLOT_COUNT) - 1)
+		{
+			id = (uint32_t)strtoul(decoded.Serial + 2, NULL, 10);
+		}
+		if (id >= PRODUCER_COUNT || (uint64_t)decoded.Size != expected[id] || decoded.SupportsPower != ((decoded.Size % 2) == 0))
+		{
+			consumer->Bad++;
+		}
+		else
+		{
+			expected[id]++;
+		}
+		consumer->Received++;
+		ringBufferRelease(consumer->Ring);
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI producerThread(LPVOID producer)
+{
+	produceRecords((Producer*)producer);
+	return 0;
+}
+
+static DWORD WINAPI consumerThread(LPVOID consumer)
+{
+	consumeRecords((Consumer*)consumer);
+	return 0;
+}
+#else
+static void* producerThread(void *producer)
+{
+	produceRecords((Producer*)producer);
+	return NULL;
+}
+
+static void* consumerThread(void *consumer)
+{
+	consumeRecords((Consumer*)consumer);
+	return NULL;
+}
+#endif // _WIN32
+
+// Runs PRODUCER_COUNT producer threads and a consumer thread over one MultiProducer ring. Returns false if a thread can't start.
+static bool runProducers(RingBuffer *ring, Consumer *consumer)
+{
+	Producer producers[PRODUCER_COUNT];
+	consumer->Ring = ring;
+	consumer->Received = 0;
+	consumer->Bad = 0;
+	for (uint32_t i = 0; i < PRODUCER_COUNT; i++)
+	{
+		producers[i].Ring = ring;
+		producers[i].Id = i;
+	}
+
+#ifdef _WIN32
+	HANDLE threads[PRODUCER_COUNT + 1];
+	threads[PRODUCER_COUNT] = CreateThread(NULL, 0, consumerThread, consumer, 0, NULL);
+	for (uint32_t i = 0; i < PRODUCER_COUNT; i++)
+	{
+		threads[i] = CreateThread(NULL, 0, producerThread, &producers[i], 0, NULL);
+	}
+	for (uint32_t i = 0; i <= PRODUCER_COUNT; i++)
+	{
+		if (!threads[i])
+		{
+			return false; // The others may be waiting on it forever
+		}
+	}
+	for (uint32_t i = 0; i <= PRODUCER_COUNT; i++)
+	{
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+	}
+#else
+	pthread_t threads[PRODUCER_COUNT + 1];
+	if (pthread_create(&threads[PRODUCER_COUNT], NULL, consumerThread, consumer) != 0)
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < PRODUCER_COUNT; i++)
+	{
+		if (pthread_create(&threads[i], NULL, producerThread, &producers[i]) != 0)
+		{
+			return false; // The consumer would wait on it forever
+		}
+	}
+	for (uint32_t i = 0; i <= PRODUCER_COUNT; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+#endif // _WIN32
+	return true;
+}
+
+int main()
+{
+	// A device SDDS written once a "second", with only the reading changing
+	SDDS s = { 0 };
+	uint32_t reading = 0;
+	BYTE serial[16] = "SN0123456789";
+	BYTE fanSpeed[2] = { 0x10, 0x27 };
+	addField(&s, "Serial", sizeof(serial) * 8, serial, 0);
+	addField(&s, "Temp.Inlet", 32, (BYTE*)&reading, 0);
+	addField(&s, "Fan.Speed", 16, fanSpeed, 0);
+
+	FILE *plain = tmpfile();
+	FILE *compressed = tmpfile();
+	if (!plain || !compressed)
+	{
+		printf("Unable to open temporary files\n");
+		return EXIT_FAILURE;
+	}
+
+	for (reading = 0; reading < RECORD_COUNT; reading++)
+	{
+		BYTE *field = getRawField(&s, "Temp.Inlet", NULL, NULL, NULL);
+		memcpy(field, &reading, sizeof(reading));
+		bool written = writeSDDSRecord(plain, &s, SDDS_RECORD_XML, false) && writeSDDSRecord(compressed, &s, SDDS_RECORD_XML, true);
+		assert(written);
+		(void)written;
+	}
+	printf("%d xml records: %ld bytes plain, %ld bytes compressed\n", RECORD_COUNT, ftell(plain), ftell(compressed));
+
+	// Read them back
+	rewind(compressed);
+	uint32_t records = 0;
+	SDDS r = { 0 };
+	FileStreamStatus status;
+	while ((status = readSDDSRecord(compressed, &r)) == FILE_STREAM_OK)
+	{
+		uint32_t readBack = 0;
+		memcpy(&readBack, getRawField(&r, "Temp.Inlet", NULL, NULL, NULL), sizeof(readBack));
+		assert(readBack == records);
+		records++;
+		closeSDDS(&r);
+	}
+	assert(status == FILE_STREAM_END && records == RECORD_COUNT);
+	fclose(plain);
+	fclose(compressed);
+
+	// The same records through a batch writer: a handful of large writes instead of one per record
+	FILE *batched = tmpfile();
+	BatchWriter writer;
+	BatchWriterStatus batchStatus = batched ? batchWriterOpen(&writer, fileno(batched), 4096, true) : BATCH_WRITER_IO_ERROR;
+	assert(batchStatus == BATCH_WRITER_OK);
+	for (reading = 0; reading < RECORD_COUNT && batchStatus == BATCH_WRITER_OK; reading++)
+	{
+		BYTE *field = getRawField(&s, "Temp.Inlet", NULL, NULL, NULL);
+		memcpy(field, &reading, sizeof(reading));
+		batchStatus = batchWriteSDDSRecord(&writer, &s, (reading % 2) ? SDDS_RECORD_BINARY : SDDS_RECORD_XML, (reading % 3) == 0);
+	}
+	batchStatus = batchWriterClose(&writer);
+	assert(batchStatus == BATCH_WRITER_OK);
+	(void)batchStatus;
+
+	rewind(batched);
+	for (records = 0; (status = readSDDSRecord(batched, &r)) == FILE_STREAM_OK; records++)
+	{
+		uint32_t readBack = 0;
+		memcpy(&readBack, getRawField(&r, "Temp.Inlet", NULL, NULL, NULL), sizeof(readBack));
+		assert(readBack == records);
+		closeSDDS(&r);
+	}
+	assert(status == FILE_STREAM_END && records == RECORD_COUNT);
+	printf("%d mixed records batched into %" PRIu64 " writes (%s)\n", RECORD_COUNT, writer.WriteCalls, (writer.Backend == BATCH_WRITER_IO_URING) ? "io_uring" : "pwritev");
+	fclose(batched);
+
+	// A small cFList document compresses well thanks to the dictionary
+	uint8_t doc[512] = { 0 };
+	size_t docLen = 0;
+	START_CFLIST(doc, sizeof(doc));
+	ADD_CFLIST_UNSIGNED_FIELD(TOKEN_SIZE, 4096);
+	ADD_CFLIST_STRING_FIELD(TOKEN_SERIAL, "SN0123456789");
+	ADD_CFLIST_BOOL_FIELD(TOKEN_SUPPORTS_POWER, true);
+	END_CFLIST_GET_SIZE(&docLen);
+
+	uint8_t frame[COMPRESSION_FRAME_BOUND(sizeof(doc))];
+	uint8_t roundTrip[sizeof(doc)];
+	size_t roundTripLen = 0;
+	size_t withoutDictionary = compressFrame(doc, docLen, COMPRESSION_DICT_NONE, frame, sizeof(frame));
+	size_t frameLen = compressFrame(doc, docLen, COMPRESSION_DICT_CFLIST, frame, sizeof(frame));
+	CompressionStatus decompressed = decompressFrame(frame, frameLen, roundTrip, sizeof(roundTrip), &roundTripLen);
+	assert(decompressed == COMPRESSION_OK && roundTripLen == docLen && memcmp(roundTrip, doc, docLen) == 0);
+	(void)decompressed;
+	printf("cFList document: %zu bytes, %zu as a frame without a dictionary, %zu with the cFList dictionary\n", docLen, withoutDictionary, frameLen);
+
+	// Encode straight into a ring buffer slot, then read it back in place
+	static uint64_t ringMemory[RING_SIZE / sizeof(uint64_t)];
+	RingBuffer ring;
+	RingReservation reservation;
+	const uint8_t *record = NULL;
+	uint32_t length = 0;
+	bool ready = ringBufferInit(&ring, (uint8_t*)ringMemory, RING_SIZE, false);
+	assert(ready);
+	for (uint32_t i = 0; i < RECORD_COUNT; i++)
+	{
+		size_t recordLen = 0;
+		ready = ringBufferReserve(&ring, 256, &reservation);
+		assert(ready);
+		START_CFLIST(reservation.Data, reservation.Capacity);
+		ADD_CFLIST_UNSIGNED_FIELD(TOKEN_SIZE, i);
+		ADD_CFLIST_STRING_FIELD(TOKEN_SERIAL, "SN0123456789");
+		END_CFLIST_GET_SIZE(&recordLen);
+		ringBufferCommit(&ring, &reservation, (uint32_t)recordLen);
+
+		// An SDDS can be written into a slot the same way
+		uint64_t binarySize = getBinarySize(&s);
+		ready = ringBufferReserve(&ring, (uint32_t)binarySize, &reservation);
+		assert(ready);
+		ringBufferCommit(&ring, &reservation, (uint32_t)writeBinary(&s, reservation.Data, reservation.Capacity));
+
+		uint64_t size = 0;
+		ready = ringBufferPeek(&ring, &record, &length);
+		assert(ready && length == recordLen);
+		CFListStatus found = cFListGetUnsigned(record, length, TOKEN_SIZE, &size);
+		assert(found == CFLIST_OK && size == i);
+		(void)found;
+		ringBufferRelease(&ring);
+
+		ready = ringBufferPeek(&ring, &record, &length);
+		assert(ready && length == binarySize);
+		ringBufferRelease(&ring);
+	}
+	ready = ringBufferPeek(&ring, &record, &length);
+	assert(!ready);
+	(void)ready;
+	printf("%d cFList and binary records passed through a %d byte ring\n", RECORD_COUNT, RING_SIZE);
+
+	// Several producer threads encoding into one ring at once, with another thread consuming
+	Consumer consumer;
+	ready = ringBufferInit(&ring, (uint8_t*)ringMemory, RING_SIZE, true) && runProducers(&ring, &consumer);
+	assert(ready && consumer.Received == PRODUCER_COUNT * PRODUCER_RECORD_COUNT && consumer.Bad == 0);
+	printf("%d producer threads passed %" PRIu32 " cFList records through a %d byte ring, %" PRIu32 " bad\n",
+		PRODUCER_COUNT, consumer.Received, RING_SIZE, consumer.Bad);
+	closeSDDS(&s);
+
+	// An archive of cFList and binary records (some compressed), filtered without decoding them
+	FILE *archive = fopen(ARCHIVE_PATH, "wb");
+	if (!archive)
+	{
+		printf("Unable to create %s\n", ARCHIVE_PATH);
+		return EXIT_FAILURE;
+	}
+	uint64_t expected = 0;
+	for (uint32_t i = 0; i < ARCHIVE_RECORD_COUNT; i++)
+	{
+		bool supportsPower = (i % 3) == 0;
+		bool written;
+		if (i % 2)
+		{
+			START_CFLIST(doc, sizeof(doc));
+			ADD_CFLIST_STRING_FIELD(TOKEN_SERIAL, "SN0123456789");
+			ADD_CFLIST_UNSIGNED_FIELD(TOKEN_SIZE, i);
+			ADD_CFLIST_BOOL_FIELD(TOKEN_SUPPORTS_POWER, supportsPower);
+			END_CFLIST_GET_SIZE(&docLen);
+			written = writeRecord(archive, doc, docLen, COMPRESSION_DICT_CFLIST, (i % 5) == 0);
+		}
+		else
+		{
+			SDDS device = { 0 };
+			addString(&device, TOKEN_SERIAL, "SN0123456789");
+			addU64(&device, TOKEN_SIZE, i);
+			addBool(&device, TOKEN_SUPPORTS_POWER, supportsPower);
+			written = writeSDDSRecord(archive, &device, SDDS_RECORD_BINARY, (i % 5) == 0);
+			closeSDDS(&device);
+		}
+		assert(written);
+		(void)written;
+		expected += (supportsPower && i > 1000) ? 1 : 0;
+	}
+	fclose(archive);
+
+	QueryCondition filter[] = {
+		queryBooleanCondition(TOKEN_SUPPORTS_POWER, true),
+		queryUnsignedCondition(TOKEN_SIZE, QUERY_GT, 1000),
+		queryStringCondition(TOKEN_SERIAL, QUERY_EQ, "SN0123456789"),
+	};
+	QueryResult single;
+	QueryResult parallel;
+	QueryStatus queryStatus = queryFile(filter, sizeof(filter) / sizeof(filter[0]), ARCHIVE_PATH, 1, &single);
+	assert(queryStatus == QUERY_OK && single.Records == ARCHIVE_RECORD_COUNT && single.Matches == expected);
+	queryStatus = queryFile(filter, sizeof(filter) / sizeof(filter[0]), ARCHIVE_PATH, 4, &parallel);
+	assert(queryStatus == QUERY_OK && parallel.Records == ARCHIVE_RECORD_COUNT && parallel.Matches == expected);
+	assert(memcmp(single.MatchOffsets, parallel.MatchOffsets, (size_t)expected * sizeof(uint64_t)) == 0);
+	(void)queryStatus;
+
+	// The offsets point at the matching frames
+	archive = fopen(ARCHIVE_PATH, "rb");
+	int seeked = archive ? fseek(archive, (long)parallel.MatchOffsets[0], SEEK_SET) : -1;
+	assert(seeked == 0);
+	(void)seeked;
+	SDDS first = { 0 };
+	uint64_t firstSize = 0;
+	status = readSDDSRecord(archive, &first);
+	assert(status == FILE_STREAM_OK && getU64(&first, TOKEN_SIZE, &firstSize) && firstSize == 1002);
+	(void)firstSize;
+	closeSDDS(&first);
+	fclose(archive);
+	remove(ARCHIVE_PATH);
+	printf("%" PRIu64 " of %d archived records matched the filter\n", parallel.Matches, ARCHIVE_RECORD_COUNT);
+	queryResultFree(&single);
+	queryResultFree(&parallel);
+
+	return EXIT_SUCCESS;
+}